@@ -1,54 +1,52 @@
+#include <signal.h>
 #include <unistd.h>
 
+#include <algorithm>
+#include <atomic>
 #include <chrono>
 #include <cstdlib>
+#include <filesystem>
 #include <fstream>
+#include <future>
 #include <iostream>
+#include <sstream>
 #include <string>
 #include <vector>
 
+#include "utils/Process.hpp"
+#include "utils/ThreadPool.hpp"
+
 using namespace std;
 
-const string traceFolder = "../test/";
+// 附着式测试：test/ 下的 *.txt 与 test/divergence/ 下的 *.in 统一作为测试点，
+// 后者是有意与标准程序不同的行为，以 .out 固定期望输出。
+// 测试点旁有同名的 .out 文件时以它为期望输出，否则以标准程序的输出为准。
+// 各测试点在线程池上并行执行，解释器经 posix_spawn 启动、管道读写，
+// 输出在内存中比较，不一致时给出逐行差异；通过的测试点再用 valgrind 检查内存泄漏。
+// test/scoped/ 是 Scope 嵌入的 bonus 测试点，-b 时一并运行。
+const vector<string> traceFolders = {"../test/", "../test/divergence/"};
+const string scopedFolder = "../test/scoped/";
 const string defaultStudentBasic = "./code";
 const string defaultStanderBasic = "../Basic-Demo-64bit";
 
+// 基础部分的测试点数，全部运行时据此计算得分
 const int traceCount = 100;
-const string traces[traceCount] = {
-    "trace00.txt", "trace01.txt", "trace02.txt", "trace03.txt", "trace04.txt",
-    "trace05.txt", "trace06.txt", "trace07.txt", "trace08.txt", "trace09.txt",
-    "trace10.txt", "trace11.txt", "trace12.txt", "trace13.txt", "trace14.txt",
-    "trace15.txt", "trace16.txt", "trace17.txt", "trace18.txt", "trace19.txt",
-    "trace20.txt", "trace21.txt", "trace22.txt", "trace23.txt", "trace24.txt",
-    "trace25.txt", "trace26.txt", "trace27.txt", "trace28.txt", "trace29.txt",
-    "trace30.txt", "trace31.txt", "trace32.txt", "trace33.txt", "trace34.txt",
-    "trace35.txt", "trace36.txt", "trace37.txt", "trace38.txt", "trace39.txt",
-    "trace40.txt", "trace41.txt", "trace42.txt", "trace43.txt", "trace44.txt",
-    "trace45.txt", "trace46.txt", "trace47.txt", "trace48.txt", "trace49.txt",
-    "trace50.txt", "trace51.txt", "trace52.txt", "trace53.txt", "trace54.txt",
-    "trace55.txt", "trace56.txt", "trace57.txt", "trace58.txt", "trace59.txt",
-    "trace60.txt", "trace61.txt", "trace62.txt", "trace63.txt", "trace64.txt",
-    "trace65.txt", "trace66.txt", "trace67.txt", "trace68.txt", "trace69.txt",
-    "trace70.txt", "trace71.txt", "trace72.txt", "trace73.txt", "trace74.txt",
-    "trace75.txt", "trace76.txt", "trace77.txt", "trace78.txt", "trace79.txt",
-    "trace80.txt", "trace81.txt", "trace82.txt", "trace83.txt", "trace84.txt",
-    "trace85.txt", "trace86.txt", "trace87.txt", "trace88.txt", "trace89.txt",
-    "trace90.txt", "trace91.txt", "trace92.txt", "trace93.txt", "trace94.txt",
-    "trace95.txt", "trace96.txt", "trace97.txt", "trace98.txt", "trace99.txt",
-};
+const chrono::milliseconds runTimeout(1000);
+const chrono::milliseconds leakTimeout(5000);
 
 string studentBasic = "";
 string standerBasic = "";
 string traceFile = "";
-int runTraces = traceCount, currentTrace = 0;
+size_t jobs = 0;
 bool silent = false, firstFail = false, hideError = false, useColor = true;
+bool checkLeak = true, withScoped = false;
 
-int correct = 0, wrong = 0, total = 0;
+int correct = 0, wrong = 0, total = 0, baseCorrect = 0, baseTotal = 0;
 
 void usage(const char* progname) {
   cout << progname
        << " [-h] [-e <your_exec>] [-s <stander_exec>] [-t <trace_file>] [-f] "
-          "[-m] [-q]"
+          "[-m] [-q] [-j <jobs>] [-L] [-b]"
        << endl
        << "    -h  Show this message and quit" << endl
        << "    -e  Specify your executable file, default value: "
@@ -59,7 +57,11 @@ void usage(const char* progname) {
        << "    -f  Stop at first failed test" << endl
        << "    -m  Hide error message" << endl
        << "    -q  Show final score only, cannot use with -t or -f, include -m"
-       << endl;
+       << endl
+       << "    -j  Number of parallel workers, default: hardware threads"
+       << endl
+       << "    -L  Skip the memory leak check with valgrind" << endl
+       << "    -b  Also run the bonus traces in " << scopedFolder << endl;
   exit(1);
 }
 
@@ -71,7 +73,7 @@ string color(string ce) {
 void parseArguments(int argc, char** argv) {
   int c;
   opterr = 0;
-  while ((c = getopt(argc, argv, "e:s:t:fmqch")) != -1) {
+  while ((c = getopt(argc, argv, "e:s:t:j:fmqLbch")) != -1) {
     switch (c) {
       case 'e':
         if (studentBasic.size()) usage(argv[0]);
@@ -85,6 +87,9 @@ void parseArguments(int argc, char** argv) {
         if (traceFile.size()) usage(argv[0]);
         traceFile = optarg;
         break;
+      case 'j':
+        jobs = strtoul(optarg, nullptr, 10);
+        break;
       case 'f':
         if (firstFail) usage(argv[0]);
         firstFail = true;
@@ -97,6 +102,12 @@ void parseArguments(int argc, char** argv) {
         if (silent) usage(argv[0]);
         silent = true;
         break;
+      case 'L':
+        checkLeak = false;
+        break;
+      case 'b':
+        withScoped = true;
+        break;
       case 'h':
         usage(argv[0]);
         break;
@@ -111,85 +122,205 @@ void parseArguments(int argc, char** argv) {
   if (standerBasic.size() == 0) standerBasic = defaultStanderBasic;
 }
 
-void clearTempFiles() {
-  int r = system("rm test_ans test_out -f");
-  (void)r;
+bool readFile(const string& path, string& content) {
+  ifstream in(path, ios::binary);
+  if (!in) return false;
+  stringstream buffer;
+  buffer << in.rdbuf();
+  content = buffer.str();
+  return true;
 }
 
-int testTrace(const char* trace) {
-  clearTempFiles();
-  if (system((string() + "cat " + trace + " | timeout 1 " + standerBasic +
-              " > test_ans 2> /dev/null")
-                 .c_str()) != 0)
-    return 1;
-  if (system((string() + "cat " + trace + " | timeout 1 " + studentBasic +
-              " > test_out 2> /dev/null")
-                 .c_str()) != 0)
-    return 2;
-  if (system("diff test_ans test_out > /dev/null 2> /dev/null")) return 4;
-  if (system((string() + "cat " + trace +
-              " | timeout 5 valgrind --error-exitcode=2 --leak-check=full " +
-              studentBasic + " > /dev/null 2> /dev/null")
-                 .c_str()) != 0)
-    return 3;
-  clearTempFiles();
-  return 0;
+vector<string> splitLines(const string& text) {
+  vector<string> lines;
+  size_t begin = 0;
+  while (begin < text.size()) {
+    size_t end = text.find('\n', begin);
+    if (end == string::npos) end = text.size();
+    lines.push_back(text.substr(begin, end - begin));
+    begin = end + 1;
+  }
+  return lines;
+}
+
+// 逐行比较期望输出与实际输出，以最长公共子序列给出增删的行，
+// 不一致的行前后各保留两行上下文。
+string diffLines(const string& expected, const string& actual) {
+  const size_t context = 2;
+  vector<string> a = splitLines(expected), b = splitLines(actual);
+  // 去掉相同的首尾，只对中间部分求 LCS
+  size_t head = 0;
+  while (head < a.size() && head < b.size() && a[head] == b[head]) head++;
+  size_t tail = 0;
+  while (tail < a.size() - head && tail < b.size() - head &&
+         a[a.size() - 1 - tail] == b[b.size() - 1 - tail])
+    tail++;
+  size_t n = a.size() - head - tail, m = b.size() - head - tail;
+
+  // ops：' ' 相同，'-' 只在期望输出中，'+' 只在实际输出中
+  vector<pair<char, string>> ops;
+  for (size_t i = 0; i < head; i++) ops.push_back({' ', a[i]});
+  if (n * m <= 4000000) {
+    vector<vector<unsigned>> lcs(n + 1, vector<unsigned>(m + 1, 0));
+    for (size_t i = n; i-- > 0;)
+      for (size_t j = m; j-- > 0;)
+        lcs[i][j] = a[head + i] == b[head + j]
+                        ? lcs[i + 1][j + 1] + 1
+                        : max(lcs[i + 1][j], lcs[i][j + 1]);
+    size_t i = 0, j = 0;
+    while (i < n || j < m) {
+      if (i < n && j < m && a[head + i] == b[head + j]) {
+        ops.push_back({' ', a[head + i]});
+        i++, j++;
+      } else if (j < m && (i == n || lcs[i][j + 1] >= lcs[i + 1][j])) {
+        ops.push_back({'+', b[head + j++]});
+      } else {
+        ops.push_back({'-', a[head + i++]});
+      }
+    }
+  } else {
+    // 太大时不求 LCS，整段视为替换
+    for (size_t i = 0; i < n; i++) ops.push_back({'-', a[head + i]});
+    for (size_t j = 0; j < m; j++) ops.push_back({'+', b[head + j]});
+  }
+  for (size_t i = a.size() - tail; i < a.size(); i++) {
+    ops.push_back({' ', a[i]});
+  }
+
+  string diff;
+  size_t printed = 0;
+  for (size_t k = 0; k < ops.size(); k++) {
+    bool near = false;
+    size_t from = k >= context ? k - context : 0;
+    for (size_t q = from; q < ops.size() && q <= k + context && !near; q++)
+      near = ops[q].first != ' ';
+    if (!near) continue;
+    if (k > printed || (k == 0 && printed == 0)) {
+      // 新的一段：标出在期望输出中的行号
+      size_t line = 1;
+      for (size_t q = 0; q < k; q++) line += ops[q].first != '+';
+      diff += color("\x1b[36m") + "@@ line " + to_string(line) + " @@" +
+              color("\x1b[0m") + "\n";
+    }
+    if (ops[k].first == '-') diff += color("\x1b[31m");
+    if (ops[k].first == '+') diff += color("\x1b[32m");
+    diff += ops[k].first;
+    diff += ops[k].second;
+    if (ops[k].first != ' ') diff += color("\x1b[0m");
+    diff += "\n";
+    printed = k + 1;
+  }
+  if (!expected.empty() && expected.back() != '\n')
+    diff += "(demo output has no trailing newline)\n";
+  if (!actual.empty() && actual.back() != '\n')
+    diff += "(your output has no trailing newline)\n";
+  return diff;
+}
+
+// 各测试点的结果：error 为 0 通过，1 标准程序出错，2 被测程序出错，
+// 3 内存泄漏，4 输出不一致，5 无法读取测试点，-1 因 -f 未执行。
+struct TraceResult {
+  string trace;
+  int error = 0;
+  bool timedOut = false;
+  string input;
+  string expected;
+  string actual;
+};
+
+atomic<bool> stopping{false};
+
+TraceResult testTrace(const string& trace) {
+  TraceResult result;
+  result.trace = trace;
+  if (stopping) {
+    result.error = -1;
+    return result;
+  }
+  if (!readFile(trace, result.input)) {
+    result.error = 5;
+    return result;
+  }
+  string outFile = filesystem::path(trace).replace_extension(".out").string();
+  if (outFile == trace || !readFile(outFile, result.expected)) {
+    RunResult demo = runProgram({standerBasic}, result.input, runTimeout);
+    if (!demo.ok) {
+      result.error = 1;
+      result.timedOut = demo.timedOut;
+      return result;
+    }
+    result.expected = move(demo.output);
+  }
+  RunResult student = runProgram({studentBasic}, result.input, runTimeout);
+  result.actual = move(student.output);
+  if (!student.ok) {
+    result.error = 2;
+    result.timedOut = student.timedOut;
+  } else if (result.expected != result.actual) {
+    result.error = 4;
+  } else if (checkLeak &&
+             !runProgram({"valgrind", "--error-exitcode=2", "--leak-check=full",
+                          studentBasic},
+                         result.input, leakTimeout)
+                  .ok) {
+    result.error = 3;
+  }
+  if (result.error != 0 && firstFail) stopping = true;
+  return result;
 }
 
-void runTest(const string currentTrace) {
-  if (!silent) cout << "Trace \"" << currentTrace << "\" ... ";
-  cout.flush();
-  int error = testTrace(currentTrace.c_str());
+void report(const TraceResult& result) {
   total++;
-  if (!error) {
+  bool base = filesystem::path(result.trace).parent_path() ==
+              filesystem::path(traceFolders[0]).parent_path();
+  if (base) baseTotal++;
+  if (!silent) cout << "Trace \"" << result.trace << "\" ... ";
+  if (!result.error) {
     if (!silent)
       cout << color("\x1b[32;1m") << "Pass" << color("\x1b[0m") << endl;
     correct++;
-  } else {
-    wrong++;
-    if (!silent) {
-      cout << color("\x1b[31;1m") << "Fail" << color("\x1b[0m") << endl;
-      if (!hideError) {
-        cout << "Trace file: " << endl << color("\x1b[35m");
-        cout.flush();
-        int r0 = system((string() + "cat " + currentTrace).c_str());
-        (void)r0;
-        cout << color("\x1b[0m") << endl;
-        if (error == 1)
-          cout << color("\x1b[31m")
-               << "Error occurred while running demo program"
-               << color("\x1b[0m") << endl;
-        if (error == 2)
-          cout << color("\x1b[31m")
-               << "Error occurred while running your program"
-               << color("\x1b[0m") << endl;
-        if (error == 3)
-          cout << color("\x1b[31m") << "Memory leak" << color("\x1b[0m")
-               << endl;
-        if (error == 4) {
-          cout << "Demo output: " << endl << color("\x1b[36m");
-          cout.flush();
-          int r1 = system("cat test_ans");
-          (void)r1;
-          cout << color("\x1b[0m") << endl;
-          cout << "Your output: " << endl << color("\x1b[33m");
-          cout.flush();
-          int r2 = system("cat test_out");
-          (void)r2;
-          cout << color("\x1b[0m") << endl;
-        }
-      }
-    }
-    clearTempFiles();
-    if (firstFail) throw exception();
+    if (base) baseCorrect++;
+    return;
+  }
+  wrong++;
+  if (silent) return;
+  cout << color("\x1b[31;1m") << "Fail" << color("\x1b[0m") << endl;
+  if (hideError) return;
+  cout << "Trace file: " << endl
+       << color("\x1b[35m") << result.input << color("\x1b[0m") << endl;
+  if (result.error == 1)
+    cout << color("\x1b[31m") << "Error occurred while running demo program"
+         << color("\x1b[0m") << endl;
+  if (result.error == 2)
+    cout << color("\x1b[31m") << "Error occurred while running your program"
+         << color("\x1b[0m") << endl;
+  if (result.timedOut)
+    cout << color("\x1b[31m") << "Time limit exceeded" << color("\x1b[0m")
+         << endl;
+  if (result.error == 3)
+    cout << color("\x1b[31m") << "Memory leak" << color("\x1b[0m") << endl;
+  if (result.error == 5)
+    cout << color("\x1b[31m") << "Cannot read trace file" << color("\x1b[0m")
+         << endl;
+  if (result.error == 4) {
+    cout << "Diff (-demo output, +your output): " << endl
+         << diffLines(result.expected, result.actual) << endl;
   }
 }
 
-void showScore() {
-  int score = correct / 5 * 5;
+// 运行全部测试点时基础部分须恰好 traceCount 个，否则视为测试环境有误。
+bool showScore(bool runAll) {
+  int score = baseCorrect / 5 * 5;
   if (!silent) cout << correct << " / " << total << " trace(s) passed." << endl;
-  if (total != traceCount) return;
+  if (baseTotal != traceCount) {
+    if (!runAll) return true;
+    cout << color("\x1b[31m") << "错误: 应运行 " << traceCount
+         << " 个基础测试点，实际运行 " << baseTotal << " 个"
+         << color("\x1b[0m") << endl;
+    return false;
+  }
   cout << "Final Score: " << (score / 10) << "." << (score % 10) << endl;
+  return true;
 }
 
 // 附着式测试程序的主函数
@@ -199,48 +330,85 @@ int main(int argc, char** argv) {
   cout << "=====================================" << endl;
 
   parseArguments(argc, argv);
+  useColor = isatty(STDOUT_FILENO);
+  // 被测程序提前退出时写管道不应终止本进程
+  signal(SIGPIPE, SIG_IGN);
+
+  cout << "开始测试..." << endl;
+  cout << "学生程序: " << studentBasic << endl;
+  cout << "标准程序: " << standerBasic << endl;
 
-  try {
-    cout << "开始测试..." << endl;
-    cout << "学生程序: " << studentBasic << endl;
-    cout << "标准程序: " << standerBasic << endl;
+  // 检查可执行文件是否存在
+  if (access(studentBasic.c_str(), X_OK) != 0) {
     cout << "-------------------------------------" << endl;
+    cout << color("\x1b[31m") << "错误: 学生程序 " << studentBasic
+         << " 不存在!" << color("\x1b[0m") << endl;
+    return 1;
+  }
+  // 没有 valgrind 时明确提示跳过，而不是把每个测试点判为泄漏
+  if (checkLeak &&
+      !runProgram({"valgrind", "--version"}, "", leakTimeout).ok) {
+    checkLeak = false;
+    cout << color("\x1b[33m") << "警告: 未找到 valgrind，本次不检查内存泄漏"
+         << color("\x1b[0m") << endl;
+  }
+  cout << "内存泄漏检查: " << (checkLeak ? "开启" : "关闭") << endl;
+  cout << "-------------------------------------" << endl;
 
-    // 检查可执行文件是否存在
-    if (system(("test -f " + studentBasic).c_str()) != 0) {
-      cout << color("\x1b[31m") << "错误: 学生程序 " << studentBasic
-           << " 不存在!" << color("\x1b[0m") << endl;
-      return 1;
+  vector<string> traces;
+  if (traceFile.size()) {
+    cout << "运行单个测试: " << traceFile << endl;
+    traces.push_back(traceFile);
+  } else {
+    cout << "运行所有测试用例..." << endl;
+    vector<string> folders = traceFolders;
+    if (withScoped) folders.push_back(scopedFolder);
+    for (const string& folder : folders) {
+      error_code ec;
+      size_t found = 0;
+      for (filesystem::directory_iterator it(folder, ec), end; !ec && it != end;
+           it.increment(ec)) {
+        string ext = it->path().extension().string();
+        if (it->is_regular_file() && (ext == ".txt" || ext == ".in")) {
+          traces.push_back(it->path().string());
+          found++;
+        }
+      }
+      // 目录缺失或为空时不能当作全部通过
+      if (ec || (folder == traceFolders[0] && found == 0)) {
+        cout << color("\x1b[31m") << "错误: 测试目录 " << folder
+             << (ec ? " 无法读取: " + ec.message() : string(" 中没有测试点"))
+             << "，请在构建目录中运行" << color("\x1b[0m") << endl;
+        return 1;
+      }
     }
+    sort(traces.begin(), traces.end());
+  }
 
-    if (system(("test -f " + standerBasic).c_str()) != 0) {
-      cout << color("\x1b[31m") << "错误: 标准程序 " << standerBasic
-           << " 不存在!" << color("\x1b[0m") << endl;
-      return 1;
+  auto start = chrono::steady_clock::now();
+  {
+    ThreadPool pool(jobs);
+    vector<future<TraceResult>> results;
+    for (const string& trace : traces) {
+      results.push_back(pool.submit([trace] { return testTrace(trace); }));
     }
-
-    // 设置可执行权限
-    system(("chmod +x " + studentBasic).c_str());
-    system(("chmod +x " + standerBasic).c_str());
-
-    if (traceFile.size()) {
-      cout << "运行单个测试: " << traceFile << endl;
-      runTest(traceFile);
-    } else {
-      cout << "运行所有测试用例..." << endl;
-      for (int i = 0; i < traceCount; i++) {
-        runTest(traceFolder + traces[i]);
+    // 按测试点顺序输出，-f 时在第一个失败处停下
+    for (auto& pending : results) {
+      TraceResult result = pending.get();
+      if (result.error < 0) break;
+      report(result);
+      if (result.error && firstFail) {
+        cout << color("\x1b[31m") << "测试被中断" << color("\x1b[0m") << endl;
+        stopping = true;
+        break;
       }
     }
-  } catch (...) {
-    cout << color("\x1b[31m") << "测试被中断" << color("\x1b[0m") << endl;
   }
+  auto elapsed = chrono::duration_cast<chrono::milliseconds>(
+      chrono::steady_clock::now() - start);
 
-  showScore();
-
-  // 清理临时文件
-  clearTempFiles();
-
-  cout << "测试完成" << endl;
-  return 0;
-}
\ No newline at end of file
+  // -f 中断时已有失败，不再检查测试点数
+  bool complete = showScore(traceFile.empty() && !stopping);
+  cout << "测试完成，用时 " << elapsed.count() << " ms" << endl;
+  return wrong == 0 && complete ? 0 : 1;
+}
@@ -0,0 +1,382 @@
+// 解释器整体性能基准：生成一组 BASIC 程序，逐个交给解释器执行，
+// 记录墙钟时间、每秒执行的语句数与峰值内存，并可与保存的基线对比。
+// 用法见 usage()，默认在构建目录中运行 ./code。
+
+#include <fcntl.h>
+#include <sys/resource.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <random>
+#include <string>
+#include <vector>
+
+namespace {
+
+// 一个基准程序的名称、运行时执行的语句总数以及最后一行输出，源文本由
+// 生成函数直接写入文件。每个程序以 PRINT 结束，输出不符说明程序没有按预期
+// 执行完，语句数与吞吐也就没有意义。
+struct Workload {
+  std::string name;
+  std::string description;
+  long long statements;
+  std::string expected;
+};
+
+struct Result {
+  double wallMs{0};
+  double statementsPerSec{0};
+  long peakRssKb{0};
+};
+
+std::string program;
+std::string saveFile;
+std::string baselineFile;
+std::string only;
+int repeat = 3;
+double scale = 1.0;
+
+void usage(const char* progname) {
+  std::cout
+      << progname
+      << " [-h] [-e <exec>] [-r <repeat>] [-x <scale>] [-t <workload>] "
+         "[-s <file>] [-b <file>]\n"
+      << "    -h  Show this message and quit\n"
+      << "    -e  Interpreter executable, default value: ./code\n"
+      << "    -r  Runs per workload, the fastest one is reported, default 3\n"
+      << "    -x  Scale every workload size by this factor, default 1\n"
+      << "    -t  Only run the named workload\n"
+      << "    -s  Save results to file as a baseline\n"
+      << "    -b  Compare results against a saved baseline\n";
+  std::exit(1);
+}
+
+void parseArguments(int argc, char** argv) {
+  int c;
+  opterr = 0;
+  while ((c = getopt(argc, argv, "e:r:x:t:s:b:h")) != -1) {
+    switch (c) {
+      case 'e':
+        program = optarg;
+        break;
+      case 'r':
+        repeat = std::max(1, std::atoi(optarg));
+        break;
+      case 'x':
+        scale = std::atof(optarg);
+        break;
+      case 't':
+        only = optarg;
+        break;
+      case 's':
+        saveFile = optarg;
+        break;
+      case 'b':
+        baselineFile = optarg;
+        break;
+      default:
+        usage(argv[0]);
+    }
+  }
+  if (program.empty()) {
+    program = "./code";
+  }
+}
+
+long long scaled(long long count) {
+  return std::max(1LL, static_cast<long long>(count * scale));
+}
+
+// 解释器中的整数运算按 32 位回绕，生成期望输出时同样回绕。
+int wrap(long long value) {
+  return static_cast<int>(static_cast<std::uint32_t>(value));
+}
+
+// 变量名只能由字母组成，把编号写成字母串。
+std::string varName(int index) {
+  std::string name = "v";
+  do {
+    name += static_cast<char>('a' + index % 26);
+    index /= 26;
+  } while (index != 0);
+  return name;
+}
+
+Workload arithmeticLoop(std::ostream& out) {
+  long long n = scaled(2000000);
+  out << "10 LET i = 0\n"
+      << "20 LET s = 0\n"
+      << "30 LET s = s + i * 3 - i / 7\n"
+      << "40 LET t = (s - i) * 2 / (i + 1)\n"
+      << "50 LET i = i + 1\n"
+      << "60 IF i < " << n << " THEN 30\n"
+      << "70 PRINT s\n"
+      << "RUN\nQUIT\n";
+  std::uint32_t s = 0;
+  for (long long i = 0; i < n; ++i) {
+    s += static_cast<std::uint32_t>(i * 3);
+    s -= static_cast<std::uint32_t>(wrap(i) / 7);
+  }
+  return {"arith_loop", "tight arithmetic loop", 3 + 4 * n,
+          std::to_string(wrap(s))};
+}
+
+Workload gotoChain(std::ostream& out) {
+  // 每一轮沿一条打乱顺序的 GOTO 链走完全部行再回到计数器
+  int length = static_cast<int>(scaled(2000));
+  long long rounds = 500;
+  std::vector<int> order(length);
+  for (int i = 0; i < length; ++i) {
+    order[i] = i;
+  }
+  std::mt19937 rng(20251201);
+  std::shuffle(order.begin() + 1, order.end(), rng);
+  auto lineOf = [](int i) { return 1000 + i * 10; };
+  std::vector<std::string> lines(length);
+  for (int i = 0; i + 1 < length; ++i) {
+    lines[order[i]] = "GOTO " + std::to_string(lineOf(order[i + 1]));
+  }
+  lines[order[length - 1]] = "GOTO 30";
+  out << "10 LET r = 0\n"
+      << "20 GOTO " << lineOf(order[0]) << "\n"
+      << "30 LET r = r + 1\n"
+      << "40 IF r < " << rounds << " THEN 20\n"
+      << "50 PRINT r\n"
+      << "60 END\n";
+  for (int i = 0; i < length; ++i) {
+    out << lineOf(i) << " " << lines[i] << "\n";
+  }
+  out << "RUN\nQUIT\n";
+  return {"goto_chain", "deep chains of shuffled GOTO targets",
+          1 + rounds * (3 + length) + 2, std::to_string(rounds)};
+}
+
+Workload hugeProgram(std::ostream& out) {
+  long long n = scaled(500000);
+  for (long long i = 0; i < n; ++i) {
+    out << (i + 1) * 10 << " LET " << varName(static_cast<int>(i % 64))
+        << " = " << i % 1000 << " + " << i % 7 << "\n";
+  }
+  out << (n + 1) * 10 << " PRINT " << varName(static_cast<int>((n - 1) % 64))
+      << "\n"
+      << "RUN\nQUIT\n";
+  return {"huge_lines", "huge line count, each line run once", n + 1,
+          std::to_string((n - 1) % 1000 + (n - 1) % 7)};
+}
+
+Workload manyVariables(std::ostream& out) {
+  int vars = static_cast<int>(scaled(2000));
+  long long rounds = 200;
+  // 首轮读取未定义变量会报错，先用立即执行的 LET 统一赋初值
+  for (int i = 0; i < vars; ++i) {
+    out << "LET " << varName(i) << " = 0\n";
+  }
+  out << "10 LET r = 0\n";
+  int line = 20;
+  for (int i = 0; i < vars; ++i, line += 10) {
+    out << line << " LET " << varName(i) << " = " << varName(i) << " + r\n";
+  }
+  out << line << " LET r = r + 1\n"
+      << line + 10 << " IF r < " << rounds << " THEN 20\n"
+      << line + 20 << " PRINT " << varName(vars - 1) << "\n"
+      << "RUN\nQUIT\n";
+  // 第 r 轮给每个变量加 r
+  return {"many_vars", "thousands of distinct variables",
+          vars + 1 + rounds * (vars + 2) + 1,
+          std::to_string(rounds * (rounds - 1) / 2)};
+}
+
+Workload printHeavy(std::ostream& out) {
+  long long n = scaled(1000000);
+  out << "10 LET i = 0\n"
+      << "20 PRINT i * 7\n"
+      << "30 LET i = i + 1\n"
+      << "40 IF i < " << n << " THEN 20\n"
+      << "RUN\nQUIT\n";
+  return {"print_heavy", "one PRINT per iteration", 1 + 3 * n,
+          std::to_string(wrap((n - 1) * 7))};
+}
+
+Workload inputHeavy(std::ostream& out) {
+  long long n = scaled(1000000);
+  out << "10 LET i = 0\n"
+      << "20 INPUT x\n"
+      << "30 LET i = i + 1\n"
+      << "40 IF i < " << n << " THEN 20\n"
+      << "50 PRINT x\n"
+      << "RUN\n";
+  for (long long i = 0; i < n; ++i) {
+    out << (i * 7919) % 1000003 << "\n";
+  }
+  out << "QUIT\n";
+  return {"input_heavy", "one INPUT value per iteration", 2 + 3 * n,
+          std::to_string(((n - 1) * 7919) % 1000003)};
+}
+
+// 以 input 为标准输入运行解释器，标准输出写入文件 output，标准错误丢弃。
+// 用 fork 而非 posix_spawn：后者与父进程共享地址空间直到 exec，
+// 子进程的 ru_maxrss 会把基准程序自身的内存也算进去。
+bool runOnce(const std::string& input, const std::string& output,
+             Result& result) {
+  auto start = std::chrono::steady_clock::now();
+  pid_t pid = fork();
+  if (pid < 0) {
+    return false;
+  }
+  if (pid == 0) {
+    int in = open(input.c_str(), O_RDONLY);
+    int out = open(output.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    int null = open("/dev/null", O_WRONLY);
+    if (in < 0 || out < 0 || null < 0) {
+      _exit(127);
+    }
+    dup2(in, STDIN_FILENO);
+    dup2(out, STDOUT_FILENO);
+    dup2(null, STDERR_FILENO);
+    char* argv[] = {const_cast<char*>(program.c_str()), nullptr};
+    execv(program.c_str(), argv);
+    _exit(127);
+  }
+  int status;
+  struct rusage usage;
+  if (wait4(pid, &status, 0, &usage) < 0) {
+    return false;
+  }
+  auto end = std::chrono::steady_clock::now();
+  result.wallMs =
+      std::chrono::duration<double, std::milli>(end - start).count();
+  result.peakRssKb = usage.ru_maxrss;
+  return WIFEXITED(status) && WEXITSTATUS(status) == 0;
+}
+
+// 输出的最后一行，去掉行首 INPUT 留下的 " ? " 提示。
+std::string lastLine(const std::string& output) {
+  std::ifstream in(output, std::ios::binary);
+  std::string line;
+  std::string last;
+  while (std::getline(in, line)) {
+    last = line;
+  }
+  std::size_t begin = 0;
+  while (last.compare(begin, 3, " ? ") == 0) {
+    begin += 3;
+  }
+  return last.substr(begin);
+}
+
+std::map<std::string, Result> loadBaseline(const std::string& file) {
+  std::map<std::string, Result> baseline;
+  std::ifstream in(file);
+  std::string name;
+  Result result;
+  while (in >> name >> result.wallMs >> result.statementsPerSec >>
+         result.peakRssKb) {
+    baseline[name] = result;
+  }
+  return baseline;
+}
+
+std::string change(double now, double before) {
+  char text[32];
+  std::snprintf(text, sizeof(text), "%+.1f%%", (now - before) / before * 100);
+  return text;
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+  parseArguments(argc, argv);
+
+  std::map<std::string, Result> baseline;
+  if (!baselineFile.empty()) {
+    baseline = loadBaseline(baselineFile);
+    if (baseline.empty()) {
+      std::cerr << "cannot read baseline " << baselineFile << "\n";
+      return 1;
+    }
+  }
+
+  char dir[] = "/tmp/basic_benchmark_XXXXXX";
+  if (mkdtemp(dir) == nullptr) {
+    std::perror("mkdtemp");
+    return 1;
+  }
+
+  using Generator = Workload (*)(std::ostream&);
+  // 作用域（INDENT/DEDENT）实现后再加入深层嵌套的程序
+  const Generator generators[] = {arithmeticLoop, gotoChain,  hugeProgram,
+                                  manyVariables,  printHeavy, inputHeavy};
+
+  std::ofstream save;
+  if (!saveFile.empty()) {
+    save.open(saveFile);
+  }
+  std::printf("%-14s %10s %14s %10s\n", "workload", "wall ms", "stmts/s",
+              "peak KB");
+  bool ok = true;
+  for (Generator generate : generators) {
+    std::string input = std::string(dir) + "/workload.bas";
+    std::string output = std::string(dir) + "/workload.out";
+    std::ofstream file(input);
+    Workload workload = generate(file);
+    file.close();
+    if (!only.empty() && workload.name != only) {
+      std::remove(input.c_str());
+      continue;
+    }
+
+    Result best;
+    bool ran = true;
+    bool passed = true;
+    std::string got;
+    for (int i = 0; i < repeat && passed; ++i) {
+      Result result;
+      ran = runOnce(input, output, result);
+      if (i == 0 || result.wallMs < best.wallMs) {
+        best.wallMs = result.wallMs;
+      }
+      best.peakRssKb = std::max(best.peakRssKb, result.peakRssKb);
+      got = lastLine(output);
+      passed = ran && got == workload.expected;
+    }
+    std::remove(input.c_str());
+    std::remove(output.c_str());
+    if (!passed) {
+      if (!ran) {
+        std::printf("%-14s failed to run %s\n", workload.name.c_str(),
+                    program.c_str());
+      } else {
+        std::printf("%-14s wrong output: expected \"%s\", got \"%s\"\n",
+                    workload.name.c_str(), workload.expected.c_str(),
+                    got.c_str());
+      }
+      ok = false;
+      continue;
+    }
+    best.statementsPerSec = workload.statements / (best.wallMs / 1000);
+
+    std::printf("%-14s %10.1f %14.0f %10ld", workload.name.c_str(),
+                best.wallMs, best.statementsPerSec, best.peakRssKb);
+    auto it = baseline.find(workload.name);
+    if (it != baseline.end()) {
+      std::printf("   time %s  rss %s",
+                  change(best.wallMs, it->second.wallMs).c_str(),
+                  change(best.peakRssKb, it->second.peakRssKb).c_str());
+    }
+    std::printf("   %s\n", workload.description.c_str());
+    if (save.is_open()) {
+      save << workload.name << " " << best.wallMs << " "
+           << best.statementsPerSec << " " << best.peakRssKb << "\n";
+    }
+  }
+  rmdir(dir);
+  return ok ? 0 : 1;
+}
@@ -0,0 +1,834 @@
+// 差分模糊测试：按文法随机生成 BASIC 程序（LET/PRINT/INPUT/GOTO/IF/REM/END/
+// INDENT/DEDENT 以及 RUN、LIST、CLEAR、立即执行语句和 INPUT 的输入），分别在
+// 进程内经 Session 与 posix_spawn 启动的 Basic-Demo-64bit 执行，输出不同时
+// 把输入缩减为仍保持同一处差异的最小用例，写入输出目录。
+// 解释器核心以 -fsanitize-coverage=trace-pc 构建时按边覆盖反馈：带来新覆盖的
+// 输入留作语料，之后按文法变异。初始语料为 test/ 下的测试点。
+// 用法：diff_fuzzer [-n 次数] [-t 秒] [-s 种子] [-r 标准程序] [-c 语料目录]
+//                   [-o 输出目录] [-S]
+// -S 不生成 INDENT/DEDENT。发现差异时退出码为 1。
+
+#include <fcntl.h>
+#include <poll.h>
+#include <signal.h>
+#include <spawn.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cctype>
+#include <cerrno>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <functional>
+#include <iterator>
+#include <random>
+#include <set>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "Session.hpp"
+
+extern char** environ;
+
+namespace {
+
+// 超过后视为死循环，不参与比较
+constexpr std::uint64_t kMaxJumps = 1000000;
+constexpr std::chrono::milliseconds kReferenceTimeout(1000);
+
+#ifdef BASIC_FUZZ_COVERAGE
+
+// 边覆盖：以相邻两个基本块的地址散列到计数表，按 AFL 的方式把次数分档
+constexpr std::size_t kMapSize = 1 << 16;
+std::uint8_t gTrace[kMapSize];
+std::uint8_t gVirgin[kMapSize];
+std::uintptr_t gPrevious = 0;
+
+}  // namespace
+
+extern "C" void __sanitizer_cov_trace_pc() {
+  // 以相对本函数的偏移计算，不受地址随机化影响，同一种子的运行可以重现
+  auto pc = reinterpret_cast<std::uintptr_t>(__builtin_return_address(0)) -
+            reinterpret_cast<std::uintptr_t>(&__sanitizer_cov_trace_pc);
+  std::uint8_t& count = gTrace[(pc ^ gPrevious) & (kMapSize - 1)];
+  if (count != 0xff) {
+    ++count;
+  }
+  gPrevious = pc >> 1;
+}
+
+namespace {
+
+std::uint8_t bucket(std::uint8_t count) {
+  if (count <= 3) return count == 3 ? 4 : count;
+  if (count <= 7) return 8;
+  if (count <= 15) return 16;
+  if (count <= 31) return 32;
+  if (count <= 127) return 64;
+  return 128;
+}
+
+void resetTrace() {
+  std::fill(std::begin(gTrace), std::end(gTrace), 0);
+  gPrevious = 0;
+}
+
+// 本次执行是否出现了新的边或新的次数档，并记入已见集合
+bool newCoverage() {
+  bool found = false;
+  for (std::size_t i = 0; i < kMapSize; ++i) {
+    if (gTrace[i] != 0) {
+      std::uint8_t bits = bucket(gTrace[i]);
+      if ((bits & ~gVirgin[i]) != 0) {
+        gVirgin[i] |= bits;
+        found = true;
+      }
+    }
+  }
+  return found;
+}
+
+std::size_t coveredEdges() {
+  return static_cast<std::size_t>(
+      std::count_if(std::begin(gVirgin), std::end(gVirgin),
+                    [](std::uint8_t bits) { return bits != 0; }));
+}
+
+#else
+
+void resetTrace() {}
+bool newCoverage() { return false; }
+std::size_t coveredEdges() { return 0; }
+
+#endif
+
+// 进程内执行时崩溃的输入由信号处理函数写入 crash.txt
+std::string gCrashPath;
+const std::string* gCurrent = nullptr;
+
+void onCrash(int sig) {
+  if (gCurrent != nullptr) {
+    int fd = ::open(gCrashPath.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd >= 0) {
+      [[maybe_unused]] ssize_t written =
+          ::write(fd, gCurrent->data(), gCurrent->size());
+      ::close(fd);
+    }
+    const char message[] = "crashed, input saved to crash.txt\n";
+    [[maybe_unused]] ssize_t written =
+        ::write(STDERR_FILENO, message, sizeof(message) - 1);
+  }
+  ::signal(sig, SIG_DFL);
+  ::raise(sig);
+}
+
+struct Outcome {
+  std::string output;
+  // 双方都在限制内结束时才比较输出
+  bool finished{false};
+};
+
+Outcome runOurs(const std::string& text) {
+  std::ostringstream out;
+  Outcome outcome;
+  gCurrent = &text;
+  {
+    Session::Options options;
+    options.maxJumps = kMaxJumps;
+    Session session(options, out, -1);
+    Input& input = session.program().input();
+    input.feed(text);
+    input.close();
+    Session::Step step;
+    do {
+      step = session.step(VM::kUnlimited);
+    } while (step != Session::Step::QUIT && step != Session::Step::END &&
+             step != Session::Step::IDLE);
+    session.program().output().flush();
+  }
+  gCurrent = nullptr;
+  outcome.output = out.str();
+  // 跳转上限的错误与程序输出写在一起
+  outcome.finished =
+      outcome.output.find("JUMP LIMIT EXCEEDED") == std::string::npos;
+  return outcome;
+}
+
+// 启动标准程序，输入经管道写入，读回标准输出；超时视为未结束。
+Outcome runReference(const std::string& reference, const std::string& text) {
+  Outcome outcome;
+  int in[2];
+  int out[2];
+  if (::pipe2(in, O_CLOEXEC) != 0) return outcome;
+  if (::pipe2(out, O_CLOEXEC) != 0) {
+    ::close(in[0]);
+    ::close(in[1]);
+    return outcome;
+  }
+  posix_spawn_file_actions_t actions;
+  posix_spawn_file_actions_init(&actions);
+  posix_spawn_file_actions_adddup2(&actions, in[0], STDIN_FILENO);
+  posix_spawn_file_actions_adddup2(&actions, out[1], STDOUT_FILENO);
+  posix_spawn_file_actions_addopen(&actions, STDERR_FILENO, "/dev/null",
+                                   O_WRONLY, 0);
+  char* argv[] = {const_cast<char*>(reference.c_str()), nullptr};
+  pid_t pid;
+  int spawned =
+      posix_spawn(&pid, reference.c_str(), &actions, nullptr, argv, environ);
+  posix_spawn_file_actions_destroy(&actions);
+  ::close(in[0]);
+  ::close(out[1]);
+  if (spawned != 0) {
+    std::fprintf(stderr, "cannot run %s\n", reference.c_str());
+    std::exit(2);
+  }
+
+  ::fcntl(in[1], F_SETFL, O_NONBLOCK);
+  int writeFd = in[1];
+  std::size_t written = 0;
+  bool timedOut = false;
+  auto deadline = std::chrono::steady_clock::now() + kReferenceTimeout;
+  char buffer[65536];
+  for (;;) {
+    if (writeFd >= 0 && written == text.size()) {
+      ::close(writeFd);
+      writeFd = -1;
+    }
+    auto left = std::chrono::duration_cast<std::chrono::milliseconds>(
+        deadline - std::chrono::steady_clock::now());
+    if (left.count() <= 0) {
+      timedOut = true;
+      break;
+    }
+    pollfd fds[2] = {{out[0], POLLIN, 0}, {writeFd, POLLOUT, 0}};
+    int ready =
+        ::poll(fds, writeFd >= 0 ? 2 : 1, static_cast<int>(left.count()));
+    if (ready < 0 && errno != EINTR) break;
+    if (ready <= 0) continue;
+    if (writeFd >= 0 && fds[1].revents != 0) {
+      ssize_t count =
+          ::write(writeFd, text.data() + written, text.size() - written);
+      if (count > 0) {
+        written += static_cast<std::size_t>(count);
+      } else if (count < 0 && errno != EAGAIN && errno != EINTR) {
+        written = text.size();
+      }
+    }
+    if (fds[0].revents != 0) {
+      ssize_t count = ::read(out[0], buffer, sizeof(buffer));
+      if (count > 0) {
+        outcome.output.append(buffer, static_cast<std::size_t>(count));
+      } else if (count == 0 || errno != EINTR) {
+        break;
+      }
+    }
+  }
+  if (writeFd >= 0) ::close(writeFd);
+  ::close(out[0]);
+  if (timedOut) ::kill(pid, SIGKILL);
+  int status;
+  while (::waitpid(pid, &status, 0) < 0 && errno == EINTR) {
+  }
+  outcome.finished = !timedOut;
+  return outcome;
+}
+
+std::vector<std::string> splitLines(const std::string& text) {
+  std::vector<std::string> lines;
+  std::size_t begin = 0;
+  while (begin < text.size()) {
+    std::size_t end = text.find('\n', begin);
+    if (end == std::string::npos) end = text.size();
+    lines.push_back(text.substr(begin, end - begin));
+    begin = end + 1;
+  }
+  return lines;
+}
+
+std::string joinLines(const std::vector<std::string>& lines) {
+  std::string text;
+  for (const std::string& line : lines) {
+    text += line;
+    text += '\n';
+  }
+  return text;
+}
+
+// 差异的特征：逐行比较（去掉 INPUT 的 " ? " 提示）后，第一行只在标准程序
+// 输出中的行与第一行只在我们输出中的行，数字归一为 N。缩减时要求特征不变，
+// 也用来给差异去重。
+std::string diffKey(const std::string& expected, const std::string& actual) {
+  auto lines = [](const std::string& text) {
+    std::string stripped;
+    for (std::size_t i = 0; i < text.size(); ++i) {
+      if (text.compare(i, 3, " ? ") == 0) {
+        i += 2;
+      } else {
+        stripped += text[i];
+      }
+    }
+    return splitLines(stripped);
+  };
+  auto normalize = [](const std::string& line) {
+    std::string result;
+    for (std::size_t i = 0; i < line.size(); ++i) {
+      if (std::isdigit(static_cast<unsigned char>(line[i]))) {
+        if (i == 0 || !std::isdigit(static_cast<unsigned char>(line[i - 1]))) {
+          result += 'N';
+        }
+      } else {
+        result += line[i];
+      }
+    }
+    return result;
+  };
+  std::vector<std::string> a = lines(expected);
+  std::vector<std::string> b = lines(actual);
+  std::size_t head = 0;
+  while (head < a.size() && head < b.size() && a[head] == b[head]) ++head;
+  std::size_t tail = 0;
+  while (tail < a.size() - head && tail < b.size() - head &&
+         a[a.size() - 1 - tail] == b[b.size() - 1 - tail]) {
+    ++tail;
+  }
+  std::size_t n = a.size() - head - tail;
+  std::size_t m = b.size() - head - tail;
+  std::string removed;
+  std::string added;
+  if (n * m <= 1000000) {
+    // 最长公共子序列，找出第一行删去的与第一行新增的
+    std::vector<std::vector<unsigned>> lcs(n + 1, std::vector<unsigned>(m + 1));
+    for (std::size_t i = n; i-- > 0;) {
+      for (std::size_t j = m; j-- > 0;) {
+        lcs[i][j] = a[head + i] == b[head + j]
+                        ? lcs[i + 1][j + 1] + 1
+                        : std::max(lcs[i + 1][j], lcs[i][j + 1]);
+      }
+    }
+    bool haveRemoved = false;
+    bool haveAdded = false;
+    for (std::size_t i = 0, j = 0;
+         (i < n || j < m) && !(haveRemoved && haveAdded);) {
+      if (i < n && j < m && a[head + i] == b[head + j]) {
+        ++i;
+        ++j;
+      } else if (j < m && (i == n || lcs[i][j + 1] >= lcs[i + 1][j])) {
+        if (!haveAdded) added = normalize(b[head + j]);
+        haveAdded = true;
+        ++j;
+      } else {
+        if (!haveRemoved) removed = normalize(a[head + i]);
+        haveRemoved = true;
+        ++i;
+      }
+    }
+  } else {
+    removed = n > 0 ? normalize(a[head]) : "";
+    added = m > 0 ? normalize(b[head]) : "";
+  }
+  return "-" + removed + " | +" + added;
+}
+
+// 按文法生成程序、语句与表达式，以及对已有输入的变异。
+class Generator {
+ public:
+  Generator(std::uint32_t seed, bool scope) : rng_(seed), scope_(scope) {}
+
+  std::string program() {
+    std::vector<int> numbers;
+    int count = 1 + pick(12);
+    int number = 0;
+    for (int i = 0; i < count; ++i) {
+      number += chance(80) ? 10 : 1 + pick(15);
+      numbers.push_back(number);
+    }
+    std::vector<std::string> lines;
+    for (std::size_t i = 0; i < numbers.size(); ++i) {
+      // 计数循环：LET k = 0 … LET k = k + 1、IF k < N THEN 回到循环体开头
+      if (chance(12) && i + 3 < numbers.size()) {
+        std::string counter = chance(50) ? "k" : "m";
+        lines.push_back(std::to_string(numbers[i]) + " LET " + counter +
+                        " = 0");
+        std::size_t body = i + 1;
+        std::size_t last = std::min(numbers.size() - 2, body + pick(3));
+        for (std::size_t j = body; j <= last; ++j) {
+          lines.push_back(std::to_string(numbers[j]) + " " +
+                          statement(numbers, numbers[j], false));
+        }
+        lines.push_back(std::to_string(numbers[last + 1]) + " LET " + counter +
+                        " = " + counter + " + 1");
+        if (last + 2 < numbers.size()) {
+          lines.push_back(std::to_string(numbers[last + 2]) + " IF " +
+                          counter + " < " + std::to_string(1 + pick(20)) +
+                          " THEN " + std::to_string(numbers[body]));
+        }
+        i = last + 2;
+        continue;
+      }
+      lines.push_back(std::to_string(numbers[i]) + " " +
+                      statement(numbers, numbers[i], true));
+    }
+    // 有时打乱输入顺序、覆盖或删除已有的行
+    if (chance(20)) std::shuffle(lines.begin(), lines.end(), rng_);
+    if (chance(15)) {
+      int target = element(numbers);
+      lines.push_back(std::to_string(target) + " " +
+                      statement(numbers, target, true));
+    }
+    if (chance(10)) {
+      lines.push_back(std::to_string(element(numbers)));
+    }
+    if (chance(8)) lines.push_back("LIST");
+    lines.push_back("RUN");
+    for (int i = pick(4); i > 0; --i) lines.push_back(inputValue());
+    if (chance(15)) lines.push_back(immediate());
+    if (chance(8)) lines.push_back("LIST");
+    if (chance(5)) lines.push_back("CLEAR");
+    if (chance(8)) lines.push_back("RUN");
+    if (chance(90)) lines.push_back("QUIT");
+    return joinLines(lines);
+  }
+
+  // 一条程序语句，不含行号；loops 为假时不产生向后的跳转
+  std::string statement(const std::vector<int>& numbers, int self,
+                        bool loops) {
+    int kind = pick(scope_ ? 100 : 90);
+    if (kind < 30) return "LET " + variable() + " = " + expression(3);
+    if (kind < 52) return "PRINT " + expression(3);
+    if (kind < 58) return "INPUT " + variable();
+    if (kind < 66) return "GOTO " + target(numbers, self, loops);
+    if (kind < 78) {
+      static const char* const kCompare[] = {"<", ">", "="};
+      return "IF " + expression(2) + " " + kCompare[pick(3)] + " " +
+             expression(2) + " THEN " + target(numbers, self, loops);
+    }
+    if (kind < 84) return "REM " + remark();
+    if (kind < 90) return "END";
+    return kind < 95 ? "INDENT" : "DEDENT";
+  }
+
+  std::string expression(int depth) {
+    if (depth == 0 || chance(35)) {
+      return chance(55) ? variable() : number();
+    }
+    if (chance(15)) return "( " + expression(depth - 1) + " )";
+    // 一元负号两边都不支持，偶尔用来检查错误信息
+    if (chance(3)) return "- " + expression(depth - 1);
+    static const char* const kOperator[] = {"+", "-", "*", "/"};
+    return expression(depth - 1) + " " + kOperator[pick(4)] + " " +
+           expression(depth - 1);
+  }
+
+  // 对已有输入按行变异：替换、插入、删除、复制、交换行，改写数字，
+  // 或拼入另一份输入中的若干行。
+  std::string mutate(const std::string& text, const std::string& donor) {
+    std::vector<std::string> lines = splitLines(text);
+    std::vector<int> numbers = lineNumbers(lines);
+    for (int rounds = 1 + pick(3); rounds > 0; --rounds) {
+      int size = static_cast<int>(lines.size());
+      int at = size == 0 ? 0 : pick(size);
+      switch (pick(7)) {
+        case 0:
+          if (size > 0 && !numbers.empty()) {
+            int number = leadingNumber(lines[at]);
+            if (number > 0) {
+              lines[at] = std::to_string(number) + " " +
+                          statement(numbers, number, true);
+            }
+          }
+          break;
+        case 1: {
+          // 行号可能是变异出的极大值，限制范围以免溢出
+          int last = numbers.empty() ? 0 : std::min(numbers.back(), 100000);
+          int number = 1 + pick(last + 100);
+          numbers.push_back(number);
+          lines.insert(lines.begin() + at,
+                       std::to_string(number) + " " +
+                           statement(numbers, number, true));
+          break;
+        }
+        case 2:
+          if (size > 1) lines.erase(lines.begin() + at);
+          break;
+        case 3:
+          if (size > 0) lines.insert(lines.begin() + pick(size), lines[at]);
+          break;
+        case 4:
+          if (size > 1) std::swap(lines[at], lines[pick(size)]);
+          break;
+        case 5:
+          if (size > 0) lines[at] = replaceNumber(lines[at]);
+          break;
+        case 6: {
+          std::vector<std::string> other = splitLines(donor);
+          if (!other.empty()) {
+            int from = pick(static_cast<int>(other.size()));
+            int length = 1 + pick(4);
+            auto end = other.begin() + std::min<int>(
+                                           from + length,
+                                           static_cast<int>(other.size()));
+            lines.insert(lines.begin() + at, other.begin() + from, end);
+          }
+          break;
+        }
+      }
+    }
+    return joinLines(lines);
+  }
+
+ private:
+  std::mt19937 rng_;
+  bool scope_;
+
+  int pick(int n) { return std::uniform_int_distribution<int>(0, n - 1)(rng_); }
+  bool chance(int percent) { return pick(100) < percent; }
+  int element(const std::vector<int>& values) {
+    return values[pick(static_cast<int>(values.size()))];
+  }
+
+  std::string variable() {
+    static const char* const kNames[] = {"a", "b", "c", "i", "n",
+                                         "x", "y", "total", "A", "ab1"};
+    // 偶尔用关键字作变量名
+    if (chance(2)) return chance(50) ? "LET" : "THEN";
+    return kNames[pick(10)];
+  }
+
+  std::string number() {
+    static const char* const kEdge[] = {"0",     "1",          "2147483647",
+                                        "46341", "2147483648", "65536",
+                                        "100",   "007"};
+    if (chance(10)) return kEdge[pick(8)];
+    return std::to_string(chance(80) ? pick(21) : pick(100000));
+  }
+
+  std::string remark() {
+    static const char* const kWords[] = {"loop", "check", "PRINT", "x = 1",
+                                         "end",  "",      "GOTO 10"};
+    return kWords[pick(7)];
+  }
+
+  std::string target(const std::vector<int>& numbers, int self, bool loops) {
+    // 多数跳向后面的行，以免生成大量死循环；偶尔跳向不存在的行
+    if (chance(8)) return std::to_string(pick(1000));
+    std::vector<int> candidates;
+    for (int number : numbers) {
+      if (number > self || (loops && chance(10))) candidates.push_back(number);
+    }
+    if (candidates.empty()) return std::to_string(numbers.back());
+    return std::to_string(element(candidates));
+  }
+
+  std::string inputValue() {
+    static const char* const kOdd[] = {"", "abc", " 7 ", "+3", "-0", "1 2",
+                                       "99999999999"};
+    if (chance(25)) return kOdd[pick(7)];
+    return std::to_string(pick(41) - 20);
+  }
+
+  std::string immediate() {
+    switch (pick(3)) {
+      case 0:
+        return "PRINT " + expression(2);
+      case 1:
+        return "LET " + variable() + " = " + expression(2);
+      default:
+        return "INPUT " + variable();
+    }
+  }
+
+  std::string replaceNumber(const std::string& line) {
+    std::vector<std::size_t> starts;
+    for (std::size_t i = 0; i < line.size(); ++i) {
+      if (std::isdigit(static_cast<unsigned char>(line[i])) &&
+          (i == 0 || !std::isdigit(static_cast<unsigned char>(line[i - 1])))) {
+        starts.push_back(i);
+      }
+    }
+    if (starts.empty()) return line;
+    std::size_t begin = starts[pick(static_cast<int>(starts.size()))];
+    std::size_t end = begin;
+    while (end < line.size() &&
+           std::isdigit(static_cast<unsigned char>(line[end]))) {
+      ++end;
+    }
+    return line.substr(0, begin) + number() + line.substr(end);
+  }
+
+  static int leadingNumber(const std::string& line) {
+    if (line.empty() || !std::isdigit(static_cast<unsigned char>(line[0]))) {
+      return 0;
+    }
+    // 超出 int 的行号按 0 处理
+    long number = std::strtol(line.c_str(), nullptr, 10);
+    return number <= INT32_MAX ? static_cast<int>(number) : 0;
+  }
+
+  static std::vector<int> lineNumbers(const std::vector<std::string>& lines) {
+    std::vector<int> numbers;
+    for (const std::string& line : lines) {
+      if (int number = leadingNumber(line); number > 0) {
+        numbers.push_back(number);
+      }
+    }
+    std::sort(numbers.begin(), numbers.end());
+    return numbers;
+  }
+};
+
+// 删除若干单元后 keeps 仍成立则接受，块大小从一半逐步减到一个。
+std::vector<std::string> reduce(
+    std::vector<std::string> units,
+    const std::function<bool(const std::vector<std::string>&)>& keeps) {
+  std::size_t chunk = std::max<std::size_t>(units.size() / 2, 1);
+  for (;;) {
+    bool removed = false;
+    for (std::size_t start = 0; start < units.size() && units.size() > 1;) {
+      std::vector<std::string> candidate(units.begin(), units.begin() + start);
+      candidate.insert(candidate.end(),
+                       units.begin() + std::min(start + chunk, units.size()),
+                       units.end());
+      if (keeps(candidate)) {
+        units = std::move(candidate);
+        removed = true;
+      } else {
+        start += chunk;
+      }
+    }
+    if (!removed) {
+      if (chunk == 1) break;
+      chunk /= 2;
+    }
+  }
+  return units;
+}
+
+std::vector<std::string> splitWords(const std::string& line) {
+  std::vector<std::string> words;
+  std::istringstream in(line);
+  std::string word;
+  while (in >> word) words.push_back(word);
+  return words;
+}
+
+std::string joinWords(const std::vector<std::string>& words) {
+  std::string line;
+  for (const std::string& word : words) {
+    if (!line.empty()) line += ' ';
+    line += word;
+  }
+  return line;
+}
+
+class Fuzzer {
+ public:
+  Fuzzer(std::string reference, std::string outputDir)
+      : reference_(std::move(reference)), outputDir_(std::move(outputDir)) {}
+
+  // 执行一个输入：进程内的一次带覆盖反馈，有新覆盖时加入语料；
+  // 与标准程序的输出不同且是新的差异时缩减并保存。
+  void test(const std::string& text) {
+    ++runs_;
+    resetTrace();
+    Outcome ours = runOurs(text);
+    if (newCoverage()) corpus_.push_back(text);
+    if (!ours.finished) {
+      ++unfinished_;
+      return;
+    }
+    Outcome expected = runReference(reference_, text);
+    if (!expected.finished) {
+      ++unfinished_;
+      return;
+    }
+    if (expected.output == ours.output) return;
+    std::string key = diffKey(expected.output, ours.output);
+    if (!keys_.insert(key).second) {
+      ++duplicates_;
+      return;
+    }
+    report(minimize(text, key), key);
+  }
+
+  std::vector<std::string>& corpus() noexcept { return corpus_; }
+
+  void status(double seconds) const {
+    std::printf("runs %zu (%.0f/s), corpus %zu, edges %zu, unfinished %zu, "
+                "differences %zu (+%zu duplicate)\n",
+                runs_, seconds > 0 ? runs_ / seconds : 0.0, corpus_.size(),
+                coveredEdges(), unfinished_, keys_.size(), duplicates_);
+    std::fflush(stdout);
+  }
+
+  std::size_t differences() const noexcept { return keys_.size(); }
+
+ private:
+  std::string reference_;
+  std::string outputDir_;
+  std::vector<std::string> corpus_;
+  std::set<std::string> keys_;
+  std::size_t runs_{0};
+  std::size_t unfinished_{0};
+  std::size_t duplicates_{0};
+
+  bool keepsDifference(const std::string& text, const std::string& key) {
+    Outcome ours = runOurs(text);
+    if (!ours.finished) return false;
+    Outcome expected = runReference(reference_, text);
+    return expected.finished && expected.output != ours.output &&
+           diffKey(expected.output, ours.output) == key;
+  }
+
+  // 先按行缩减，再逐行删去多余的词
+  std::string minimize(const std::string& text, const std::string& key) {
+    std::vector<std::string> lines =
+        reduce(splitLines(text), [&](const std::vector<std::string>& lines) {
+          return keepsDifference(joinLines(lines), key);
+        });
+    for (std::size_t i = 0; i < lines.size(); ++i) {
+      std::vector<std::string> words = splitWords(lines[i]);
+      words = reduce(words, [&](const std::vector<std::string>& words) {
+        std::vector<std::string> candidate = lines;
+        candidate[i] = joinWords(words);
+        return keepsDifference(joinLines(candidate), key);
+      });
+      lines[i] = joinWords(words);
+    }
+    return joinLines(lines);
+  }
+
+  void report(const std::string& text, const std::string& key) {
+    char name[32];
+    std::snprintf(name, sizeof(name), "diff-%03zu.txt", keys_.size());
+    std::string path = (std::filesystem::path(outputDir_) / name).string();
+    std::ofstream(path, std::ios::binary) << text;
+    std::printf("=== difference %zu: %s\n%s--- demo output:\n%s"
+                "--- our output:\n%s",
+                keys_.size(), path.c_str(), text.c_str(),
+                runReference(reference_, text).output.c_str(),
+                runOurs(text).output.c_str());
+    std::printf("--- first removed | added line: %s\n", key.c_str());
+    std::fflush(stdout);
+  }
+};
+
+void usage(const char* progname) {
+  std::printf("%s [-n runs] [-t seconds] [-s seed] [-r demo] [-c corpus_dir] "
+              "[-o output_dir] [-S]\n",
+              progname);
+  std::exit(2);
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+  std::size_t runs = 2000;
+  double seconds = 0;
+  std::uint32_t seed = static_cast<std::uint32_t>(
+      std::chrono::steady_clock::now().time_since_epoch().count());
+  std::string reference = "../Basic-Demo-64bit";
+  std::string corpusDir = "../test/";
+  std::string outputDir = "fuzz_diffs";
+  bool scope = true;
+  int c;
+  while ((c = ::getopt(argc, argv, "n:t:s:r:c:o:Sh")) != -1) {
+    switch (c) {
+      case 'n':
+        runs = std::strtoull(optarg, nullptr, 10);
+        break;
+      case 't':
+        seconds = std::atof(optarg);
+        break;
+      case 's':
+        seed = static_cast<std::uint32_t>(std::strtoul(optarg, nullptr, 10));
+        break;
+      case 'r':
+        reference = optarg;
+        break;
+      case 'c':
+        corpusDir = optarg;
+        break;
+      case 'o':
+        outputDir = optarg;
+        break;
+      case 'S':
+        scope = false;
+        break;
+      default:
+        usage(argv[0]);
+    }
+  }
+  if (::access(reference.c_str(), X_OK) != 0) {
+    std::fprintf(stderr, "cannot run %s\n", reference.c_str());
+    return 2;
+  }
+  ::signal(SIGPIPE, SIG_IGN);
+  std::error_code ec;
+  std::filesystem::create_directories(outputDir, ec);
+  gCrashPath = (std::filesystem::path(outputDir) / "crash.txt").string();
+  // 栈溢出时也要能执行信号处理函数
+  static char alternate[1 << 16];
+  stack_t stack{};
+  stack.ss_sp = alternate;
+  stack.ss_size = sizeof(alternate);
+  ::sigaltstack(&stack, nullptr);
+  struct sigaction action {};
+  action.sa_handler = onCrash;
+  action.sa_flags = SA_ONSTACK;
+  for (int sig : {SIGSEGV, SIGBUS, SIGFPE, SIGILL, SIGABRT}) {
+    ::sigaction(sig, &action, nullptr);
+  }
+  std::printf("seed %u\n", seed);
+
+  // 初始语料：测试点目录及其子目录中的 *.txt、*.in
+  std::vector<std::string> seeds;
+  using Iterator = std::filesystem::recursive_directory_iterator;
+  for (Iterator it(corpusDir, ec); it != Iterator(); it.increment(ec)) {
+    std::string ext = it->path().extension().string();
+    if (it->is_regular_file() && (ext == ".txt" || ext == ".in")) {
+      seeds.push_back(it->path().string());
+    }
+  }
+  std::sort(seeds.begin(), seeds.end());
+
+  Fuzzer fuzzer(reference, outputDir);
+  Generator generator(seed, scope);
+  std::mt19937 rng(seed);
+  auto start = std::chrono::steady_clock::now();
+  auto elapsed = [&start] {
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() -
+                                         start)
+        .count();
+  };
+  for (const std::string& path : seeds) {
+    std::ifstream in(path, std::ios::binary);
+    std::string text((std::istreambuf_iterator<char>(in)),
+                     std::istreambuf_iterator<char>());
+    if (!scope && text.find("DENT") != std::string::npos) continue;
+    fuzzer.test(text);
+  }
+  fuzzer.status(elapsed());
+
+  for (std::size_t i = 0; i < runs; ++i) {
+    if (seconds > 0 && elapsed() >= seconds) break;
+    std::vector<std::string>& corpus = fuzzer.corpus();
+    std::string text;
+    if (corpus.empty() || rng() % 4 == 0) {
+      text = generator.program();
+    } else {
+      const std::string& base = corpus[rng() % corpus.size()];
+      const std::string& donor = corpus[rng() % corpus.size()];
+      text = generator.mutate(base, donor);
+    }
+    fuzzer.test(text);
+    if ((i + 1) % 500 == 0) fuzzer.status(elapsed());
+  }
+  fuzzer.status(elapsed());
+  return fuzzer.differences() == 0 ? 0 : 1;
+}
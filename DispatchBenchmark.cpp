@@ -0,0 +1,111 @@
+// 比较 RUN 时每条语句的分派开销：逐行解释（Statement::execute 虚调用链）
+// 与字节码 VM。dispatch_benchmark 中的 VM 使用 computed goto 直接线索化分派，
+// dispatch_benchmark_switch 以 BASIC_SWITCH_DISPATCH 编译，使用 switch 分派。
+// 用法：dispatch_benchmark [迭代次数]，默认 1000000。
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "Lexer.hpp"
+#include "Parser.hpp"
+#include "Program.hpp"
+#include "Token.hpp"
+
+namespace {
+
+struct Workload {
+  const char* name;
+  std::vector<std::string> lines;
+  // 每轮循环执行的语句数
+  long long perRound;
+};
+
+constexpr int kBody = 16;
+
+// 循环体之后统一接计数与回跳：i = i + 1，IF i < n THEN 100
+std::vector<std::string> loop(const std::vector<std::string>& body,
+                              long long rounds) {
+  std::vector<std::string> lines = {"10 LET i = 0", "20 LET s = 0"};
+  int line = 100;
+  for (const std::string& stmt : body) {
+    lines.push_back(std::to_string(line) + " " + stmt);
+    line += 10;
+  }
+  lines.push_back(std::to_string(line) + " LET i = i + 1");
+  lines.push_back(std::to_string(line + 10) + " IF i < " +
+                  std::to_string(rounds) + " THEN 100");
+  return lines;
+}
+
+std::vector<Workload> makeWorkloads(long long rounds) {
+  std::vector<std::string> store(kBody, "LET a = 1");
+  std::vector<std::string> hop;
+  for (int i = 0; i < kBody; ++i) {
+    // 每条 GOTO 跳到紧接着的下一行
+    hop.push_back("GOTO " + std::to_string(100 + (i + 1) * 10));
+  }
+  std::vector<std::string> arith(kBody, "LET s = s + i * 3 - i / 7");
+  return {
+      {"const store", loop(store, rounds), kBody + 2},
+      {"goto hop", loop(hop, rounds), kBody + 2},
+      {"arithmetic", loop(arith, rounds), kBody + 2},
+  };
+}
+
+void load(Program& program, const std::vector<std::string>& lines) {
+  Lexer lexer;
+  Parser parser(program.symbols());
+  for (const std::string& line : lines) {
+    TokenStream tokens = lexer.tokenize(line);
+    std::unique_ptr<ParsedLine> parsed = parser.parseLine(tokens, line);
+    program.addStmt(parsed->getLine().value(), parsed->fetchStatement());
+  }
+}
+
+// 运行三次取最快的一次，返回毫秒。
+double timeRun(Program& program) {
+  double best = 0;
+  for (int i = 0; i < 3; ++i) {
+    auto start = std::chrono::steady_clock::now();
+    program.run();
+    auto end = std::chrono::steady_clock::now();
+    double ms = std::chrono::duration<double, std::milli>(end - start).count();
+    best = i == 0 ? ms : std::min(best, ms);
+  }
+  return best;
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+  long long rounds = argc > 1 ? std::atoll(argv[1]) : 1000000;
+#if defined(BASIC_SWITCH_DISPATCH) || !(defined(__GNUC__) || defined(__clang__))
+  const char* dispatch = "switch";
+#else
+  const char* dispatch = "threaded";
+#endif
+
+  std::printf("%lld rounds, VM dispatch: %s\n", rounds, dispatch);
+  for (const Workload& workload : makeWorkloads(rounds)) {
+    Program program;
+    load(program, workload.lines);
+    long long statements = 2 + rounds * workload.perRound;
+
+    program.setEngine(Program::Engine::TREE);
+    double treeMs = timeRun(program);
+    program.setEngine(Program::Engine::BYTECODE);
+    // 首次 RUN 含编译，先运行一次使计时只包含执行
+    program.run();
+    double vmMs = timeRun(program);
+
+    std::printf("  %-12s tree %6.2f ns/stmt   vm %6.2f ns/stmt   x%.2f\n",
+                workload.name, treeMs * 1e6 / statements,
+                vmMs * 1e6 / statements, treeMs / vmMs);
+  }
+  return 0;
+}
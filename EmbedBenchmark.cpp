@@ -0,0 +1,155 @@
+// 嵌入调用的延迟：同一个小程序分别经 Interpreter 在进程内执行（每次新建
+// 解释器，或复用同一个只重新 RUN），以及 posix_spawn 启动 ./code、经管道
+// 交互执行，比较每次的耗时并检查三者输出一致。
+// 用法：embed_benchmark [次数] [code 路径]，默认 1000 次、./code。
+
+#include <spawn.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <optional>
+#include <string>
+#include <vector>
+
+#include "Interpreter.hpp"
+#include "utils/Error.hpp"
+
+extern char** environ;
+
+namespace {
+
+const char* const kProgram =
+    "10 INPUT n\n"
+    "20 LET s = 0\n"
+    "30 LET i = 0\n"
+    "40 LET i = i + 1\n"
+    "50 LET s = s + i * i\n"
+    "60 IF i < n THEN 40\n"
+    "70 PRINT s\n";
+
+template <class Fn>
+double timeUs(Fn&& fn) {
+  auto start = std::chrono::steady_clock::now();
+  fn();
+  auto end = std::chrono::steady_clock::now();
+  return std::chrono::duration<double, std::micro>(end - start).count();
+}
+
+double median(std::vector<double> samples) {
+  auto mid = samples.begin() + static_cast<std::ptrdiff_t>(samples.size() / 2);
+  std::nth_element(samples.begin(), mid, samples.end());
+  return *mid;
+}
+
+std::string runEmbedded(Interpreter& interpreter, int n) {
+  std::string output;
+  interpreter.setOutput([&output](std::string_view text) { output += text; });
+  interpreter.setInput([n]() -> std::optional<std::string> {
+    return std::to_string(n);
+  });
+  interpreter.run();
+  return output;
+}
+
+// 启动 code，写入程序、RUN 与 INPUT 的值后关闭输入，读回全部输出。
+std::string runSpawned(const char* code, int n) {
+  int in[2];
+  int out[2];
+  if (::pipe(in) != 0 || ::pipe(out) != 0) {
+    std::perror("pipe");
+    std::exit(1);
+  }
+  posix_spawn_file_actions_t actions;
+  posix_spawn_file_actions_init(&actions);
+  posix_spawn_file_actions_adddup2(&actions, in[0], STDIN_FILENO);
+  posix_spawn_file_actions_adddup2(&actions, out[1], STDOUT_FILENO);
+  posix_spawn_file_actions_addclose(&actions, in[1]);
+  posix_spawn_file_actions_addclose(&actions, out[0]);
+  char* argv[] = {const_cast<char*>(code), nullptr};
+  pid_t pid;
+  if (posix_spawn(&pid, code, &actions, nullptr, argv, environ) != 0) {
+    std::fprintf(stderr, "cannot run %s\n", code);
+    std::exit(1);
+  }
+  posix_spawn_file_actions_destroy(&actions);
+  ::close(in[0]);
+  ::close(out[1]);
+  std::string request = std::string(kProgram) + "RUN\n" + std::to_string(n) + "\n";
+  [[maybe_unused]] ssize_t written = ::write(in[1], request.data(), request.size());
+  ::close(in[1]);
+  std::string output;
+  char buffer[4096];
+  ssize_t count;
+  while ((count = ::read(out[0], buffer, sizeof(buffer))) > 0) {
+    output.append(buffer, static_cast<std::size_t>(count));
+  }
+  ::close(out[0]);
+  int status;
+  ::waitpid(pid, &status, 0);
+  return output;
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+  int iterations = argc > 1 ? std::atoi(argv[1]) : 1000;
+  const char* code = argc > 2 ? argv[2] : "./code";
+  const int n = 100;
+  bool mismatch = false;
+
+  std::string expected;
+  {
+    Interpreter interpreter;
+    interpreter.load(kProgram);
+    expected = runEmbedded(interpreter, n);
+    if (interpreter.variable("s") != 338350) {
+      std::printf("MISMATCH: s = %d\n", interpreter.variable("s").value_or(-1));
+      mismatch = true;
+    }
+  }
+
+  std::vector<double> fresh;
+  std::vector<double> reused;
+  try {
+    for (int i = 0; i < iterations; ++i) {
+      std::string output;
+      fresh.push_back(timeUs([&] {
+        Interpreter interpreter;
+        interpreter.load(kProgram);
+        output = runEmbedded(interpreter, n);
+      }));
+      mismatch = mismatch || output != expected;
+    }
+    Interpreter interpreter;
+    interpreter.load(kProgram);
+    for (int i = 0; i < iterations; ++i) {
+      std::string output;
+      reused.push_back(timeUs([&] { output = runEmbedded(interpreter, n); }));
+      mismatch = mismatch || output != expected;
+    }
+  } catch (const BasicError& e) {
+    std::printf("%s\n", e.message().c_str());
+    return 1;
+  }
+
+  // 启动进程慢得多，次数取十分之一
+  std::vector<double> spawned;
+  for (int i = 0; i < std::max(1, iterations / 10); ++i) {
+    std::string output;
+    spawned.push_back(timeUs([&] { output = runSpawned(code, n); }));
+    mismatch = mismatch || output != expected;
+  }
+
+  std::printf("in-process, new interpreter  %10.1f us/run\n", median(fresh));
+  std::printf("in-process, reused           %10.1f us/run\n", median(reused));
+  std::printf("posix_spawn %-17s %10.1f us/run\n", code, median(spawned));
+  if (mismatch) {
+    std::printf("MISMATCH: outputs differ\n");
+    return 1;
+  }
+  return 0;
+}
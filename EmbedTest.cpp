@@ -0,0 +1,85 @@
+// 嵌入接口测试：曾使宿主进程崩溃的输入（INT_MIN / -1、嵌套过深的括号）
+// 经 Interpreter 的 load、run 与 execute 传入时，须以 BasicError 或输出中的
+// 错误信息报告，之后同一个解释器照常工作。逐行解释、字节码与首次到达即
+// 编译机器码三种执行方式各测一遍。
+// 用法：embed_test
+
+#include <cstdio>
+#include <functional>
+#include <string>
+
+#include "Interpreter.hpp"
+#include "utils/Error.hpp"
+
+namespace {
+
+int failures = 0;
+
+void check(const char* engine, const std::string& what,
+           const std::string& expected, const std::string& actual) {
+  if (actual != expected) {
+    std::printf("FAIL %s: %s: expected \"%s\", got \"%s\"\n", engine,
+                what.c_str(), expected.c_str(), actual.c_str());
+    ++failures;
+  }
+}
+
+// 执行 fn，返回它抛出的 BasicError 的信息，没有抛出时返回空串。
+std::string errorOf(const std::function<void()>& fn) {
+  try {
+    fn();
+  } catch (const BasicError& e) {
+    return e.message();
+  }
+  return "";
+}
+
+void testEngine(const char* engine, const Interpreter::Options& options) {
+  Interpreter interpreter(options);
+  std::string output;
+  interpreter.setOutput([&output](std::string_view text) { output += text; });
+  const std::string deep =
+      std::string(100000, '(') + "1" + std::string(100000, ')');
+
+  interpreter.execute("LET A = 0 - 2147483647 - 1");
+  interpreter.execute("LET B = 0 - 1");
+  check(engine, "execute A / B", "INTEGER OVERFLOW",
+        errorOf([&] { interpreter.execute("PRINT A / B"); }));
+  interpreter.load("10 LET C = 3\n20 PRINT A / (C - 4)\n30 PRINT C\n");
+  check(engine, "run A / B", "INTEGER OVERFLOW",
+        errorOf([&] { interpreter.run(); }));
+  check(engine, "execute deep", "EXPRESSION TOO DEEP",
+        errorOf([&] { interpreter.execute("PRINT " + deep); }));
+  output.clear();
+  interpreter.load("40 PRINT " + deep + "\n");
+  check(engine, "load deep", "EXPRESSION TOO DEEP\n", output);
+
+  // 出错后解释器仍可使用，出错前的赋值保留
+  output.clear();
+  check(engine, "execute after errors", "",
+        errorOf([&] { interpreter.execute("PRINT A / 2"); }));
+  interpreter.load("20 PRINT C * 2\n");
+  check(engine, "run after errors", "",
+        errorOf([&] { interpreter.run(); }));
+  check(engine, "output after errors", "-1073741824\n6\n3\n", output);
+}
+
+}  // namespace
+
+int main() {
+  Interpreter::Options tree;
+  tree.engine = Program::Engine::TREE;
+  testEngine("tree", tree);
+
+  Interpreter::Options bytecode;
+  bytecode.jitThreshold = 0;
+  testEngine("bytecode", bytecode);
+
+  Interpreter::Options jit;
+  jit.jitThreshold = 1;
+  testEngine("jit", jit);
+
+  std::printf("%s\n", failures == 0 ? "embedding errors: Pass"
+                                    : "embedding errors: Fail");
+  return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,118 @@
+// 对比语法树递归求值与展开后的后缀数组求值的吞吐。
+// 用法：expression_benchmark [每个表达式的求值次数]，默认 2000000。
+
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <functional>
+#include <vector>
+
+#include "Arena.hpp"
+#include "Expression.hpp"
+#include "VarState.hpp"
+
+namespace {
+
+constexpr int kVars = 4;
+
+std::int64_t sink = 0;
+
+struct Case {
+  const char* name;
+  // 在 arena 中构造表达式树，返回根节点与节点数
+  std::function<Expression*(Arena&, int&)> build;
+};
+
+Expression* leaf(Arena& arena, int index, int& nodes) {
+  ++nodes;
+  if (index % 2 == 0) {
+    return arena.make<VariableExpression>(index / 2 % kVars);
+  }
+  return arena.make<ConstExpression>(index + 1);
+}
+
+Expression* node(Arena& arena, Expression* left, char op, Expression* right,
+                 int& nodes) {
+  ++nodes;
+  return arena.make<CompoundExpression>(left, op, right);
+}
+
+// s + i * 3 - i / 7
+Expression* loopBody(Arena& arena, int& nodes) {
+  Expression* mul = node(arena, leaf(arena, 2, nodes), '*',
+                         leaf(arena, 1, nodes), nodes);
+  Expression* div = node(arena, leaf(arena, 2, nodes), '/',
+                         leaf(arena, 5, nodes), nodes);
+  Expression* sum = node(arena, leaf(arena, 0, nodes), '+', mul, nodes);
+  return node(arena, sum, '-', div, nodes);
+}
+
+// a + 1 + b + 3 + ...，解析左结合运算得到的左深树
+Expression* leftChain(Arena& arena, int& nodes, int terms) {
+  Expression* expr = leaf(arena, 0, nodes);
+  for (int i = 1; i < terms; ++i) {
+    expr = node(arena, expr, i % 3 == 0 ? '-' : '+', leaf(arena, i, nodes),
+                nodes);
+  }
+  return expr;
+}
+
+// a - (1 + (b - (3 + ...)))，层层括号得到的右深树
+Expression* rightNest(Arena& arena, int& nodes, int depth) {
+  Expression* expr = leaf(arena, depth, nodes);
+  for (int i = depth - 1; i >= 0; --i) {
+    expr = node(arena, leaf(arena, i, nodes), i % 2 == 0 ? '-' : '+', expr,
+                nodes);
+  }
+  return expr;
+}
+
+double timeMs(const Expression* expr, const VarState& state, long long n) {
+  auto start = std::chrono::steady_clock::now();
+  for (long long i = 0; i < n; ++i) {
+    sink += expr->evaluate(state);
+  }
+  auto end = std::chrono::steady_clock::now();
+  return std::chrono::duration<double, std::milli>(end - start).count();
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+  long long rounds = argc > 1 ? std::atoll(argv[1]) : 2000000;
+  VarState state;
+  for (int slot = 0; slot < kVars; ++slot) {
+    state.setValue(slot, slot + 2);
+  }
+
+  const Case cases[] = {
+      {"a + 1", [](Arena& a, int& n) {
+         return node(a, leaf(a, 0, n), '+', leaf(a, 1, n), n);
+       }},
+      {"loop body", loopBody},
+      {"left chain 64", [](Arena& a, int& n) { return leftChain(a, n, 64); }},
+      {"right nest 32", [](Arena& a, int& n) { return rightNest(a, n, 32); }},
+  };
+
+  std::printf("%lld evaluations per expression\n", rounds);
+  for (const Case& c : cases) {
+    Arena arena;
+    int nodes = 0;
+    Expression* tree = c.build(arena, nodes);
+    Expression* flat = PostfixExpression::flatten(tree, arena);
+    if (tree->evaluate(state) != flat->evaluate(state)) {
+      std::printf("  %-14s result mismatch\n", c.name);
+      return 1;
+    }
+    double treeMs = timeMs(tree, state, rounds);
+    double flatMs = timeMs(flat, state, rounds);
+    std::printf(
+        "  %-14s %3d nodes  tree %7.1f Mnodes/s  postfix %7.1f Mnodes/s  "
+        "x%.2f\n",
+        c.name, nodes, nodes * rounds / treeMs / 1e3,
+        nodes * rounds / flatMs / 1e3, treeMs / flatMs);
+  }
+  std::printf("(checksum %lld)\n", static_cast<long long>(sink));
+  return 0;
+}
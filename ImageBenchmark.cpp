@@ -0,0 +1,103 @@
+// 程序映像的载入耗时：同一个大程序分别以文本（--load，顺序与并行解析）
+// 与 SAVE IMAGE 保存的映像载入，计时包含映射文件与建好 Recorder 行表。
+// 映像载入后的程序再次保存，须与原映像逐字节相同。
+// 用法：image_benchmark [行数]，默认 500000。
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <iterator>
+#include <string>
+
+#include "Lexer.hpp"
+#include "Loader.hpp"
+#include "Optimizer.hpp"
+#include "Parser.hpp"
+#include "Program.hpp"
+
+namespace {
+
+const char* const kSource = "image_benchmark.bas";
+const char* const kImage = "image_benchmark.img";
+const char* const kResaved = "image_benchmark2.img";
+
+std::string statementAt(int i, int lines) {
+  switch (i % 6) {
+    case 0:
+      return "LET " + std::string(1, 'a' + i % 26) + " = a + " +
+             std::to_string(i % 13) + " * b - (c / 3) * (d + 1)";
+    case 1:
+      return "LET b = b + 1";
+    case 2:
+      return "IF b * 2 > c + 1000 THEN " +
+             std::to_string((i * 7919LL % lines + 1) * 10);
+    case 3:
+      return "PRINT a - b";
+    case 4:
+      return "REM step " + std::to_string(i);
+    default:
+      return "GOTO " + std::to_string((i + 2) * 10);
+  }
+}
+
+std::string readFile(const char* path) {
+  std::ifstream in(path, std::ios::binary);
+  return std::string(std::istreambuf_iterator<char>(in), {});
+}
+
+template <class Fn>
+double measure(Fn&& fn) {
+  auto start = std::chrono::steady_clock::now();
+  fn();
+  auto end = std::chrono::steady_clock::now();
+  return std::chrono::duration<double, std::milli>(end - start).count();
+}
+
+double loadText(std::size_t jobs) {
+  Program program;
+  Lexer lexer;
+  Parser parser(program.symbols());
+  Optimizer optimizer;
+  Loader loader(lexer, parser, optimizer);
+  loader.setJobs(jobs);
+  return measure([&] { loader.loadFile(kSource, program); });
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+  int lines = argc > 1 ? std::atoi(argv[1]) : 500000;
+  {
+    std::ofstream out(kSource);
+    for (int i = 0; i < lines; ++i) {
+      out << (i + 1) * 10 << " " << statementAt(i, lines) << "\n";
+    }
+  }
+  {
+    Program program;
+    Lexer lexer;
+    Parser parser(program.symbols());
+    Optimizer optimizer;
+    Loader(lexer, parser, optimizer).loadFile(kSource, program);
+    program.saveImage(kImage);
+  }
+
+  double sequential = loadText(1);
+  double parallel = loadText(0);
+  Program program;
+  double image = measure([&] { program.loadImage(kImage); });
+  program.saveImage(kResaved);
+  bool same = readFile(kImage) == readFile(kResaved);
+
+  std::printf("%d lines, source %zu bytes, image %zu bytes\n", lines,
+              readFile(kSource).size(), readFile(kImage).size());
+  std::printf("  text, 1 thread   %8.1f ms\n", sequential);
+  std::printf("  text, parallel   %8.1f ms\n", parallel);
+  std::printf("  image            %8.1f ms\n", image);
+  std::printf("  resaved image %s\n", same ? "identical" : "DIFFERS");
+  std::remove(kSource);
+  std::remove(kImage);
+  std::remove(kResaved);
+  return same ? 0 : 1;
+}
@@ -0,0 +1,100 @@
+// INPUT 读入路径的吞吐基准：逐行 std::getline 加手写解析，对比按块读入的
+// Input 加 std::from_chars。
+// 用法：input_benchmark [数值个数]，默认 10M 个。
+
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <optional>
+#include <random>
+#include <string>
+#include <string_view>
+
+#include "Input.hpp"
+
+namespace {
+
+long long sink = 0;
+
+template <class Fn>
+double timeMs(Fn&& fn) {
+  auto start = std::chrono::steady_clock::now();
+  fn();
+  auto end = std::chrono::steady_clock::now();
+  return std::chrono::duration<double, std::milli>(end - start).count();
+}
+
+// 旧版 INPUTStatement::readValue 的解析方式（不含提示与重试）。
+int legacyParse(std::string input) {
+  int sign = 1;
+  int value = 0;
+  if (input[0] == '-') {
+    sign = -1;
+    input = input.substr(1);
+  }
+  for (auto c : input) {
+    if (c >= '0' && c <= '9') {
+      value = value * 10 + c - '0';
+    }
+  }
+  return value * sign;
+}
+
+void report(const char* name, double ms, long long count, long long bytes) {
+  std::printf("  %-26s %9.1f ms  %7.1f M values/s  %7.1f MB/s\n", name, ms,
+              count / ms / 1e3, bytes / ms / 1e3);
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+  long long count = argc > 1 ? std::atoll(argv[1]) : 10000000;
+
+  char path[] = "/tmp/input_benchmark_XXXXXX";
+  int fd = ::mkstemp(path);
+  if (fd < 0) {
+    std::perror("mkstemp");
+    return 1;
+  }
+  long long bytes = 0;
+  {
+    std::ofstream out(path);
+    std::mt19937 rng(20251201);
+    std::uniform_int_distribution<int> dist(-1000000000, 1000000000);
+    for (long long i = 0; i < count; ++i) {
+      std::string line = std::to_string(dist(rng)) + "\n";
+      bytes += line.size();
+      out << line;
+    }
+  }
+
+  std::printf("%lld values, %.1f MB\n", count, bytes / 1e6);
+  report("getline + manual parse", timeMs([&] {
+           std::ifstream in(path);
+           std::string line;
+           while (std::getline(in, line)) {
+             sink += legacyParse(line);
+           }
+         }),
+         count, bytes);
+  report("Input + from_chars", timeMs([&] {
+           ::lseek(fd, 0, SEEK_SET);
+           Input input(fd);
+           std::string_view line;
+           while (input.readLine(line)) {
+             if (std::optional<int> value = Input::parseInteger(line)) {
+               sink += *value;
+             }
+           }
+         }),
+         count, bytes);
+
+  ::close(fd);
+  ::unlink(path);
+  std::printf("(checksum %lld)\n", sink);
+  return 0;
+}
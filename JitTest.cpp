@@ -0,0 +1,129 @@
+#include <signal.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "utils/Process.hpp"
+
+using namespace std;
+
+// JIT 差分测试：每个测试点分别以纯字节码 VM（--no-jit）与首次到达即编译
+// 机器码（--jit-threshold=1）运行，两者的输出（含错误信息）必须完全一致。
+const vector<string> traceFolders = {"../test/", "../test/scoped/"};
+const string defaultBasic = "./code";
+const chrono::milliseconds runTimeout(5000);
+
+string basic = "";
+string traceFile = "";
+bool firstFail = false, hideError = false;
+
+int correct = 0, wrong = 0;
+
+void usage(const char* progname) {
+  cout << progname << " [-h] [-e <your_exec>] [-t <trace_file>] [-f] [-m]"
+       << endl
+       << "    -h  Show this message and quit" << endl
+       << "    -e  Specify your executable file, default value: "
+       << defaultBasic << endl
+       << "    -t  Run specified trace file" << endl
+       << "    -f  Stop at first failed test" << endl
+       << "    -m  Hide error message" << endl;
+  exit(1);
+}
+
+void parseArguments(int argc, char** argv) {
+  int c;
+  opterr = 0;
+  while ((c = getopt(argc, argv, "e:t:fmh")) != -1) {
+    switch (c) {
+      case 'e':
+        basic = optarg;
+        break;
+      case 't':
+        traceFile = optarg;
+        break;
+      case 'f':
+        firstFail = true;
+        break;
+      case 'm':
+        hideError = true;
+        break;
+      default:
+        usage(argv[0]);
+        break;
+    }
+  }
+  if (basic.empty()) basic = defaultBasic;
+}
+
+string readFile(const string& path) {
+  ifstream in(path, ios::binary);
+  stringstream buffer;
+  buffer << in.rdbuf();
+  return buffer.str();
+}
+
+// 以给定参数运行解释器，返回合并在一起的标准输出与标准错误
+RunResult runWith(const string& input, const string& option) {
+  return runProgram({basic, option}, input, runTimeout, true);
+}
+
+bool testTrace(const string& trace) {
+  string input = readFile(trace);
+  RunResult vm = runWith(input, "--no-jit");
+  RunResult jit = runWith(input, "--jit-threshold=1");
+  // 超时的一方输出不完整，不能算作一致
+  bool same = vm.output == jit.output && vm.ok == jit.ok && !vm.timedOut &&
+              !jit.timedOut;
+  cout << "Trace \"" << trace << "\" ... " << (same ? "Pass" : "Fail") << endl;
+  if (!same && !hideError) {
+    if (vm.timedOut || jit.timedOut) {
+      cout << (vm.timedOut ? "VM" : "JIT") << ": Time limit exceeded" << endl;
+    } else if (vm.ok != jit.ok) {
+      cout << (vm.ok ? "JIT" : "VM") << " exited abnormally" << endl;
+    }
+    cout << "VM output: " << endl << vm.output << endl;
+    cout << "JIT output: " << endl << jit.output << endl;
+  }
+  return same;
+}
+
+int main(int argc, char** argv) {
+  parseArguments(argc, argv);
+  // 解释器提前退出时写管道不应终止本进程
+  signal(SIGPIPE, SIG_IGN);
+
+  vector<string> traces;
+  if (traceFile.size()) {
+    traces.push_back(traceFile);
+  } else {
+    for (const string& folder : traceFolders) {
+      for (const auto& entry : filesystem::directory_iterator(folder)) {
+        string ext = entry.path().extension().string();
+        if (entry.is_regular_file() && (ext == ".txt" || ext == ".in")) {
+          traces.push_back(entry.path().string());
+        }
+      }
+    }
+    sort(traces.begin(), traces.end());
+  }
+
+  for (const string& trace : traces) {
+    if (testTrace(trace)) {
+      correct++;
+    } else {
+      wrong++;
+      if (firstFail) break;
+    }
+  }
+  cout << correct << " / " << correct + wrong << " trace(s) passed." << endl;
+  return wrong == 0 ? 0 : 1;
+}
@@ -0,0 +1,199 @@
+// 统计 Lexer::tokenize 与 Parser::parseLine 每行的堆分配次数与耗时。
+// 用法：lexer_benchmark [源文件...]，默认使用内置的程序行样例。
+
+#include <chrono>
+#include <cstddef>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <memory>
+#include <new>
+#include <string>
+#include <vector>
+
+#include "Lexer.hpp"
+#include "Parser.hpp"
+#include "SymbolTable.hpp"
+#include "utils/Error.hpp"
+
+namespace {
+
+std::size_t allocCount = 0;
+std::size_t allocBytes = 0;
+
+// 替换全部形式的 operator new/delete，使数组、按大小释放与对齐分配都经过计数，
+// 也不会与库中未替换的版本配错。分配与释放放在不内联的函数中，
+// 否则 GCC 在内联后把 free 与 new 配对，报 -Wmismatched-new-delete。
+[[gnu::noinline]] void* allocate(std::size_t size, std::size_t align) noexcept {
+  ++allocCount;
+  allocBytes += size;
+  if (size == 0) {
+    size = 1;
+  }
+  if (align <= alignof(std::max_align_t)) {
+    return std::malloc(size);
+  }
+  // aligned_alloc 要求大小是对齐值的整数倍
+  return std::aligned_alloc(align, (size + align - 1) / align * align);
+}
+
+void* allocateOrThrow(std::size_t size, std::size_t align) {
+  if (void* p = allocate(size, align)) {
+    return p;
+  }
+  throw std::bad_alloc();
+}
+
+[[gnu::noinline]] void release(void* p) noexcept { std::free(p); }
+
+constexpr std::size_t kDefaultAlign = alignof(std::max_align_t);
+
+}  // namespace
+
+void* operator new(std::size_t size) {
+  return allocateOrThrow(size, kDefaultAlign);
+}
+void* operator new[](std::size_t size) {
+  return allocateOrThrow(size, kDefaultAlign);
+}
+void* operator new(std::size_t size, std::align_val_t align) {
+  return allocateOrThrow(size, static_cast<std::size_t>(align));
+}
+void* operator new[](std::size_t size, std::align_val_t align) {
+  return allocateOrThrow(size, static_cast<std::size_t>(align));
+}
+void* operator new(std::size_t size, const std::nothrow_t&) noexcept {
+  return allocate(size, kDefaultAlign);
+}
+void* operator new[](std::size_t size, const std::nothrow_t&) noexcept {
+  return allocate(size, kDefaultAlign);
+}
+void* operator new(std::size_t size, std::align_val_t align,
+                   const std::nothrow_t&) noexcept {
+  return allocate(size, static_cast<std::size_t>(align));
+}
+void* operator new[](std::size_t size, std::align_val_t align,
+                     const std::nothrow_t&) noexcept {
+  return allocate(size, static_cast<std::size_t>(align));
+}
+
+void operator delete(void* p) noexcept { release(p); }
+void operator delete[](void* p) noexcept { release(p); }
+void operator delete(void* p, std::size_t) noexcept { release(p); }
+void operator delete[](void* p, std::size_t) noexcept { release(p); }
+void operator delete(void* p, std::align_val_t) noexcept { release(p); }
+void operator delete[](void* p, std::align_val_t) noexcept { release(p); }
+void operator delete(void* p, std::size_t, std::align_val_t) noexcept {
+  release(p);
+}
+void operator delete[](void* p, std::size_t, std::align_val_t) noexcept {
+  release(p);
+}
+void operator delete(void* p, const std::nothrow_t&) noexcept { release(p); }
+void operator delete[](void* p, const std::nothrow_t&) noexcept { release(p); }
+void operator delete(void* p, std::align_val_t,
+                     const std::nothrow_t&) noexcept {
+  release(p);
+}
+void operator delete[](void* p, std::align_val_t,
+                       const std::nothrow_t&) noexcept {
+  release(p);
+}
+
+namespace {
+
+const char* const SAMPLE[] = {
+    "10 REM compute the sum of the first n integers, then print it",
+    "20 INPUT n",
+    "30 LET total = 0",
+    "40 LET counter = 1",
+    "50 IF counter > n THEN 90",
+    "60 LET total = total + counter * (counter - 1) / 2",
+    "70 LET counter = counter + 1",
+    "80 GOTO 50",
+    "90 PRINT total",
+    "100 END",
+};
+
+struct Sample {
+  std::size_t count = 0;
+  std::size_t bytes = 0;
+  double ms = 0;
+};
+
+void report(const char* name, const Sample& sample, std::size_t lines) {
+  std::printf("  %-10s %6.2f allocs/line  %8.1f bytes/line  %8.1f ns/line\n",
+              name, static_cast<double>(sample.count) / lines,
+              static_cast<double>(sample.bytes) / lines,
+              sample.ms * 1e6 / lines);
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+  std::vector<std::string> lines;
+  for (int i = 1; i < argc; ++i) {
+    std::ifstream in(argv[i]);
+    std::string line;
+    while (std::getline(in, line)) {
+      if (!line.empty() && line.back() == '\r') {
+        line.pop_back();
+      }
+      lines.push_back(line);
+    }
+  }
+  if (lines.empty()) {
+    lines.assign(std::begin(SAMPLE), std::end(SAMPLE));
+  }
+
+  Lexer lexer;
+  SymbolTable symbols;
+  Parser parser(symbols);
+  constexpr int kRounds = 2000;
+  Sample lex;
+  Sample parse;
+  std::size_t parsed = 0;
+
+  for (int round = 0; round < kRounds; ++round) {
+    for (const std::string& line : lines) {
+      std::size_t count = allocCount;
+      std::size_t bytes = allocBytes;
+      auto start = std::chrono::steady_clock::now();
+      TokenStream tokens;
+      try {
+        tokens = lexer.tokenize(line);
+      } catch (const BasicError&) {
+        continue;
+      }
+      auto middle = std::chrono::steady_clock::now();
+      lex.count += allocCount - count;
+      lex.bytes += allocBytes - bytes;
+      lex.ms += std::chrono::duration<double, std::milli>(middle - start).count();
+
+      // 只统计带行号的程序行，命令行由 main 直接分派
+      if (tokens.empty() || tokens.peek()->type != TokenType::NUMBER) {
+        continue;
+      }
+      count = allocCount;
+      bytes = allocBytes;
+      try {
+        std::unique_ptr<ParsedLine> result = parser.parseLine(tokens, line);
+      } catch (const BasicError&) {
+        continue;
+      }
+      auto end = std::chrono::steady_clock::now();
+      parse.count += allocCount - count;
+      parse.bytes += allocBytes - bytes;
+      parse.ms += std::chrono::duration<double, std::milli>(end - middle).count();
+      ++parsed;
+    }
+  }
+
+  std::printf("%zu lines x %d rounds\n", lines.size(), kRounds);
+  report("tokenize", lex, lines.size() * kRounds);
+  if (parsed != 0) {
+    // parseLine 的分配包含本行 Arena 与 ParsedLine 自身
+    report("parseLine", parse, parsed);
+  }
+  return 0;
+}
@@ -0,0 +1,65 @@
+// libFuzzer 入口：输入按换行切成若干行，逐行交给 Lexer::tokenize 与
+// Parser::parseLine。除 BasicError 外不应有异常、崩溃或越界访问。
+// 以 Clang 构建时链接 libFuzzer；其他编译器定义 BASIC_FUZZ_REPLAY，
+// 生成的程序逐个读取命令行给出的文件并执行一次，用于回放语料或崩溃用例。
+// 用法：lexer_parser_fuzzer [libFuzzer 参数] [语料目录]
+//       lexer_parser_fuzzer 文件...（回放）
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string_view>
+
+#include "Lexer.hpp"
+#include "Parser.hpp"
+#include "SymbolTable.hpp"
+#include "utils/Error.hpp"
+
+extern "C" int LLVMFuzzerTestOneInput(const std::uint8_t* data,
+                                      std::size_t size) {
+  std::string_view text(reinterpret_cast<const char*>(data), size);
+  SymbolTable symbols;
+  Lexer lexer;
+  Parser parser(symbols);
+  while (!text.empty()) {
+    std::size_t end = text.find('\n');
+    std::string_view line = text.substr(0, end);
+    text = end == std::string_view::npos ? std::string_view()
+                                         : text.substr(end + 1);
+    try {
+      TokenStream tokens = lexer.tokenize(line);
+      if (!tokens.empty()) {
+        std::unique_ptr<ParsedLine> parsedLine =
+            parser.parseLine(tokens, line);
+        parsedLine->fetchStatement();
+      }
+    } catch (const BasicError&) {
+    }
+  }
+  return 0;
+}
+
+#ifdef BASIC_FUZZ_REPLAY
+
+#include <cstdio>
+#include <fstream>
+#include <iterator>
+#include <string>
+
+int main(int argc, char** argv) {
+  for (int i = 1; i < argc; ++i) {
+    std::ifstream in(argv[i], std::ios::binary);
+    if (!in) {
+      std::fprintf(stderr, "cannot open %s\n", argv[i]);
+      return 1;
+    }
+    std::string data((std::istreambuf_iterator<char>(in)),
+                     std::istreambuf_iterator<char>());
+    LLVMFuzzerTestOneInput(reinterpret_cast<const std::uint8_t*>(data.data()),
+                           data.size());
+  }
+  std::printf("%d input(s) replayed\n", argc - 1);
+  return 0;
+}
+
+#endif
@@ -0,0 +1,111 @@
+// 交互编辑后再次 RUN 的延迟：载入一个大程序并 RUN 一次，之后逐次替换、
+// 插入或删除一行再 RUN，与整程序编译时折算到每行的耗时对比。
+// 程序首行是 END，RUN 的耗时几乎全部是编译。
+// 用法：recompile_benchmark [行数]，默认 500000。
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <memory>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "Lexer.hpp"
+#include "Parser.hpp"
+#include "Program.hpp"
+#include "Token.hpp"
+
+namespace {
+
+constexpr int kEdits = 20;
+
+// 第 i 行（行号 (i + 1) * 10）的语句，含 LET、PRINT、IF 与 GOTO。
+std::string statementAt(int i, int lines, std::mt19937& rng) {
+  switch (i % 5) {
+    case 0:
+      return "LET a = a + " + std::to_string(i % 13) + " * b - (c / 3)";
+    case 1:
+      return "LET b = b + 1";
+    case 2:
+      return "IF b > 1000000000 THEN " +
+             std::to_string((rng() % lines + 1) * 10);
+    case 3:
+      return "PRINT a - b";
+    default:
+      return "GOTO " + std::to_string((i + 2) * 10);
+  }
+}
+
+class Session {
+ public:
+  Session() : parser_(program_.symbols()) {}
+
+  Program& program() { return program_; }
+
+  void add(int line, const std::string& stmt) {
+    std::string text = std::to_string(line) + " " + stmt;
+    TokenStream tokens = lexer_.tokenize(text);
+    std::unique_ptr<ParsedLine> parsed = parser_.parseLine(tokens, text);
+    program_.addStmt(line, parsed->fetchStatement());
+  }
+
+  double run() {
+    auto start = std::chrono::steady_clock::now();
+    program_.run();
+    auto end = std::chrono::steady_clock::now();
+    return std::chrono::duration<double, std::milli>(end - start).count();
+  }
+
+ private:
+  Program program_;
+  Lexer lexer_;
+  Parser parser_;
+};
+
+void report(const char* name, std::vector<double> ms, double perLine) {
+  std::sort(ms.begin(), ms.end());
+  std::printf("  %-20s median %8.3f ms   max %8.3f ms   = %8.1f lines\n",
+              name, ms[ms.size() / 2], ms.back(), ms[ms.size() / 2] / perLine);
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+  int lines = argc > 1 ? std::atoi(argv[1]) : 500000;
+  std::mt19937 rng(20251201);
+
+  Session session;
+  session.add(5, "END");
+  for (int i = 0; i < lines; ++i) {
+    session.add((i + 1) * 10, statementAt(i, lines, rng));
+  }
+  double fullMs = session.run();
+  double perLine = fullMs / lines;
+  std::printf("%d lines: first RUN %.1f ms, %.3f us/line\n", lines, fullMs,
+              perLine * 1000);
+
+  // 每种编辑之后先 RUN 一次，计时只包含该次编辑引起的重新编译
+  std::vector<double> replaced;
+  std::vector<double> inserted;
+  std::vector<double> removed;
+  std::vector<double> unchanged;
+  for (int k = 0; k < kEdits; ++k) {
+    int i = static_cast<int>(rng() % lines);
+    session.add((i + 1) * 10, statementAt(i + 1, lines, rng));
+    replaced.push_back(session.run());
+    // 插入被 GOTO 引用的行号之间的新行，再删掉它
+    int gap = (i + 1) * 10 + 5;
+    session.add(gap, "LET c = c + 1");
+    inserted.push_back(session.run());
+    session.program().removeStmt(gap);
+    removed.push_back(session.run());
+    unchanged.push_back(session.run());
+  }
+  report("replace line", replaced, perLine);
+  report("insert line", inserted, perLine);
+  report("remove line", removed, perLine);
+  report("no edit", unchanged, perLine);
+  return 0;
+}
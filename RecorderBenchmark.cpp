@@ -0,0 +1,151 @@
+// Recorder 连续行表与旧版 std::map 实现的对比基准。
+// 用法：recorder_benchmark [行数...]，默认依次测试 10k、100k、1M 行。
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <map>
+#include <memory>
+#include <random>
+#include <vector>
+
+#include "Arena.hpp"
+#include "Recorder.hpp"
+#include "Statement.hpp"
+
+namespace {
+
+// 旧版 Recorder 的存储方式，仅保留基准涉及的接口。
+class MapRecorder {
+ public:
+  void add(int line, StatementPtr stmt) {
+    lineToStmt_[line] = std::move(stmt);
+  }
+
+  const Statement* get(int line) const {
+    auto it = lineToStmt_.find(line);
+    return (it != lineToStmt_.end()) ? it->second.get() : nullptr;
+  }
+
+  int nextLine(int line) const {
+    auto it = lineToStmt_.upper_bound(line);
+    return (it != lineToStmt_.end()) ? it->first : -1;
+  }
+
+ private:
+  std::map<int, StatementPtr> lineToStmt_;
+};
+
+std::uintptr_t sink = 0;
+
+template <class Fn>
+double timeMs(Fn&& fn) {
+  auto start = std::chrono::steady_clock::now();
+  fn();
+  auto end = std::chrono::steady_clock::now();
+  return std::chrono::duration<double, std::milli>(end - start).count();
+}
+
+std::vector<StatementPtr> makeStatements(int count) {
+  std::vector<StatementPtr> stmts;
+  stmts.reserve(count);
+  for (int i = 0; i < count; ++i) {
+    auto* arena = new Arena();
+    Statement* stmt = arena->make<REMStatement>(arena->copy("REM benchmark"));
+    stmts.emplace_back(stmt, StatementDeleter{arena});
+  }
+  return stmts;
+}
+
+template <class Rec>
+double load(Rec& recorder, const std::vector<int>& lines) {
+  std::vector<StatementPtr> stmts = makeStatements(lines.size());
+  return timeMs([&] {
+    for (std::size_t i = 0; i < lines.size(); ++i) {
+      recorder.add(lines[i], std::move(stmts[i]));
+    }
+    // 行表把乱序插入推迟到第一次查询时合并，计入加载时间
+    sink += reinterpret_cast<std::uintptr_t>(recorder.get(lines.front()));
+  });
+}
+
+template <class Rec>
+double walkNextLine(const Rec& recorder) {
+  return timeMs([&] {
+    for (int line = recorder.nextLine(0); line != -1;
+         line = recorder.nextLine(line)) {
+      sink += reinterpret_cast<std::uintptr_t>(recorder.get(line));
+    }
+  });
+}
+
+double walkIndex(const Recorder& recorder) {
+  return timeMs([&] {
+    for (int i = 0, size = recorder.size(); i < size; ++i) {
+      sink += reinterpret_cast<std::uintptr_t>(recorder.stmtAt(i));
+    }
+  });
+}
+
+template <class Rec>
+double randomGet(const Rec& recorder, const std::vector<int>& probes) {
+  return timeMs([&] {
+    for (int line : probes) {
+      sink += reinterpret_cast<std::uintptr_t>(recorder.get(line));
+    }
+  });
+}
+
+void report(const char* name, double mapMs, double tableMs) {
+  std::printf("  %-28s map %10.2f ms   table %10.2f ms   x%.2f\n", name,
+              mapMs, tableMs, mapMs / tableMs);
+}
+
+void runSize(int count) {
+  std::vector<int> ascending(count);
+  for (int i = 0; i < count; ++i) {
+    ascending[i] = (i + 1) * 10;
+  }
+  std::mt19937 rng(20251201);
+  std::vector<int> shuffled = ascending;
+  std::shuffle(shuffled.begin(), shuffled.end(), rng);
+  std::vector<int> probes(count);
+  for (int& probe : probes) {
+    probe = ascending[rng() % count];
+  }
+
+  std::printf("%d lines\n", count);
+  {
+    MapRecorder map;
+    Recorder table;
+    report("load ascending", load(map, ascending), load(table, ascending));
+    report("fall-through (nextLine+get)", walkNextLine(map),
+           walkNextLine(table));
+    report("fall-through (table index)", walkNextLine(map), walkIndex(table));
+    report("random get", randomGet(map, probes), randomGet(table, probes));
+  }
+  {
+    MapRecorder map;
+    Recorder table;
+    report("load shuffled", load(map, shuffled), load(table, shuffled));
+  }
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+  std::vector<int> sizes;
+  for (int i = 1; i < argc; ++i) {
+    sizes.push_back(std::atoi(argv[i]));
+  }
+  if (sizes.empty()) {
+    sizes = {10000, 100000, 1000000};
+  }
+  for (int count : sizes) {
+    runSize(count);
+  }
+  std::printf("(checksum %zx)\n", static_cast<std::size_t>(sink));
+  return 0;
+}
@@ -0,0 +1,200 @@
+// 服务端的命令延迟：若干客户端会话各自反复 RUN 一个带 INPUT 的求和程序，
+// 同时另有若干会话运行死循环占用工作线程，检查每次的输出并统计客户端
+// 看到的 p50/p99 延迟，最后输出服务端 STATS 报告的会话内存与延迟。
+// 用法：server_benchmark [客户端数] [死循环会话数] [轮数] [套接字路径]，
+// 默认 16 4 50；不给路径时在本进程中启动服务端。
+
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "Server.hpp"
+#include "utils/Error.hpp"
+
+namespace {
+
+const char* const kSocket = "server_benchmark.sock";
+constexpr int kTerms = 10000;
+
+int connectTo(const std::string& path) {
+  sockaddr_un address{};
+  address.sun_family = AF_UNIX;
+  std::strncpy(address.sun_path, path.c_str(), sizeof(address.sun_path) - 1);
+  int fd = ::socket(AF_UNIX, SOCK_STREAM, 0);
+  if (fd < 0 || ::connect(fd, reinterpret_cast<sockaddr*>(&address),
+                          sizeof(address)) != 0) {
+    std::perror("connect");
+    std::exit(1);
+  }
+  return fd;
+}
+
+void sendAll(int fd, const std::string& text) {
+  std::size_t sent = 0;
+  while (sent < text.size()) {
+    ssize_t count = ::send(fd, text.data() + sent, text.size() - sent,
+                           MSG_NOSIGNAL);
+    if (count <= 0) {
+      std::perror("send");
+      std::exit(1);
+    }
+    sent += static_cast<std::size_t>(count);
+  }
+}
+
+// 读到下一个 '\0' 为止，返回之前的输出。
+std::string receive(int fd, std::string& pending) {
+  for (;;) {
+    std::size_t end = pending.find('\0');
+    if (end != std::string::npos) {
+      std::string reply = pending.substr(0, end);
+      pending.erase(0, end + 1);
+      return reply;
+    }
+    char buffer[4096];
+    ssize_t count = ::read(fd, buffer, sizeof(buffer));
+    if (count <= 0) {
+      std::fprintf(stderr, "connection closed\n");
+      std::exit(1);
+    }
+    pending.append(buffer, static_cast<std::size_t>(count));
+  }
+}
+
+double elapsedMs(std::chrono::steady_clock::time_point since) {
+  return std::chrono::duration<double, std::milli>(
+             std::chrono::steady_clock::now() - since)
+      .count();
+}
+
+double percentile(std::vector<double>& samples, double q) {
+  auto nth = samples.begin() +
+             static_cast<std::ptrdiff_t>(q * (samples.size() - 1));
+  std::nth_element(samples.begin(), nth, samples.end());
+  return *nth;
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+  int clients = argc > 1 ? std::atoi(argv[1]) : 16;
+  int hogs = argc > 2 ? std::atoi(argv[2]) : 4;
+  int rounds = argc > 3 ? std::atoi(argv[3]) : 50;
+  std::string path = argc > 4 ? argv[4] : kSocket;
+
+  std::unique_ptr<Server> server;
+  std::thread loop;
+  if (argc <= 4) {
+    Server::Options options;
+    options.path = path;
+    try {
+      server = std::make_unique<Server>(options);
+    } catch (const BasicError& e) {
+      std::fprintf(stderr, "%s\n", e.message().c_str());
+      return 1;
+    }
+    loop = std::thread([&server] { server->run(); });
+  }
+
+  // 死循环会话：只发不收，直到结束时断开
+  std::vector<int> hogFds;
+  for (int i = 0; i < hogs; ++i) {
+    hogFds.push_back(connectTo(path));
+    sendAll(hogFds.back(), "10 LET i = 1 - i\n20 GOTO 10\nRUN\n");
+  }
+
+  const std::string program =
+      "10 LET s = 0\n20 LET i = 0\n30 LET i = i + 1\n40 LET s = s + i\n"
+      "50 IF i < " + std::to_string(kTerms) + " THEN 30\n60 PRINT s\n"
+      "70 INPUT x\n80 PRINT x * 2\n";
+  const int programLines = 8;
+  const std::string sum =
+      std::to_string(static_cast<long long>(kTerms) * (kTerms + 1) / 2);
+
+  std::vector<std::vector<double>> latencies(clients);
+  std::atomic<int> mismatches{0};
+  std::vector<std::thread> threads;
+  auto start = std::chrono::steady_clock::now();
+  for (int c = 0; c < clients; ++c) {
+    threads.emplace_back([&, c] {
+      int fd = connectTo(path);
+      std::string pending;
+      sendAll(fd, program);
+      for (int i = 0; i < programLines; ++i) {
+        receive(fd, pending);
+      }
+      for (int r = 0; r < rounds; ++r) {
+        // RUN 连同 INPUT 读走的值一起发出，是一条命令
+        auto since = std::chrono::steady_clock::now();
+        sendAll(fd, "RUN\n" + std::to_string(r) + "\n");
+        std::string reply = receive(fd, pending);
+        latencies[c].push_back(elapsedMs(since));
+        if (reply != sum + "\n ? " + std::to_string(r * 2) + "\n") {
+          ++mismatches;
+        }
+        since = std::chrono::steady_clock::now();
+        sendAll(fd, "PRINT x + " + std::to_string(c) + "\n");
+        reply = receive(fd, pending);
+        latencies[c].push_back(elapsedMs(since));
+        if (reply != std::to_string(r + c) + "\n") {
+          ++mismatches;
+        }
+      }
+      sendAll(fd, "QUIT\n");
+      receive(fd, pending);
+      ::close(fd);
+    });
+  }
+  for (std::thread& thread : threads) {
+    thread.join();
+  }
+  double total = elapsedMs(start);
+
+  // 服务端的统计：仍在运行的死循环会话与本次新建的会话
+  std::string report;
+  {
+    int fd = connectTo(path);
+    std::string pending;
+    sendAll(fd, "10 PRINT 1\nSTATS\n");
+    receive(fd, pending);
+    report = receive(fd, pending);
+    ::close(fd);
+  }
+  for (int fd : hogFds) {
+    ::close(fd);
+  }
+  if (server) {
+    server->stop();
+    loop.join();
+    server.reset();
+  }
+
+  std::vector<double> samples;
+  for (const auto& client : latencies) {
+    samples.insert(samples.end(), client.begin(), client.end());
+  }
+  std::printf("%d clients, %d looping sessions, %d rounds: %zu commands in "
+              "%.1f ms\n",
+              clients, hogs, rounds, samples.size(), total);
+  if (!samples.empty()) {
+    std::printf("client latency p50: %.3f ms, p99: %.3f ms\n",
+                percentile(samples, 0.50), percentile(samples, 0.99));
+  }
+  std::printf("server STATS:\n%s", report.c_str());
+  if (mismatches != 0) {
+    std::printf("MISMATCH: %d replies differ\n", mismatches.load());
+    return 1;
+  }
+  return 0;
+}
@@ -0,0 +1,139 @@
+// 服务端会话隔离测试：一个会话发送曾使进程崩溃的输入（INT_MIN / -1、
+// 嵌套过深的括号），这些输入须以 BasicError 报告；之后该会话、另一个
+// 已打开的会话与新连接的会话都须照常工作。
+// 用法：server_test，在本进程中启动服务端，套接字建在当前目录。
+
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include <cstdio>
+#include <cstring>
+#include <initializer_list>
+#include <memory>
+#include <string>
+#include <thread>
+
+#include "Server.hpp"
+#include "utils/Error.hpp"
+
+namespace {
+
+int failures = 0;
+
+int connectTo(const std::string& path) {
+  sockaddr_un address{};
+  address.sun_family = AF_UNIX;
+  std::strncpy(address.sun_path, path.c_str(), sizeof(address.sun_path) - 1);
+  int fd = ::socket(AF_UNIX, SOCK_STREAM, 0);
+  if (fd < 0 || ::connect(fd, reinterpret_cast<sockaddr*>(&address),
+                          sizeof(address)) != 0) {
+    std::perror("connect");
+    return -1;
+  }
+  return fd;
+}
+
+// 发送一条命令并读回它的输出（到 '\0' 为止）；连接断开时返回 false。
+bool command(int fd, std::string& pending, const std::string& line,
+             std::string& reply) {
+  std::string text = line + "\n";
+  std::size_t sent = 0;
+  while (sent < text.size()) {
+    ssize_t count = ::send(fd, text.data() + sent, text.size() - sent,
+                           MSG_NOSIGNAL);
+    if (count <= 0) {
+      return false;
+    }
+    sent += static_cast<std::size_t>(count);
+  }
+  for (;;) {
+    std::size_t end = pending.find('\0');
+    if (end != std::string::npos) {
+      reply = pending.substr(0, end);
+      pending.erase(0, end + 1);
+      return true;
+    }
+    char buffer[4096];
+    ssize_t count = ::read(fd, buffer, sizeof(buffer));
+    if (count <= 0) {
+      return false;
+    }
+    pending.append(buffer, static_cast<std::size_t>(count));
+  }
+}
+
+struct Client {
+  const char* name;
+  int fd;
+  std::string pending;
+};
+
+void expect(Client& client, const std::string& line,
+            const std::string& expected) {
+  std::string reply;
+  bool ok = command(client.fd, client.pending, line, reply);
+  std::string shown = line.size() > 40 ? line.substr(0, 40) + "..." : line;
+  if (!ok) {
+    std::printf("FAIL %s: \"%s\": connection closed\n", client.name,
+                shown.c_str());
+    ++failures;
+  } else if (reply != expected) {
+    std::printf("FAIL %s: \"%s\": expected \"%s\", got \"%s\"\n", client.name,
+                shown.c_str(), expected.c_str(), reply.c_str());
+    ++failures;
+  }
+}
+
+}  // namespace
+
+int main() {
+  std::string path = "server_test." + std::to_string(::getpid()) + ".sock";
+  Server::Options options;
+  options.path = path;
+  options.workers = 2;
+  std::unique_ptr<Server> server;
+  try {
+    server = std::make_unique<Server>(options);
+  } catch (const BasicError& e) {
+    std::fprintf(stderr, "%s\n", e.message().c_str());
+    return 1;
+  }
+  std::thread loop([&server] { server->run(); });
+
+  Client bystander{"bystander", connectTo(path), {}};
+  Client attacker{"attacker", connectTo(path), {}};
+  if (bystander.fd < 0 || attacker.fd < 0) {
+    return 1;
+  }
+  expect(bystander, "LET X = 5", "");
+
+  const std::string deep = std::string(100000, '(') + "1" +
+                           std::string(100000, ')');
+  expect(attacker, "LET A = 0 - 2147483647 - 1", "");
+  expect(attacker, "LET B = 0 - 1", "");
+  expect(attacker, "PRINT A / B", "INTEGER OVERFLOW\n");
+  expect(attacker, "10 PRINT A / B", "");
+  expect(attacker, "RUN", "INTEGER OVERFLOW\n");
+  expect(attacker, "PRINT " + deep, "EXPRESSION TOO DEEP\n");
+  expect(attacker, "20 PRINT " + deep, "EXPRESSION TOO DEEP\n");
+  expect(attacker, "PRINT A / 2", "-1073741824\n");
+
+  expect(bystander, "PRINT X", "5\n");
+  Client newcomer{"newcomer", connectTo(path), {}};
+  if (newcomer.fd < 0) {
+    return 1;
+  }
+  expect(newcomer, "PRINT 7", "7\n");
+
+  for (Client* client : {&bystander, &attacker, &newcomer}) {
+    ::close(client->fd);
+  }
+  server->stop();
+  loop.join();
+  server.reset();
+
+  std::printf("%s\n", failures == 0 ? "server isolation: Pass"
+                                    : "server isolation: Fail");
+  return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,51 @@
+#pragma once
+
+#include <cstddef>
+#include <new>
+#include <string_view>
+#include <utility>
+
+// 一行程序的语法树节点都从同一个 Arena 顺序分配，彼此相邻存放。
+// 节点随 Arena 整体释放而不会被逐个析构，因此放入 Arena 的对象
+// 不能持有 Arena 之外的资源（例如 std::string 或 std::unique_ptr）。
+class Arena {
+ public:
+  Arena();
+  ~Arena();
+  Arena(const Arena&) = delete;
+  Arena& operator=(const Arena&) = delete;
+
+  void* allocate(std::size_t size, std::size_t align);
+
+  template <class T, class... Args>
+  T* make(Args&&... args) {
+    return new (allocate(sizeof(T), alignof(T))) T(std::forward<Args>(args)...);
+  }
+
+  // 确保接下来至少 size 字节从同一块中连续分配，用于事先知道总量的
+  // 大批分配（如载入程序映像），省去逐块申请。
+  void reserve(std::size_t size);
+
+  // 把文本复制进 Arena，返回的视图与 Arena 同生命周期。
+  std::string_view copy(std::string_view text);
+
+  std::size_t bytesUsed() const noexcept;
+
+ private:
+  struct Block {
+    Block* next;
+  };
+
+  // 绝大多数程序行的全部节点都能放进内联缓冲区，只需一次堆分配。
+  static constexpr std::size_t kInlineSize = 256;
+  static constexpr std::size_t kBlockSize = 1024;
+
+  alignas(std::max_align_t) char inline_[kInlineSize];
+  char* cursor_;
+  char* end_;
+  Block* blocks_;
+  std::size_t used_;
+
+  // 申请一块可用 size 字节的新块作为当前块。
+  void grow(std::size_t size);
+};
@@ -0,0 +1,116 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+// GCC 与 Clang 支持取标签地址（computed goto），VM 与后缀表达式求值使用
+// 直接线索化分派：每条指令的处理代码末尾各自跳往下一条，间接跳转分散在
+// 各处，分支预测器能按前一条指令区分历史。其余编译器，或定义了
+// BASIC_SWITCH_DISPATCH 时，退回到可移植的 switch 循环。
+#if (defined(__GNUC__) || defined(__clang__)) && !defined(BASIC_SWITCH_DISPATCH)
+#define BASIC_THREADED_DISPATCH
+#endif
+
+// 栈式字节码的操作码。
+enum class OpCode : std::uint8_t {
+  PUSH,     // 压入常量 operand
+  LOAD,     // 压入槽位 operand 中变量的值
+  ADD,
+  SUB,
+  MUL,
+  DIV,
+  STORE,    // 弹出栈顶并写入槽位 operand
+  PRINT,    // 弹出栈顶并输出
+  INPUT,    // 读入一个整数写入槽位 operand
+  JUMP,     // 无条件跳转到标签 operand
+  JUMP_EQ,  // 弹出两个值，满足比较则跳转到标签 operand
+  JUMP_GT,
+  JUMP_LT,
+  FAIL,     // 抛出 operand 对应的运行时错误
+  HALT,
+  LOOP,     // 计数循环入口，operand 为 Bytecode::loops 的下标
+  SKIP,     // 接着执行下标 operand 处的指令，不计入跳转预算；增量编译时
+            // 连接追加在末尾的指令与原处的指令
+  // 以下为超级指令，operand 为 Bytecode::fused 的下标
+  INC,              // 变量加常量
+  BRANCH_EQ,        // 变量与常量比较，满足则跳转
+  BRANCH_GT,
+  BRANCH_LT,
+  INC_BRANCH_EQ,    // 变量加常量后与常量比较跳转
+  INC_BRANCH_GT,
+  INC_BRANCH_LT,
+  STORE_BRANCH_EQ,  // 弹出栈顶写入变量后与常量比较跳转
+  STORE_BRANCH_GT,
+  STORE_BRANCH_LT
+};
+
+// FAIL 指令携带的错误类型。
+enum class FailCode : int { SYNTAX_ERROR, LINE_NUMBER_ERROR };
+
+struct Instruction {
+  Instruction() = default;
+  constexpr Instruction(OpCode op, int operand, bool backward = false)
+      : op(op), backward(backward), operand(operand) {}
+
+  OpCode op;
+  // 跳转指令与超级指令：目标行号不大于所在行，执行时计入跳转预算。
+  // 增量编译后指令不再按行号排列，方向不能由下标的先后判断。
+  bool backward;
+  int operand;
+};
+
+// 形如 "LET i = i + c ... IF i < n THEN 循环首行" 的计数循环。
+// 循环体只含 LET 与 PRINT，计数器只在一处按常量步长增减，上界是常量或
+// 循环中不被修改的变量。进入时所有变量均已定义，就在局部寄存器上执行
+// 全部迭代，迭代次数在入口一次算出，不再逐轮比较。
+struct CountedLoop {
+  // 循环体的指令，LOAD/STORE 的操作数是寄存器下标，HALT 标记一轮结束
+  std::vector<Instruction> body;
+  // 寄存器 r 对应的变量槽位
+  std::vector<int> slots;
+  int counter;     // 计数器所在的寄存器
+  int step;        // 每轮的增量，非零
+  bool limitIsRegister;
+  int limit;       // 上界：寄存器下标或常量
+  int exit;        // 循环结束后继续执行的标签
+  int maxStack;
+};
+
+// 超级指令的操作数。
+struct FusedOperands {
+  int slot;
+  int step;      // INC 系列加到变量上的常量
+  int constant;  // 比较的常量
+  int target;    // 跳转目标标签
+};
+
+// 增量编译相对上一版本的改动，VM 据此只更新线索化代码中变化的部分。
+struct BytecodePatch {
+  // 上一版本的 revision，0 表示整体重新生成
+  unsigned base{0};
+  // 下标从 appended 起的指令是新追加的
+  int appended{0};
+  // 被原地改写为 SKIP 的指令
+  std::vector<int> patched;
+  // 重新生成的行中可能被跳转到达的首条指令，VM 在这里设热点区域入口
+  std::vector<int> entries;
+};
+
+// 一次 RUN 所需的全部字节码，由 Compiler 根据 Recorder 生成。
+// 跳转的目标是标签而非指令下标：标签按目标行号分配，labels 给出每个标签当前
+// 对应的指令下标，目标行不存在时指向报错的 FAIL。增删行只需改写标签表，
+// 其余行的指令可以原样沿用。重新生成的行追加在末尾，由 SKIP 与前后的行
+// 相连，原处的旧指令不再被执行。
+struct Bytecode {
+  std::vector<Instruction> code;
+  std::vector<int> labels;
+  int entry{0};  // 程序首条指令
+  int maxStack{0};
+  std::vector<CountedLoop> loops;
+  std::vector<FusedOperands> fused;
+  // 每个程序行首条指令的下标，按 Recorder 下标排列，供逐行性能统计使用。
+  std::vector<int> lineStarts;
+  // 每次重新编译后加一。VM 据此判断上次 RUN 的线索化代码能否沿用。
+  unsigned revision{0};
+  BytecodePatch patch;
+};
@@ -0,0 +1,137 @@
+#pragma once
+
+#include <cstdint>
+#include <map>
+#include <unordered_map>
+#include <vector>
+
+#include "Bytecode.hpp"
+
+class Recorder;
+
+// 将 Recorder 中的语句树降低为一段连续的字节码。
+// 跳转指令的操作数是按目标行号分配的标签，增删行只改写标签表，不必改写别处
+// 的跳转。同一个 Compiler 再次编译时只重新生成改动过的行及其附近的指令：
+// 与改动行可能合并为超级指令、同属一个计数循环，或跳转目标状态随之变化的行。
+// 重新生成的指令追加在末尾，前一行之后的指令原地改为 SKIP 跳到新指令，
+// 新指令末尾以 SKIP 接回下一行；其余行的指令不移动。
+class Compiler {
+ public:
+  const Bytecode& compile(const Recorder& recorder);
+
+  // 最近一次 compile 重新生成指令的行数。
+  int recompiledLines() const noexcept;
+  // 当前字节码中的超级指令条数。
+  int fusedInstructions() const noexcept;
+
+  // 是否把常见的指令序列合并为超级指令，逐行统计时关闭以保留行边界。
+  void setSuperinstructions(bool enabled) noexcept;
+
+  // 供 Statement/Expression::compile 调用的生成接口。
+  void emit(OpCode op, int operand = 0);
+  void emitJump(OpCode op, int line);
+
+ private:
+  // 每行编译结果中与相邻行有关的性质。
+  enum LineFlag : std::uint8_t {
+    kEmpty = 1,     // 不产生指令，如 REM
+    kSimple = 2,    // 只含 PUSH/LOAD/算术/STORE/PRINT，可作计数循环体
+    kCompare = 4,   // 恰为变量与常量比较后条件跳转，可与上一行合并
+    kBackEdge = 8,  // 以 < 或 > 跳回更早的行，可能是计数循环的回跳
+  };
+  struct Line {
+    int number;
+    int label;  // 本行的标签，没有跳转指向本行时为 -1
+    int jump;   // 本行跳转指令的标签，没有跳转为 -1
+    std::uint8_t flags;
+  };
+  // 行号闭区间。
+  struct Range {
+    int lo;
+    int hi;
+  };
+  // 连续若干行的编译结果，starts 末尾多一项为总长。
+  struct Fragment {
+    std::vector<Instruction> code;
+    std::vector<int> starts;
+    std::vector<Line> lines;
+  };
+
+  // 保留的标签：行号不合法时的错误桩，以及程序末尾的 HALT。
+  static constexpr int kSyntaxLabel = 0;
+  static constexpr int kEndLabel = 1;
+  // 代码开头的两条 FAIL 指令
+  static constexpr int kSyntaxStub = 0;
+  static constexpr int kLineStub = 1;
+
+  Bytecode code_;
+  // 与 Recorder 中的行一一对应
+  std::vector<Line> lines_;
+  // 各行之后接着执行的指令下标，与 code_.lineStarts 并列；不产生指令的行
+  // 首尾相同。重新生成某行之后的行时，改写的就是这里的指令
+  std::vector<int> ends_;
+  std::unordered_map<int, int> labelOf_;
+  std::vector<int> labelLine_;
+  // 指向各标签的跳转条数，非零的行首是基本块的边界
+  std::vector<int> labelRefs_;
+  // 本次编译新分配、对应的行已存在的标签，编译结束时登记到 lines_
+  std::vector<int> created_;
+  // 当前的计数循环：回跳所在行号到循环首行号，各循环互不重叠
+  std::map<int, int> loopSpans_;
+  int liveFused_{0};
+  int liveLoops_{0};
+  // 被丢弃、不再执行的指令条数
+  int garbage_{0};
+  int recompiled_{0};
+  unsigned revision_{0};
+  bool compiled_{false};
+  bool superinstructions_{true};
+
+  // 编译若干行时复用的缓冲区
+  Fragment fragment_;
+
+  // 正在编译的行，供 emitJump 解析跳到本行的跳转
+  int currentLine_{0};
+  int nextLine_{0};
+  int currentJump_{-1};
+  int depth_{0};
+
+  void rebuild(const Recorder& recorder);
+  // dirty 为按行号排序去重的改动行。
+  void update(const Recorder& recorder, const std::vector<int>& dirty);
+  // 以 ranges 中的新行原地替换旧行的性质并调整标签引用计数，新行的指令
+  // 位置留待 regenerate 填写；返回跳转目标状态（引用计数是否为零）发生
+  // 变化的标签。
+  std::vector<int> replaceLines(const Recorder& recorder,
+                                const std::vector<Range>& ranges);
+  // 扩大区间，使其不切开计数循环与超级指令；有变化时返回 true。
+  bool widen(Range& range) const;
+  // 改动行 line 可能让包含它的回跳成为计数循环，需要时加入区间。
+  void addLoopAround(int line, std::vector<Range>& ranges) const;
+  bool isLoopBody(int head, int branch) const;
+  // 重新生成 ranges 内各行的指令并追加到末尾，其余行的指令原地不动。
+  void regenerate(const Recorder& recorder, const std::vector<Range>& ranges);
+  // 丢弃第 index 行的旧指令。
+  void discard(int index);
+
+  // 编译 Recorder 中下标 [first, last) 的行到 fragment_。
+  void compileLines(const Recorder& recorder, int first, int last);
+  // 在 fragment_ 上识别计数循环并合并超级指令。
+  void lower(const Recorder& recorder, int last);
+  // head 为循环首行的首条指令，branch 为回跳所在行的首条指令。
+  bool matchLoop(int head, int branch, CountedLoop& loop) const;
+  // 在基本块内合并指令序列；基本块以跳转目标为界。
+  void fuseInstructions();
+  // 指令重排后按 moved（旧下标到新下标）改写各行首条指令的位置。
+  void relocate(std::vector<Instruction> code, const std::vector<int>& moved);
+
+  int labelFor(int line);
+  bool isTarget(const Line& line) const;
+  // 把 created_ 中的标签登记到 lines_ 中对应的行。
+  void registerLabels();
+  // 标签表指向各行当前的首条指令。
+  void refreshLabels();
+  // 只更新下标 [first, last) 的行的标签。
+  void refreshLabels(int first, int last);
+  void trackStack(OpCode op);
+};
@@ -1,14 +1,36 @@
 #pragma once
 
 #include <memory>
+#include <optional>
 #include <string>
+#include <vector>
 
+#include "Bytecode.hpp"
+
+class Arena;
+class Compiler;
+class CompoundExpression;
+class Optimizer;
 class VarState;
 
 class Expression {
  public:
   virtual ~Expression() = default;
   virtual int evaluate(const VarState& state) const = 0;
+  virtual void compile(Compiler& compiler) const = 0;
+  // 化简自身，返回替换节点；返回空指针表示保留当前节点。
+  virtual Expression* fold(Optimizer& optimizer);
+  // 若表达式是常量则返回其值。
+  virtual std::optional<int> constant() const;
+  // 若是复合表达式则返回自身，供化简时不递归地沿左侧链遍历。
+  virtual CompoundExpression* asCompound() noexcept;
+  // 把变量槽位 s 改写为 slots[s]，用于合并并行解析时各自分配的符号表。
+  virtual void remapSlots(const std::vector<int>& slots);
+  // 供非递归展开使用：复合表达式给出左右子树与运算指令并返回 true，
+  // 其余表达式把自身的后缀指令追加到 out 并返回 false。
+  virtual bool decompose(const Expression*& left, const Expression*& right,
+                         Instruction& op,
+                         std::vector<Instruction>& out) const = 0;
 };
 
 class ConstExpression : public Expression {
@@ -16,6 +38,11 @@ class ConstExpression : public Expression {
   explicit ConstExpression(int value);
   ~ConstExpression() = default;
   int evaluate(const VarState& state) const override;
+  void compile(Compiler& compiler) const override;
+  std::optional<int> constant() const override;
+  bool decompose(const Expression*& left, const Expression*& right,
+                 Instruction& op,
+                 std::vector<Instruction>& out) const override;
 
  private:
   int value_;
@@ -23,22 +50,66 @@ class ConstExpression : public Expression {
 
 class VariableExpression : public Expression {
  public:
-  explicit VariableExpression(std::string name);
+  explicit VariableExpression(int slot);
   ~VariableExpression() = default;
   int evaluate(const VarState& state) const override;
+  void compile(Compiler& compiler) const override;
+  void remapSlots(const std::vector<int>& slots) override;
+  bool decompose(const Expression*& left, const Expression*& right,
+                 Instruction& op,
+                 std::vector<Instruction>& out) const override;
 
  private:
-  std::string name_;
+  int slot_;
 };
 
 class CompoundExpression : public Expression {
  public:
-  CompoundExpression(std::unique_ptr<Expression> left, char op, std::unique_ptr<Expression> right);
+  // 子表达式与本节点位于同一个 Arena，由 Arena 统一释放。
+  CompoundExpression(Expression* left, char op, Expression* right);
   ~CompoundExpression();
   int evaluate(const VarState& state) const override;
+  void compile(Compiler& compiler) const override;
+  Expression* fold(Optimizer& optimizer) override;
+  CompoundExpression* asCompound() noexcept override;
+  void remapSlots(const std::vector<int>& slots) override;
+  bool decompose(const Expression*& left, const Expression*& right,
+                 Instruction& op,
+                 std::vector<Instruction>& out) const override;
 
  private:
-  std::unique_ptr<Expression> left_;
-  std::unique_ptr<Expression> right_;
+  Expression* left_;
+  Expression* right_;
   char op_;
+
+  // 在左右子树都已化简后化简本节点。
+  Expression* foldSelf(Optimizer& optimizer);
+};
+
+// 展开为后缀指令数组的表达式：指令连续存放在语句的 Arena 中，
+// 求值只是一个循环，没有逐节点的虚调用与指针跳转，也不随深度递归。
+class PostfixExpression : public Expression {
+ public:
+  // 把 expr 展开到 arena 中；叶子表达式原样返回。展开过程不递归。
+  static Expression* flatten(Expression* expr, Arena& arena);
+  // 把 expr 的后缀指令追加到 out，不递归。
+  static void expand(const Expression* expr, std::vector<Instruction>& out);
+
+  PostfixExpression(Instruction* code, int size, int maxDepth);
+  int evaluate(const VarState& state) const override;
+  void compile(Compiler& compiler) const override;
+  void remapSlots(const std::vector<int>& slots) override;
+  bool decompose(const Expression*& left, const Expression*& right,
+                 Instruction& op,
+                 std::vector<Instruction>& out) const override;
+
+ private:
+  // 求值栈不超过该深度时使用函数内的数组
+  static constexpr int kLocalStack = 32;
+
+  Instruction* code_;
+  int size_;
+  int maxDepth_;
+
+  int run(const VarState& state, int* stack) const;
 };
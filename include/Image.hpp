@@ -0,0 +1,115 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "Arena.hpp"
+#include "Bytecode.hpp"
+#include "Recorder.hpp"
+#include "utils/Error.hpp"
+#include "utils/MappedFile.hpp"
+
+class Expression;
+class SymbolTable;
+
+// 程序映像：SAVE IMAGE 把解析、化简后的程序行写成二进制文件，
+// LOAD IMAGE 映射文件后直接构造语句，不再经过 Lexer 与 Parser。
+// 文件依次为 Header、LineRecord[lines]、SymbolRecord[symbols]、
+// CodeRecord[code] 与字符串区（各行原始文本与变量名），
+// 所有字段按本机字节序存放，记录都按 4 字节对齐，可就地读取。
+// 载入的语句节点分配在 Image 自己的 Arena 中，原始文本直接指向映射的
+// 文件，因此 Image 须比它载入的语句活得久。
+class Image {
+ public:
+  // 格式变化时递增，旧版本的映像载入时报错。
+  static constexpr std::uint32_t kVersion = 1;
+
+  enum class Kind : std::uint8_t { LET, PRINT, INPUT, GOTO, IF, REM, END };
+
+  struct Header {
+    char magic[8];
+    // 字节序不同的机器上读出的版本号不匹配，一并拒绝
+    std::uint32_t version;
+    std::uint32_t lines;
+    std::uint32_t symbols;
+    std::uint32_t code;
+    std::uint32_t strings;
+  };
+
+  struct LineRecord {
+    std::int32_t line;
+    // LET/INPUT 的变量槽位，GOTO/IF 的目标行号
+    std::int32_t operand;
+    // 原始文本在字符串区中的位置
+    std::uint32_t text;
+    std::uint32_t textSize;
+    // 本行表达式的首条指令在 CodeRecord 中的下标，及各表达式的指令数
+    std::uint32_t code;
+    std::uint32_t size[2];
+    Kind kind;
+    char op;
+    std::uint8_t reserved[2];
+  };
+
+  struct SymbolRecord {
+    std::uint32_t name;
+    std::uint32_t size;
+  };
+
+  struct CodeRecord {
+    std::int32_t op;
+    std::int32_t operand;
+  };
+
+  // 写入失败时抛出 BasicError。先写临时文件再改名，不会留下半个映像。
+  static void save(const std::string& path, const Recorder& recorder,
+                   const SymbolTable& symbols);
+
+  // 映射文件并检查文件头，文件无法打开或格式不符时抛出 BasicError。
+  explicit Image(const std::string& path);
+  Image(const Image&) = delete;
+  Image& operator=(const Image&) = delete;
+
+  // 构造全部程序行，返回的语句不持有 Arena。映像中的变量名登记到
+  // symbols，槽位按需改写。记录不合法时抛出 BasicError。
+  std::vector<Recorder::Entry> load(SymbolTable& symbols);
+
+  // 映射的文件与 Arena 中节点占用的字节数。
+  std::size_t memoryUsage() const noexcept;
+
+ private:
+  std::string path_;
+  MappedFile file_;
+  Arena arena_;
+  const Header* header_;
+  const LineRecord* lines_;
+  const SymbolRecord* symbols_;
+  const CodeRecord* code_;
+  std::string_view strings_;
+
+  BasicError invalid() const;
+};
+
+// 保存映像时逐行收集记录，由各语句的 save 填入本行的内容。
+class ImageWriter {
+ public:
+  // 开始记录一行，source 为含行号的原始文本。
+  void beginLine(int line, std::string_view source);
+  // operand 与 op 的含义见 Image::LineRecord。
+  void setStatement(Image::Kind kind, int operand = 0, char op = 0);
+  // 追加本行的下一个表达式，最多两个。
+  void addExpression(const Expression* expr);
+
+  void write(const std::string& path, const SymbolTable& symbols);
+
+ private:
+  std::vector<Image::LineRecord> lines_;
+  std::vector<Image::CodeRecord> code_;
+  std::string strings_;
+  std::vector<Instruction> scratch_;
+  int expressions_{0};
+
+  std::uint32_t addString(std::string_view text);
+};
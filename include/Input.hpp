@@ -0,0 +1,57 @@
+#pragma once
+
+#include <cstddef>
+#include <optional>
+#include <string_view>
+#include <vector>
+
+class Output;
+
+// 按大块从文件描述符读入的输入层，命令行与 INPUT 共用同一缓冲区。
+// fd 为负时不读文件，数据由 feed 追加（如服务端收到的请求），
+// 此时缓冲区中没有完整的行不会阻塞，由 wouldBlock 告知调用方稍后再读。
+class Input {
+ public:
+  explicit Input(int fd);
+
+  // 类似 std::cin.tie：缓冲区中没有完整的行、需要从 fd 读入（可能阻塞）时，
+  // 先写出 output 中缓冲的输出，保证提示在等待输入前可见。
+  void tie(Output* output) noexcept;
+
+  // 读取下一行，不含换行符；输入结束时返回 false。
+  // 返回的视图在下一次读取前有效。
+  bool readLine(std::string_view& line);
+
+  // 只用于 fd 为负的输入：追加数据；close 之后不再有新数据，
+  // 最后不带换行符的部分作为最后一行。
+  void feed(std::string_view data);
+  void close() noexcept;
+  // 只用于 fd 为负的输入：丢弃未读的数据并撤销 close，之后可以再次 feed。
+  void reopen() noexcept;
+  // 缓冲区中没有完整的行、输入也未结束，readLine 只能等待 feed。
+  // 从 fd 读入的输入总是返回 false，readLine 会阻塞到有数据为止。
+  bool wouldBlock() const noexcept;
+  // INPUT 已写出提示、正在等待下一行，重新执行时不再重复提示。
+  bool awaiting() const noexcept;
+  void setAwaiting(bool awaiting) noexcept;
+  std::size_t memoryUsage() const noexcept;
+
+  // 解析 INPUT 读入的整数：允许首尾空白与一个正负号，
+  // 其余字符、空行或超出 int 范围时返回空。
+  static std::optional<int> parseInteger(std::string_view text) noexcept;
+
+ private:
+  static constexpr std::size_t kBlockSize = 64 * 1024;
+
+  int fd_;
+  Output* tie_;
+  std::vector<char> buffer_;
+  std::size_t begin_;
+  std::size_t end_;
+  bool eof_;
+  bool awaiting_;
+
+  void fill();
+  // 把未读完的部分移到缓冲区开头，并保证其后至少有 room 字节空间。
+  void compact(std::size_t room);
+};
@@ -0,0 +1,78 @@
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <optional>
+#include <ostream>
+#include <string>
+#include <string_view>
+
+#include "Lexer.hpp"
+#include "Optimizer.hpp"
+#include "Parser.hpp"
+#include "Program.hpp"
+
+// 供其他程序在进程内嵌入的解释器，由 basic_core 库提供：载入程序文本、
+// RUN、读写变量。PRINT 的输出、INPUT 提示与载入时的错误信息交给输出回调，
+// INPUT 向输入回调要下一行，不使用标准输入输出。
+class Interpreter {
+ public:
+  // 收到一段输出，可能含多行，也可能只是 INPUT 的 " ? " 提示。
+  using Writer = std::function<void(std::string_view)>;
+  // 返回 INPUT 读取的下一行（不含换行符），std::nullopt 表示输入已结束，
+  // 此时 INPUT 的变量保持原值。
+  using Reader = std::function<std::optional<std::string>()>;
+
+  struct Options {
+    Program::Engine engine{Program::Engine::BYTECODE};
+    bool fold{true};
+    // 为 0 时不编译机器码
+    int jitThreshold{VM::kJitThreshold};
+    // 一次 RUN 的上限，0 表示不限，见 Program::setLimits
+    std::uint64_t maxJumps{0};
+    std::chrono::milliseconds timeLimit{0};
+  };
+
+  Interpreter();
+  explicit Interpreter(const Options& options);
+  ~Interpreter();
+  Interpreter(const Interpreter&) = delete;
+  Interpreter& operator=(const Interpreter&) = delete;
+
+  // 未设置时丢弃输出、INPUT 读到输入结束。
+  void setOutput(Writer writer);
+  void setInput(Reader reader);
+
+  // 载入程序行，效果与逐行输入相同：同号的行被覆盖，只有行号时删除该行。
+  // 解析出错的行被跳过，错误信息写入输出。
+  void load(std::string_view source);
+  // 执行程序。运行时错误抛出 BasicError，此前的输出已写出。
+  void run();
+  // 执行一条不带行号的 LET、PRINT 或 INPUT 语句，出错时抛出 BasicError。
+  void execute(std::string_view statement);
+  // 清除程序行与变量。
+  void clear();
+
+  // 变量未定义时返回空。
+  std::optional<int> variable(std::string_view name);
+  void setVariable(std::string_view name, int value);
+
+  // 需要更多控制（分段执行、LIST、映像等）时直接使用。
+  Program& program() noexcept;
+
+ private:
+  class Sink;
+
+  std::unique_ptr<Sink> sink_;
+  std::ostream stream_;
+  Lexer lexer_;
+  Program program_;
+  Parser parser_;
+  Optimizer optimizer_;
+  Reader reader_;
+
+  // 把输入回调的下一行交给等待中的 INPUT。
+  void supply();
+};
@@ -0,0 +1,57 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "Bytecode.hpp"
+
+class Output;
+
+// x86-64 Linux 上，线索化分派的 VM 可以把热点区域交给 Jit 编译成机器码。
+// 定义 BASIC_NO_JIT 时关闭。
+#if defined(BASIC_THREADED_DISPATCH) && defined(__x86_64__) && \
+    defined(__linux__) && !defined(BASIC_NO_JIT)
+#define BASIC_JIT
+#endif
+
+// 机器码与 VM 交换状态的结构，布局由生成的代码按偏移直接访问。
+struct JitFrame {
+  int* values;              // VarState 的值数组
+  std::uint64_t* defined;   // VarState 的已赋值位图
+  int* stack;               // VM 的操作数栈
+  Output* output;
+  int depth;                // 返回时操作数栈的深度
+  std::uint64_t budget;     // 剩余的跳转预算，为 0 时返回解释器
+};
+
+// 把字节码中从某条指令开始的一段连续指令翻译成 x86-64 机器码。
+// 区域只含整数运算、LET、PRINT 与跳转；跳出区域、执行到 INPUT/END 等
+// 不支持的指令，或遇到除零、未定义变量等需要报错的情形时返回解释器，
+// 把操作数栈写回 VM，由解释器从同一条指令继续执行（并在原处报错）。
+// 每次向后跳转与解释器一样消耗一次预算，用完时停在跳转目标处返回。
+class Jit {
+ public:
+  Jit() = default;
+  Jit(const Jit&) = delete;
+  Jit& operator=(const Jit&) = delete;
+  ~Jit();
+
+  // 编译从指令 entry 开始的区域，返回区域编号；无法编译时返回 -1。
+  int compile(const Bytecode& bytecode, int entry);
+  // 执行区域，返回解释器继续执行的指令下标，frame.depth 为此时的栈深度。
+  int run(int region, JitFrame& frame) const;
+  // 已编译区域访问的变量槽位数，进入区域前 VarState 至少要容纳这么多。
+  int slots() const noexcept;
+
+ private:
+  using Entry = int (*)(JitFrame*);
+  struct Region {
+    void* memory;
+    std::size_t size;
+    Entry entry;
+  };
+
+  std::vector<Region> regions_;
+  int slots_{0};
+};
@@ -1,15 +1,16 @@
 #pragma once
 
-#include <string>
+#include <string_view>
 
 #include "Token.hpp"
 
 class Lexer {
  public:
-  TokenStream tokenize(const std::string& line) const;
+  // 返回的 Token 直接引用 line 中的字符，line 须在 TokenStream 使用期间保持有效。
+  TokenStream tokenize(std::string_view line) const;
 
  private:
   static bool isLetterChar(char ch) noexcept;
   static bool isNumberChar(char ch) noexcept;
-  static TokenType matchKeyword(const std::string& text) noexcept;
+  static TokenType matchKeyword(std::string_view text) noexcept;
 };
@@ -0,0 +1,46 @@
+#pragma once
+
+#include <cstddef>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "Recorder.hpp"
+
+class Lexer;
+class Optimizer;
+class Parser;
+class Program;
+
+// code --load 使用的批量载入：整个源文件映射进内存，逐行切分时不复制，
+// 全部解析完成后一次性排序合并进 Recorder。
+// 文件中只应出现带行号的程序行，出错的行按输入顺序把错误信息写入
+// Program 的输出并跳过。
+// 较大的文件按行切成若干段在线程池上并行解析，结果按输入顺序合并，
+// 与顺序解析的行表、错误输出和变量槽位完全一致。
+class Loader {
+ public:
+  Loader(const Lexer& lexer, const Parser& parser, Optimizer& optimizer);
+
+  // 解析使用的线程数，0 表示使用硬件线程数，1 表示在当前线程顺序解析。
+  void setJobs(std::size_t jobs) noexcept;
+
+  // 文件无法打开时抛出 BasicError。
+  void loadFile(const std::string& path, Program& program);
+  void loadText(std::string_view text, Program& program);
+
+ private:
+  struct Chunk;
+
+  const Lexer* lexer_;
+  const Parser* parser_;
+  Optimizer* optimizer_;
+  std::size_t jobs_{0};
+
+  void loadSequential(std::string_view text, Program& program);
+  void loadParallel(std::vector<Chunk>& chunks, std::size_t threads,
+                    Program& program);
+  void parseLine(std::string_view line, const Parser& parser,
+                 Optimizer& optimizer,
+                 std::vector<Recorder::Entry>& batch) const;
+};
@@ -0,0 +1,29 @@
+#pragma once
+
+#include "Statement.hpp"
+
+class Arena;
+class Expression;
+
+// 解析后对表达式树做常量折叠与代数化简，最后把表达式展开为后缀指令数组。
+// 只做不会改变运行时行为的变换：除零、溢出与未定义变量仍在原处以原样报错。
+class Optimizer {
+ public:
+  void setEnabled(bool enabled) noexcept;
+  bool enabled() const noexcept;
+
+  void optimize(StatementPtr& stmt);
+  // 返回化简后的表达式，可能就是传入的表达式本身。
+  Expression* fold(Expression* expr);
+  // 在当前语句的 Arena 中创建常量节点，只在 optimize 期间可用。
+  Expression* makeConstant(int value);
+
+  // 累计被化简掉的节点数。
+  void countRemoved(int nodes) noexcept;
+  long long removedNodes() const noexcept;
+
+ private:
+  bool enabled_{true};
+  long long removed_{0};
+  Arena* arena_{nullptr};
+};
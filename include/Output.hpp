@@ -0,0 +1,35 @@
+#pragma once
+
+#include <cstddef>
+#include <iosfwd>
+#include <memory>
+#include <string_view>
+
+// PRINT 输出、INPUT 提示等运行时输出的缓冲层。
+// 整数用 std::to_chars 直接写入缓冲区，只在读取输入前、RUN 结束、出错
+// 或缓冲区写满时整块写出；行缓冲模式下每写完一行就写出，供交互使用。
+class Output {
+ public:
+  explicit Output(std::ostream& stream);
+  ~Output();
+  Output(const Output&) = delete;
+  Output& operator=(const Output&) = delete;
+
+  void setLineBuffered(bool lineBuffered) noexcept;
+
+  // 输出整数并换行。
+  void printLine(int value);
+  void write(std::string_view text);
+  void flush();
+  std::size_t memoryUsage() const noexcept;
+
+ private:
+  static constexpr std::size_t kBufferSize = 64 * 1024;
+
+  std::ostream* stream_;
+  std::unique_ptr<char[]> buffer_;
+  std::size_t size_;
+  bool lineBuffered_;
+
+  void drain();
+};
@@ -2,16 +2,22 @@
 
 #include <memory>
 #include <optional>
+#include <string>
+#include <string_view>
 
+#include "Arena.hpp"
+#include "Statement.hpp"
 #include "Token.hpp"
 
-class Statement;
 class Expression;
+class SymbolTable;
 
 class ParsedLine {
  private:
   std::optional<int> line_number_;
-  std::unique_ptr<Statement> statement_;
+  // 本行全部语法树节点所在的 Arena，fetchStatement 时随语句一起交出。
+  std::unique_ptr<Arena> arena_;
+  Statement* statement_;
 
  public:
   ParsedLine();
@@ -19,35 +25,50 @@ class ParsedLine {
 
   void setLine(int line);
   std::optional<int> getLine();
-  void setStatement(std::unique_ptr<Statement> stmt);
+  Arena& arena();
+  void setStatement(Statement* stmt);
   const Statement* getStatement() const;
-  std::unique_ptr<Statement> fetchStatement();
+  StatementPtr fetchStatement();
 };
 
 class Parser {
  public:
+  // 解析到的变量名登记在 symbols 中，Parser 不持有其所有权。
+  // Parser 不保存解析状态；SymbolTable 不加锁，并发解析时每个线程使用各自的表。
+  explicit Parser(SymbolTable& symbols);
+
   std::unique_ptr<ParsedLine> parseLine(TokenStream& tokens,
-                       const std::string& originLine) const;
+                       std::string_view originLine) const;
 
  private:
-  std::unique_ptr<Statement> parseStatement(TokenStream& tokens,
-                            const std::string& originLine) const;
-  std::unique_ptr<Statement> parseLet(TokenStream& tokens, const std::string& originLine) const;
-  std::unique_ptr<Statement> parsePrint(TokenStream& tokens,
-                        const std::string& originLine) const;
-  std::unique_ptr<Statement> parseInput(TokenStream& tokens,
-                        const std::string& originLine) const;
-  std::unique_ptr<Statement> parseGoto(TokenStream& tokens,
-                       const std::string& originLine) const;
-  std::unique_ptr<Statement> parseIf(TokenStream& tokens, const std::string& originLine) const;
-  std::unique_ptr<Statement> parseRem(TokenStream& tokens, const std::string& originLine) const;
-  std::unique_ptr<Statement> parseEnd(TokenStream& tokens, const std::string& originLine) const;
-
-  std::unique_ptr<Expression> parseExpression(TokenStream& tokens) const;
-  std::unique_ptr<Expression> parseExpression(TokenStream& tokens, int precedence) const;
+  // 语句与表达式节点都分配在 arena 中。
+  Statement* parseStatement(TokenStream& tokens, std::string_view originLine,
+                            Arena& arena) const;
+  Statement* parseLet(TokenStream& tokens, std::string_view originLine,
+                      Arena& arena) const;
+  Statement* parsePrint(TokenStream& tokens, std::string_view originLine,
+                        Arena& arena) const;
+  Statement* parseInput(TokenStream& tokens, std::string_view originLine,
+                        Arena& arena) const;
+  Statement* parseGoto(TokenStream& tokens, std::string_view originLine,
+                       Arena& arena) const;
+  Statement* parseIf(TokenStream& tokens, std::string_view originLine,
+                     Arena& arena) const;
+  Statement* parseRem(TokenStream& tokens, std::string_view originLine,
+                      Arena& arena) const;
+  Statement* parseEnd(TokenStream& tokens, std::string_view originLine,
+                      Arena& arena) const;
+
+  // 括号嵌套的上限。每层括号递归一次，超出时报 EXPRESSION TOO DEEP，
+  // 避免在线程栈较小的服务端或嵌入方中栈溢出。
+  static constexpr int kMaxDepth = 1000;
+
+  Expression* parseExpression(TokenStream& tokens, Arena& arena) const;
+  Expression* parseExpression(TokenStream& tokens, int precedence, int depth,
+                              Arena& arena) const;
 
   int getPrecedence(TokenType op) const;
   int parseLiteral(const Token* token) const;
 
-  mutable int leftParentCount{0};
+  SymbolTable* symbols_;
 };
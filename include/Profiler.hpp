@@ -0,0 +1,43 @@
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <iosfwd>
+#include <vector>
+
+class Recorder;
+
+// 逐行统计一次 RUN 中每个程序行的执行次数与耗时（纳秒）。
+// 只有启用性能统计时 Program 才会创建它，运行循环据此选择带统计的实例，
+// 未启用时执行的代码中没有任何统计开销。
+class Profiler {
+ public:
+  struct Sample {
+    int line;
+    std::uint64_t count;
+    std::uint64_t nanos;
+  };
+
+  // 按 Recorder 当前的行表清零，样本下标与 Recorder 下标一致。
+  void reset(const Recorder& recorder);
+
+  static std::uint64_t now() noexcept {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+               std::chrono::steady_clock::now().time_since_epoch())
+        .count();
+  }
+  void count(int index) noexcept { ++samples_[index].count; }
+  void charge(int index, std::uint64_t nanos) noexcept {
+    samples_[index].nanos += nanos;
+  }
+
+  const std::vector<Sample>& samples() const noexcept;
+
+  // PROFILE 命令输出的表格：行号、次数、耗时、占比与语句文本。
+  void report(std::ostream& out, const Recorder& recorder) const;
+  // flamegraph.pl 等工具读取的折叠栈格式，每行 "RUN;<行号> <语句> <纳秒>"。
+  void writeFolded(std::ostream& out, const Recorder& recorder) const;
+
+ private:
+  std::vector<Sample> samples_;
+};
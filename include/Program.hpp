@@ -1,34 +1,155 @@
 #pragma once
 
+#include <chrono>
+#include <cstdint>
+#include <iosfwd>
 #include <memory>
+#include <string>
+#include <vector>
 
+#include "Bytecode.hpp"
+#include "Compiler.hpp"
+#include "Image.hpp"
+#include "Input.hpp"
+#include "Output.hpp"
+#include "Profiler.hpp"
 #include "Recorder.hpp"
+#include "SymbolTable.hpp"
 #include "VarState.hpp"
+#include "VM.hpp"
 
 class Statement;
 
 class Program {
  public:
+  // RUN 的执行方式：逐行解释语句树，或编译为字节码后执行。
+  enum class Engine { TREE, BYTECODE };
+  // 分段执行时 resume 的结果，含义见 VM::Status。
+  using Status = VM::Status;
+  // 按时间分段时，每执行这么多次向后跳转检查一次时钟。
+  static constexpr std::uint64_t kClockInterval = 1 << 14;
+
+  // 输出写到标准输出，输入读自标准输入。
   Program();
+  // 输出写到 out；inputFd 为负时输入不读文件，由 input().feed 提供，
+  // INPUT 没有下一行时不阻塞而是让执行暂停，见 resume。
+  Program(std::ostream& out, int inputFd);
+
+  void setEngine(Engine engine) noexcept;
+  // 开启后每次 RUN 逐行统计执行次数与耗时，供 PROFILE 输出。
+  void setProfiling(bool enabled);
+  // 开启后字节码执行时统计超级指令省下的分派次数。
+  void setCountingDispatches(bool enabled) noexcept;
+  // 最近一次 RUN 省下的分派次数与当前字节码中的超级指令条数。
+  std::uint64_t savedDispatches() const noexcept;
+  std::size_t fusedInstructions() const noexcept;
+  // 字节码执行时把热点区域编译为机器码，threshold 为区域入口执行多少次后
+  // 编译。只在 x86-64 Linux 上生效，统计时不编译。
+  void setJit(bool enabled, int threshold = VM::kJitThreshold) noexcept;
+  // 一次 RUN 的上限，0 表示不限：向后跳转达到 jumps 次时以
+  // JUMP LIMIT EXCEEDED、执行时间（不含暂停期间）达到 time 时以
+  // TIME LIMIT EXCEEDED 结束执行。
+  void setLimits(std::uint64_t jumps, std::chrono::nanoseconds time) noexcept;
+
+  // 供 Parser 登记变量名；槽位在整个 Program 生命周期内保持不变。
+  SymbolTable& symbols() noexcept;
+  // 变量的当前值，按 symbols() 分配的槽位存取。
+  VarState& variables() noexcept;
+
+  // PRINT、INPUT 提示、LIST 等使用的缓冲输出，每次 RUN 或立即执行结束时写出。
+  Output& output() noexcept;
+  // 命令行与 INPUT 共用的输入。
+  Input& input() noexcept;
 
-  void addStmt(int line, Statement* stmt);
+  // 修改程序会放弃尚未结束的分段执行。
+  void addStmt(int line, StatementPtr stmt);
   void removeStmt(int line);
+  // 一次性加入多行，语义与按顺序逐行 addStmt/removeStmt 相同。
+  void addStmts(std::vector<Recorder::Entry> batch);
+  // SAVE IMAGE / LOAD IMAGE：把程序行写成二进制映像，或从映像载入，
+  // 载入的语义与按顺序输入映像中的各行相同。出错时抛出 BasicError。
+  void saveImage(const std::string& path) const;
+  void loadImage(const std::string& path);
 
+  // 执行到程序结束；输入不阻塞时也可能停在等待 INPUT 处，由 resume 继续。
   void run();
-  void list() const;
+  // 分段执行 RUN，用法类似协程：start 从首行开始新的一次执行，resume
+  // 继续执行到程序结束、向后跳转的次数达到 budget（计数循环的每一轮都
+  // 计入）或 INPUT 需要等待输入为止。宿主可以让多个 Program 各自 start 后
+  // 轮流 resume，WAITING 时先 input().feed 再继续。出错或超出 setLimits 的
+  // 上限时抛出 BasicError，执行随之结束；每次 resume 返回前写出缓冲的输出。
+  void start();
+  Status resume(std::uint64_t budget);
+  // 同 resume，另外执行满 time 后也返回 YIELDED（每 kClockInterval 次向后
+  // 跳转检查一次时钟，因此可能略超出）。
+  Status resumeFor(std::chrono::nanoseconds time,
+                   std::uint64_t budget = VM::kUnlimited);
+  // 是否有已开始、尚未结束的执行。
+  bool running() const noexcept;
+  void list();
+  // 输出最近一次 RUN 的逐行统计；未开启统计时不输出。
+  void profile();
+  // 以 flamegraph 折叠栈格式写出最近一次 RUN 的统计。
+  void writeProfile(std::ostream& out) const;
   void clear();
 
-  void execute(Statement* stmt);
+  // 立即执行一条语句。INPUT 需要等待输入时返回 WAITING，
+  // 有输入后再次执行同一条语句即可。
+  Status execute(Statement* stmt);
+  // 程序行、变量、编译结果与输入输出缓冲占用的字节数（近似值）。
+  std::size_t memoryUsage() const;
 
   int getPC() const noexcept;
   void changePC(int line);
+  // 跳转到已链接的目标行下标；target 为 -1 表示目标行不存在。
+  void jump(int line, int target);
   void programEnd();
+  // 由 INPUT 调用：输入暂时没有下一行，停在本语句等待。
+  void waitForInput() noexcept;
 
  private:
+  // LOAD IMAGE 载入的映像，语句位于其中，须在 Recorder 之后析构；
+  // 映像中的行被覆盖或删除后，所占内存到 CLEAR 时才释放
+  std::vector<std::unique_ptr<Image>> images_;
   Recorder recorder_;
+  SymbolTable symbols_;
   VarState vars_;
   int programCounter_;
   bool programEnd_;
+  int jumpTarget_;
+  unsigned linkedRevision_;
+  bool linked_;
+  Engine engine_;
+  std::ostream& stream_;
+  Output output_;
+  Input input_;
+  // 保留逐行编译结果，编辑后再次 RUN 只重新编译改动过的行
+  Compiler compiler_;
+  const Bytecode* bytecode_;
+  unsigned compiledRevision_;
+  bool compiled_;
+  // 未开启统计时为空，运行循环选择不含统计代码的实例
+  std::unique_ptr<Profiler> profiler_;
+  bool countDispatches_;
+  std::uint64_t savedDispatches_;
+  // 为 0 时不编译
+  int jitThreshold_;
+  // 分段执行的状态：逐行解释时下一段从哪一行继续，字节码的状态在 VM 中
+  VM vm_;
+  int index_;
+  bool running_;
+  bool waiting_;
+  // 本次 RUN 的上限与已用掉的部分
+  std::uint64_t jumpLimit_;
+  std::chrono::nanoseconds timeLimit_;
+  std::uint64_t jumps_;
+  std::chrono::nanoseconds elapsed_;
 
+  Status proceed(std::uint64_t budget, std::chrono::nanoseconds time);
+  // 执行一段，budget 减去用掉的向后跳转次数
+  Status advance(std::uint64_t& budget);
+  template <bool Profile>
+  Status runTree(std::uint64_t& remaining);
+  void compileBytecode();
   void resetAfterRun() noexcept;
 };
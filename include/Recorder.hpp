@@ -1,24 +1,59 @@
 #pragma once
 
-#include <map>
 #include <memory>
 #include <vector>
 
 #include "Statement.hpp"
 
+class Output;
+
 class Recorder {
 public:
-  ~Recorder();
+  struct Entry {
+    int line;
+    StatementPtr stmt;
+  };
 
-  void add(int line, Statement* stmt);
+  void add(int line, StatementPtr stmt);
+  // 批量载入：batch 按输入顺序排列，stmt 为空表示删除该行，同一行以最后一次为准。
+  // 整批只排序合并一次。
+  void addBatch(std::vector<Entry> batch);
   void remove(int line);
-  const Statement* get(int line) const noexcept;
-  bool hasLine(int line) const noexcept;
+  const Statement* get(int line) const;
+  bool hasLine(int line) const;
   void clear() noexcept;
-  void printLines() const;
-  int nextLine(int line) const noexcept;
+  void printLines(Output& output) const;
+  int nextLine(int line) const;
+  // 让每条语句解析自己的跳转目标，行增删后需重新调用。
+  void link();
+  // 每次增删行后递增，用于判断编译结果是否过期。
+  unsigned revision() const noexcept;
+  // 自上次 clearDirty 以来新增、替换或删除过的行号，可能重复、无序；
+  // clear 之后 allDirty 为真，此时行号列表不完整。供增量编译使用。
+  const std::vector<int>& dirtyLines() const noexcept;
+  bool allDirty() const noexcept;
+  void clearDirty() noexcept;
+  // 行表与各行 Arena 占用的字节数（近似值）。
+  std::size_t memoryUsage() const;
+
+  // 按行号升序的下标访问，顺序执行时下一行即下标加一。
+  int size() const;
+  int indexOf(int line) const;
+  int lineAt(int index) const;
+  const Statement* stmtAt(int index) const;
 
 private:
-  // TODO.
-  std::map<int, Statement*> lineToStmt;
+  // 按行号有序的连续行表。
+  mutable std::vector<Entry> lines_;
+  // 乱序插入的行先追加到这里，下次查询前一次性排序合并；不超过
+  // kDirectInserts 行时逐行插入。
+  static constexpr std::size_t kDirectInserts = 16;
+  mutable std::vector<Entry> pending_;
+  unsigned revision_{0};
+  std::vector<int> dirty_;
+  bool allDirty_{false};
+
+  void flush() const;
+  void merge(std::vector<Entry>& batch) const;
+  std::vector<Entry>::const_iterator find(int line) const;
 };
\ No newline at end of file
@@ -0,0 +1,99 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "Session.hpp"
+#include "utils/ThreadPool.hpp"
+
+// 在一个进程中服务多个会话：监听 Unix 域套接字，每个连接是一个独立的
+// Session（各自的 Program、VarState 与 Recorder）。一个线程用 epoll 收发
+// 数据，命令在工作线程池上执行；RUN 每执行 slice 次向后跳转就让出工作线程，
+// 排到队尾，死循环不会占住其他会话。
+//
+// 协议与标准输入相同，逐行发送命令；每条命令处理完后先写出它的输出，
+// 再写一个 '\0'，RUN 期间被 INPUT 读走的行不算命令。QUIT 或输入结束后
+// 关闭连接。
+// STATS 命令报告本会话占用的内存与服务端的命令延迟。
+class Server {
+ public:
+  // 每段 RUN 默认的向后跳转次数。
+  static constexpr std::uint64_t kDefaultSlice = 100000;
+
+  struct Options {
+    std::string path;
+    // 为 0 时使用硬件线程数
+    std::size_t workers{0};
+    std::uint64_t slice{kDefaultSlice};
+    Session::Options session;
+  };
+
+  // 命令延迟以毫秒计：从命令可以执行（数据到达或上一条命令结束）到
+  // 输出就绪，取最近 kLatencySamples 条命令。
+  struct Stats {
+    std::size_t sessions;
+    std::uint64_t commands;
+    double p50;
+    double p99;
+  };
+
+  // 创建并监听套接字，已存在的同名文件会被替换。失败时抛出 BasicError。
+  explicit Server(const Options& options);
+  ~Server();
+  Server(const Server&) = delete;
+  Server& operator=(const Server&) = delete;
+
+  // 处理连接直到 stop。
+  void run();
+  // 可在任意线程或信号处理函数中调用。
+  void stop() noexcept;
+  Stats stats();
+
+ private:
+  struct Connection;
+  using Clock = std::chrono::steady_clock;
+
+  static constexpr std::size_t kLatencySamples = 1 << 16;
+  // 一次调度最多处理的命令数，之后排到队尾
+  static constexpr int kCommandsPerTurn = 64;
+  // 待写出的输出超过此值时暂停执行，写出后再继续
+  static constexpr std::size_t kOutboxLimit = 1 << 20;
+
+  Options options_;
+  int listenFd_{-1};
+  int epollFd_{-1};
+  int wakeFd_{-1};
+  std::atomic<bool> stopping_{false};
+  // 只由事件循环线程访问
+  std::unordered_map<int, std::shared_ptr<Connection>> connections_;
+  std::unique_ptr<ThreadPool> pool_;
+
+  // 工作线程交给事件循环写出或关闭的连接
+  std::mutex noticeMutex_;
+  std::vector<std::shared_ptr<Connection>> notices_;
+
+  std::mutex statsMutex_;
+  std::vector<std::uint32_t> latencies_;
+  std::uint64_t commands_{0};
+  std::size_t sessions_{0};
+
+  void accept();
+  void receive(const std::shared_ptr<Connection>& connection);
+  void send(const std::shared_ptr<Connection>& connection);
+  void drop(const std::shared_ptr<Connection>& connection);
+  void watch(Connection& connection, bool writable);
+  void wake() noexcept;
+  // 调用方持有 connection 的锁
+  void schedule(const std::shared_ptr<Connection>& connection);
+  void serve(const std::shared_ptr<Connection>& connection);
+  void notify(const std::shared_ptr<Connection>& connection);
+  void record(Clock::time_point since);
+  void report(Session& session, Output& output);
+};
@@ -0,0 +1,72 @@
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <iosfwd>
+#include <memory>
+#include <string>
+#include <string_view>
+
+#include "Lexer.hpp"
+#include "Optimizer.hpp"
+#include "Parser.hpp"
+#include "Program.hpp"
+
+// 一个交互会话：一个 Program 及解析它所需的 Lexer、Parser 与 Optimizer。
+// 逐行读取输入中的命令、立即执行语句与程序行并执行，错误信息与程序
+// 输出一起写入会话的输出。标准输入上的解释器与服务端的每个连接各是一个会话。
+class Session {
+ public:
+  struct Options {
+    Program::Engine engine{Program::Engine::BYTECODE};
+    bool fold{true};
+    bool profile{false};
+    // 非空时 PROFILE 另以 flamegraph 折叠栈格式写入该文件
+    std::string profilePath;
+    // 为 0 时不编译机器码
+    int jitThreshold{VM::kJitThreshold};
+    bool lineBuffered{false};
+    // 为假时 SAVE IMAGE、LOAD IMAGE 与其他无法识别的行一样报错，PROFILE 也不
+    // 写入 profilePath；服务端的会话不应以服务进程的身份读写文件
+    bool fileCommands{true};
+    // 一次 RUN 的向后跳转次数与执行时间上限，0 表示不限，见 Program::setLimits
+    std::uint64_t maxJumps{0};
+    std::chrono::milliseconds timeLimit{0};
+    // 非空时每次 RUN 后在这里输出超级指令统计
+    std::ostream* stats{nullptr};
+    // STATS 命令的输出；为空时 STATS 与其他无法识别的行一样报错
+    std::function<void(Session&, Output&)> report;
+  };
+
+  // step 的结果：处理完一行；输入中暂时没有完整的行；RUN 用完跳转预算；
+  // INPUT 等待输入；收到 QUIT；输入已结束。
+  enum class Step { DONE, IDLE, YIELDED, WAITING, QUIT, END };
+
+  // 输出写到 out；inputFd 为负时输入由 program().input().feed 提供。
+  Session(const Options& options, std::ostream& out, int inputFd);
+  Session(const Session&) = delete;
+  Session& operator=(const Session&) = delete;
+
+  Program& program() noexcept;
+  Lexer& lexer() noexcept;
+  Parser& parser() noexcept;
+  Optimizer& optimizer() noexcept;
+
+  // 继续尚未结束的 RUN 或等待输入的立即 INPUT，否则读取并处理输入中的
+  // 下一行。RUN 最多执行 budget 次向后跳转后返回 YIELDED，下次 step 接着执行。
+  // 行中的错误写入输出后返回 DONE。
+  Step step(std::uint64_t budget);
+
+ private:
+  Options options_;
+  Lexer lexer_;
+  Program program_;
+  Parser parser_;
+  Optimizer optimizer_;
+  // 等待输入的立即执行 INPUT
+  StatementPtr pending_;
+
+  Step execute(std::string_view line, std::uint64_t budget);
+  Step finishRun(Program::Status status);
+};
@@ -1,77 +1,145 @@
 #pragma once
 
 #include <memory>
+#include <optional>
 #include <string>
+#include <string_view>
+#include <vector>
 
 #include "Expression.hpp"
 
+class Arena;
+class Compiler;
+class ImageWriter;
+class Input;
+class Optimizer;
+class Output;
 class Program;
+class Recorder;
 class VarState;
 
 class Statement {
  public:
-  explicit Statement(std::string source);
+  // source 指向语句所在 Arena 中的原始文本。
+  explicit Statement(std::string_view source);
   virtual ~Statement() = default;
 
   virtual void execute(VarState& state, Program& program) const = 0;
+  virtual void compile(Compiler& compiler) const = 0;
+  // 在 RUN 之前把跳转目标解析为目标行在 Recorder 中的下标，默认无事可做。
+  virtual void link(const Recorder& recorder);
+  // 化简语句中的表达式，默认无事可做。
+  virtual void optimize(Optimizer& optimizer);
+  // 把变量槽位 s 改写为 slots[s]，默认无事可做。
+  virtual void remapSlots(const std::vector<int>& slots);
+  // 把表达式展开为后缀指令数组，放在语句所在的 Arena 中，默认无事可做。
+  virtual void flatten(Arena& arena);
+  // 把语句种类、操作数与表达式的后缀指令写入程序映像。
+  virtual void save(ImageWriter& image) const = 0;
 
   const std::string& text() const noexcept;
+  // 含行号的原始文本。
+  std::string_view source() const noexcept;
 
  private:
-  std::string source_;
+  std::string_view source_;
 };
 
+// 语句与其表达式节点同在一个 Arena 中，释放语句即整体释放该 Arena。
+// arena 为空表示语句位于他处持有的共享 Arena（如程序映像），不随语句释放。
+struct StatementDeleter {
+  Arena* arena{nullptr};
+  void operator()(Statement* stmt) const noexcept;
+};
+using StatementPtr = std::unique_ptr<Statement, StatementDeleter>;
+
 // TODO: Other statement types derived from Statement, e.g., GOTOStatement,
 // LetStatement, etc.
 
 class LETStatement : public Statement {
-  std::string var;
-  std::unique_ptr<Expression> expr;
+  int var;
+  Expression* expr;
 public:
-  LETStatement(std::string source, std::string var, std::unique_ptr<Expression> expr);
+  LETStatement(std::string_view source, int var, Expression* expr);
   void execute(VarState& state, Program& program) const override;
+  void compile(Compiler& compiler) const override;
+  void save(ImageWriter& image) const override;
+  void optimize(Optimizer& optimizer) override;
+  void remapSlots(const std::vector<int>& slots) override;
+  void flatten(Arena& arena) override;
 };
 
 class PRINTStatement : public Statement {
-  std::unique_ptr<Expression> expr;
+  Expression* expr;
 public:
-  PRINTStatement(std::string source, std::unique_ptr<Expression> expr);
+  PRINTStatement(std::string_view source, Expression* expr);
   void execute(VarState& state, Program& program) const override;
+  void compile(Compiler& compiler) const override;
+  void save(ImageWriter& image) const override;
+  void optimize(Optimizer& optimizer) override;
+  void remapSlots(const std::vector<int>& slots) override;
+  void flatten(Arena& arena) override;
 };
 
 class INPUTStatement : public Statement {
-  std::string var;
+  int var;
 public:
-  INPUTStatement(std::string source, std::string var);
+  INPUTStatement(std::string_view source, int var);
   void execute(VarState& state, Program& program) const override;
+  void compile(Compiler& compiler) const override;
+  void save(ImageWriter& image) const override;
+  void remapSlots(const std::vector<int>& slots) override;
+
+  // 读入的结果：VALUE 为读到合法整数；END 为输入已结束，变量保持原值；
+  // WAIT 为不阻塞的 Input 中暂时没有下一行，提示已经写出，有新输入后
+  // 重新执行本语句即可接着读取。
+  enum class Read { VALUE, END, WAIT };
+
+  // 输出提示并读入一个合法整数写入 value，非法输入时重试。
+  static Read readValue(Output& output, Input& input, int& value);
 };
 
 class GOTOStatement : public Statement {
   int line;
+  int target;
 public:
-  GOTOStatement(std::string source, int line);
+  GOTOStatement(std::string_view source, int line);
   void execute(VarState& state, Program& program) const override;
+  void compile(Compiler& compiler) const override;
+  void save(ImageWriter& image) const override;
+  void link(const Recorder& recorder) override;
 };
 
 class IFStatement : public Statement {
-  std::unique_ptr<Expression> expr1;
-  std::unique_ptr<Expression> expr2;
+  Expression* expr1;
+  Expression* expr2;
   char op;
   int line;
+  int target;
 public:
-  IFStatement(std::string source, std::unique_ptr<Expression> expr1,
-    std::unique_ptr<Expression> expr2, char op, int line);
+  IFStatement(std::string_view source, Expression* expr1,
+    Expression* expr2, char op, int line);
   void execute(VarState& state, Program& program) const override;
+  void compile(Compiler& compiler) const override;
+  void save(ImageWriter& image) const override;
+  void link(const Recorder& recorder) override;
+  void optimize(Optimizer& optimizer) override;
+  void remapSlots(const std::vector<int>& slots) override;
+  void flatten(Arena& arena) override;
 };
 
 class REMStatement : public Statement {
 public:
-  REMStatement(std::string source);
+  REMStatement(std::string_view source);
   void execute(VarState& state, Program& program) const override;
+  void compile(Compiler& compiler) const override;
+  void save(ImageWriter& image) const override;
 };
 
 class ENDStatement : public Statement {
 public:
-  ENDStatement(std::string source);
+  ENDStatement(std::string_view source);
   void execute(VarState& state, Program& program) const override;
+  void compile(Compiler& compiler) const override;
+  void save(ImageWriter& image) const override;
 };
@@ -0,0 +1,23 @@
+#pragma once
+
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+// 解析时为每个变量名分配一个稠密的整数槽位，运行时按槽位访问 VarState。
+class SymbolTable {
+ public:
+  // 返回变量名对应的槽位，首次出现时分配新槽位。
+  int intern(std::string_view name);
+  // 返回变量名对应的槽位，不存在则返回 -1。
+  int find(std::string_view name) const;
+  const std::string& name(int slot) const;
+  int size() const noexcept;
+  // 名字与查找表占用的字节数（近似值）。
+  std::size_t memoryUsage() const noexcept;
+
+ private:
+  std::unordered_map<std::string, int> slots_;
+  std::vector<std::string> names_;
+};
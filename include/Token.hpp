@@ -1,6 +1,6 @@
 #pragma once
 
-#include <string>
+#include <string_view>
 #include <vector>
 
 enum class TokenType {
@@ -39,7 +39,7 @@ enum class TokenType {
 
 struct Token {
   TokenType type{TokenType::UNKNOWN};
-  std::string text{};
+  std::string_view text{};  // 指向源行，不拥有字符
   int column{0};
 };
 
@@ -0,0 +1,98 @@
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+#include "Bytecode.hpp"
+
+class Input;
+class Jit;
+class Output;
+class Profiler;
+class VarState;
+
+// 执行 Compiler 生成的字节码。一次执行可以分成若干段：每段最多执行
+// 给定次数的向后跳转后暂停，下一段从暂停处继续，供多个程序轮流执行。
+// 循环都要经过向后的跳转，因此每段的执行时间有界。
+class VM {
+ public:
+  // 热点区域入口的默认编译阈值。
+  static constexpr int kJitThreshold = 64;
+  // 不限制向后跳转次数时的预算。
+  static constexpr std::uint64_t kUnlimited = UINT64_MAX;
+
+  // resume 的结果：执行结束；用完跳转预算而暂停；INPUT 暂时没有输入
+  // （提示已写出），有输入后 resume 从该 INPUT 继续。
+  enum class Status { FINISHED, YIELDED, WAITING };
+
+  VM();
+  ~VM();
+  VM(const VM&) = delete;
+  VM& operator=(const VM&) = delete;
+
+  // 区域入口被执行 threshold 次后把该处开始的区域编译为机器码，0 表示
+  // 不编译。只在支持 Jit 的平台上、不统计时生效。
+  void setJitThreshold(int threshold) noexcept;
+
+  // profiler 非空时逐行统计执行次数与耗时；saved 非空时累加超级指令
+  // 省下的分派次数。两者都为空时运行不含统计代码的实例。
+  void run(const Bytecode& bytecode, VarState& state, Output& output,
+           Input& input, Profiler* profiler = nullptr,
+           std::uint64_t* saved = nullptr);
+
+  // 准备从入口开始执行 bytecode，丢弃尚未结束的上一次执行。执行结束前
+  // bytecode、profiler 与 saved 须保持有效且不被修改。
+  void start(const Bytecode& bytecode, Profiler* profiler = nullptr,
+             std::uint64_t* saved = nullptr);
+  // 继续执行，最多执行 budget 次向后跳转（计数循环的每一轮、
+  // 机器码中的跳转都计入），返回时 budget 减去本段用掉的次数；budget 为 0
+  // 时立即返回 YIELDED。出错时抛出 BasicError，执行随之结束。
+  Status resume(VarState& state, Output& output, Input& input,
+                std::uint64_t& budget);
+  // 是否有已开始、尚未结束的执行。
+  bool running() const noexcept;
+
+ private:
+  // 线索化后的指令：操作码换成处理代码的地址。
+  struct ThreadedInstruction {
+    const void* handler;
+    int operand;
+    bool backward;
+  };
+  // 热点区域的入口：执行次数、编译出的区域与被 HOT/JIT 替换的原指令。
+  struct JitEntry {
+    int position;
+    int count;
+    int region;
+    ThreadedInstruction original;
+  };
+
+  template <bool Profile, bool Count>
+  Status execute(VarState& state, Output& output, Input& input,
+                 std::uint64_t& remaining);
+
+  int jitThreshold_{0};
+  const Bytecode* bytecode_{nullptr};
+  Profiler* profiler_{nullptr};
+  std::uint64_t* saved_{nullptr};
+  // 下一段从哪条指令、以多深的操作数栈继续，-1 表示没有进行中的执行
+  int resume_{-1};
+  int depth_{0};
+  std::vector<int> stack_;
+  // 由执行它的实例生成。字节码、它的 revision 与实例都未变时，之后的段与
+  // 之后的 RUN 都沿用，每次 RUN 只需把热点入口恢复为计数的 HOT；字节码
+  // 由上一版本增量编译而来时只更新追加与改写的指令
+  std::vector<ThreadedInstruction> threaded_;
+  std::vector<JitEntry> entries_;
+  std::unique_ptr<Jit> jit_;
+  const Bytecode* translated_{nullptr};
+  unsigned translatedRevision_{0};
+  int translatedMode_{-1};
+  bool rearm_{false};
+  // 统计用：每条指令是哪一行的首条指令（-1 表示不是）与当前所在行；
+  // 等待输入后从 INPUT 继续时不重复计入该行
+  std::vector<int> lineOf_;
+  int current_{-1};
+  bool reentering_{false};
+};
@@ -1,16 +1,25 @@
 #pragma once
 
-#include <string>
-#include <unordered_map>
-#include <utility>
+#include <cstddef>
+#include <cstdint>
 #include <vector>
 
+// 变量按 SymbolTable 分配的槽位存放在连续数组中，另用位图记录是否已赋值。
 class VarState {
  public:
-  void setValue(const std::string& name, int value);
-  int getValue(const std::string& name) const;
+  void setValue(int slot, int value);
+  int getValue(int slot) const;
+  bool isDefined(int slot) const noexcept;
   void clear();
+  std::size_t memoryUsage() const noexcept;
+
+  // 供 Jit 生成的代码直接读写：保证槽位 [0, slots) 都在数组范围内，
+  // 之后取得的指针在下一次 setValue/reserve 之前有效。
+  void reserve(int slots);
+  int* values() noexcept;
+  std::uint64_t* definedBits() noexcept;
 
  private:
-  std::unordered_map<std::string, int> values_;
+  std::vector<int> values_;
+  std::vector<std::uint64_t> defined_;
 };
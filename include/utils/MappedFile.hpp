@@ -0,0 +1,21 @@
+#pragma once
+
+#include <cstddef>
+#include <string>
+#include <string_view>
+
+// 以只读方式把整个文件映射进内存，析构时解除映射。
+class MappedFile {
+ public:
+  // 文件无法打开或映射时抛出 BasicError。
+  explicit MappedFile(const std::string& path);
+  ~MappedFile();
+  MappedFile(const MappedFile&) = delete;
+  MappedFile& operator=(const MappedFile&) = delete;
+
+  std::string_view text() const noexcept;
+
+ private:
+  void* data_;
+  std::size_t size_;
+};
@@ -0,0 +1,21 @@
+#pragma once
+
+#include <chrono>
+#include <string>
+#include <vector>
+
+// 子进程的运行结果。
+struct RunResult {
+  std::string output;
+  // 正常退出且退出码为 0
+  bool ok = false;
+  bool timedOut = false;
+};
+
+// 经 posix_spawnp 启动 args[0]，把 input 写入其标准输入，在内存中读回标准输出；
+// withStderr 时标准错误并入输出，否则丢弃。超时后杀死进程。
+// 调用方应忽略 SIGPIPE，子进程提前退出时写管道不应终止调用方。
+RunResult runProgram(const std::vector<std::string>& args,
+                     const std::string& input,
+                     std::chrono::milliseconds timeout,
+                     bool withStderr = false);
@@ -0,0 +1,59 @@
+#include "Arena.hpp"
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+
+Arena::Arena()
+    : cursor_(inline_), end_(inline_ + kInlineSize), blocks_(nullptr),
+      used_(0) {}
+
+Arena::~Arena() {
+  while (blocks_) {
+    Block* next = blocks_->next;
+    std::free(blocks_);
+    blocks_ = next;
+  }
+}
+
+void* Arena::allocate(std::size_t size, std::size_t align) {
+  auto address = reinterpret_cast<std::uintptr_t>(cursor_);
+  std::size_t padding = (align - address % align) % align;
+  if (padding + size > static_cast<std::size_t>(end_ - cursor_)) {
+    // 当前块放不下时申请新块，超大对象单独占用一块
+    grow(std::max(kBlockSize, size + align));
+    address = reinterpret_cast<std::uintptr_t>(cursor_);
+    padding = (align - address % align) % align;
+  }
+  char* result = cursor_ + padding;
+  cursor_ = result + size;
+  used_ += size;
+  return result;
+}
+
+void Arena::reserve(std::size_t size) {
+  if (size > static_cast<std::size_t>(end_ - cursor_)) {
+    grow(size);
+  }
+}
+
+void Arena::grow(std::size_t size) {
+  std::size_t capacity = size + sizeof(std::max_align_t);
+  auto* block = static_cast<Block*>(std::malloc(capacity));
+  if (!block) {
+    throw std::bad_alloc();
+  }
+  block->next = blocks_;
+  blocks_ = block;
+  cursor_ = reinterpret_cast<char*>(block) + sizeof(std::max_align_t);
+  end_ = reinterpret_cast<char*>(block) + capacity;
+}
+
+std::string_view Arena::copy(std::string_view text) {
+  auto* data = static_cast<char*>(allocate(text.size(), 1));
+  std::memcpy(data, text.data(), text.size());
+  return std::string_view(data, text.size());
+}
+
+std::size_t Arena::bytesUsed() const noexcept { return used_; }
@@ -1,79 +1,150 @@
+#include <unistd.h>
+
+#include <algorithm>
+#include <chrono>
+#include <csignal>
+#include <cstdlib>
 #include <iostream>
-#include <memory>
 #include <string>
 
-#include "Lexer.hpp"
-#include "Parser.hpp"
-#include "Program.hpp"
-#include "Token.hpp"
+#include "Loader.hpp"
+#include "Server.hpp"
+#include "Session.hpp"
 #include "utils/Error.hpp"
 
-int main() {
-  Lexer lexer;
-  Parser parser;
-  Program program;
+namespace {
+
+Server* server = nullptr;
+
+void stopServer(int) { server->stop(); }
+
+// 服务端模式：在 path 上监听，直到收到 SIGINT 或 SIGTERM
+int serve(Server::Options& options) {
+  try {
+    Server instance(options);
+    server = &instance;
+    std::signal(SIGINT, stopServer);
+    std::signal(SIGTERM, stopServer);
+    instance.run();
+    Server::Stats stats = instance.stats();
+    std::signal(SIGINT, SIG_DFL);
+    std::signal(SIGTERM, SIG_DFL);
+    server = nullptr;
+    std::cerr << "commands: " << stats.commands
+              << ", latency p50: " << stats.p50
+              << " ms, p99: " << stats.p99 << " ms\n";
+  } catch (const BasicError& e) {
+    std::cerr << e.message() << "\n";
+    return 1;
+  }
+  return 0;
+}
 
-  std::string line;
-  while (std::getline(std::cin, line)) {
-    if (line.empty()) {
-      continue;
+}  // namespace
+
+int main(int argc, char** argv) {
+  Session::Options options;
+  Server::Options serverOptions;
+  bool showStats = false;
+  std::string loadPath;
+  std::string imagePath;
+  std::size_t loadJobs = 0;
+  // 交互使用时逐行写出，重定向到文件或管道时整块写出
+  options.lineBuffered = ::isatty(STDOUT_FILENO) != 0;
+
+  // 命令行参数：
+  //   --engine=tree 使用逐行解释，便于与字节码执行对照
+  //   --no-fold     关闭常量折叠，便于调试
+  //   --stats       退出时在 stderr 输出优化统计，每次 RUN 后输出超级指令统计
+  //   --load <file> 先批量载入文件中的程序行，再从标准输入读取命令
+  //   --jobs=N      批量载入时的解析线程数，默认使用全部硬件线程
+  //   --load-image <file> 先载入 SAVE IMAGE 保存的程序映像
+  //   --line-buffered PRINT 每输出一行就写出
+  //   --profile     RUN 时逐行统计执行次数与耗时，由 PROFILE 命令输出
+  //   --profile=<file> 同上，PROFILE 时另以 flamegraph 折叠栈格式写入文件
+  //   --no-jit      不把热点区域编译为机器码，只用字节码 VM 执行
+  //   --jit-threshold=N 区域入口执行 N 次后编译，1 表示首次到达即编译
+  //   --max-jumps=N RUN 执行 N 次向后跳转时以 JUMP LIMIT EXCEEDED 结束
+  //   --time-limit=MS RUN 执行 MS 毫秒时以 TIME LIMIT EXCEEDED 结束
+  //   --serve=<path> 在 Unix 域套接字上服务多个会话，不读标准输入
+  //                  会话中的 SAVE IMAGE、LOAD IMAGE 报错，PROFILE 不写文件
+  //   --workers=N   服务端执行命令的线程数，默认使用全部硬件线程
+  //   --slice=N     服务端 RUN 每执行 N 次向后跳转让出一次线程
+  for (int i = 1; i < argc; ++i) {
+    std::string arg = argv[i];
+    if (arg == "--engine=tree") {
+      options.engine = Program::Engine::TREE;
+    } else if (arg == "--engine=bytecode") {
+      options.engine = Program::Engine::BYTECODE;
+    } else if (arg == "--no-fold") {
+      options.fold = false;
+    } else if (arg == "--stats") {
+      showStats = true;
+      options.stats = &std::cerr;
+    } else if (arg == "--load" && i + 1 < argc) {
+      loadPath = argv[++i];
+    } else if (arg == "--load-image" && i + 1 < argc) {
+      imagePath = argv[++i];
+    } else if (arg == "--line-buffered") {
+      options.lineBuffered = true;
+    } else if (arg == "--profile") {
+      options.profile = true;
+    } else if (arg.rfind("--profile=", 0) == 0) {
+      options.profilePath = arg.substr(10);
+    } else if (arg == "--no-jit") {
+      options.jitThreshold = 0;
+    } else if (arg.rfind("--jit-threshold=", 0) == 0) {
+      options.jitThreshold = std::max(std::atoi(arg.c_str() + 16), 0);
+    } else if (arg.rfind("--jobs=", 0) == 0) {
+      loadJobs = std::strtoul(arg.c_str() + 7, nullptr, 10);
+    } else if (arg.rfind("--max-jumps=", 0) == 0) {
+      options.maxJumps = std::strtoull(arg.c_str() + 12, nullptr, 10);
+    } else if (arg.rfind("--time-limit=", 0) == 0) {
+      options.timeLimit = std::chrono::milliseconds(
+          std::strtoull(arg.c_str() + 13, nullptr, 10));
+    } else if (arg.rfind("--serve=", 0) == 0) {
+      serverOptions.path = arg.substr(8);
+    } else if (arg.rfind("--workers=", 0) == 0) {
+      serverOptions.workers = std::strtoul(arg.c_str() + 10, nullptr, 10);
+    } else if (arg.rfind("--slice=", 0) == 0) {
+      serverOptions.slice =
+          std::max<std::uint64_t>(std::strtoull(arg.c_str() + 8, nullptr, 10), 1);
     }
-    try {
-      // TODO: The main function.
-      // 处理命令行
-      if (line == "LIST") {
-        program.list();
-        continue;
-      }
-      else if (line == "RUN") {
-        program.run();
-        continue;
-      }
-      else if (line == "CLEAR") {
-        program.clear();
-        continue;
-      }
-      else if (line == "QUIT") {
-        return 0;
-      }
+  }
 
-      // 处理立即执行语句
-      std::string tmp = line.substr(0, 3);
-      if (tmp == "LET" || tmp == "PRI" || tmp == "INP") {
-        TokenStream tokens = lexer.tokenize(line);
-        if (tokens.empty()) {
-          throw BasicError("SYNTAX ERROR");
-        }
-        std::unique_ptr<ParsedLine> parsedLine = parser.parseLine(tokens, line);
-        std::unique_ptr<Statement> stmt = parsedLine->fetchStatement();
-        program.execute(stmt.get());
-        continue;
-      }
+  if (!serverOptions.path.empty()) {
+    serverOptions.session = options;
+    return serve(serverOptions);
+  }
 
-      // 处理程序行
-      // 1.词法分析
-      TokenStream tokens = lexer.tokenize(line);
-      if (tokens.empty()) {
-        throw BasicError("SYNTAX ERROR");
-      }
-      // 2.语法分析
-      std::unique_ptr<ParsedLine> parsedLine = parser.parseLine(tokens, line);
-      // 3.解释执行
-      if (parsedLine->getLine().has_value()) {
-        int lineNum = parsedLine->getLine().value();
-        std::unique_ptr<Statement> stmt = parsedLine->fetchStatement();
-        if (stmt) {
-          program.addStmt(lineNum, stmt.release()); // release() 转移所有权给 Program
-        } else {
-          program.removeStmt(lineNum);
-        }
+  // 所有输出都经由 std::cout，无需与 C stdio 同步
+  std::ios::sync_with_stdio(false);
+  Session session(options, std::cout, STDIN_FILENO);
+  Program& program = session.program();
+
+  if (!loadPath.empty() || !imagePath.empty()) {
+    try {
+      if (!imagePath.empty()) {
+        program.loadImage(imagePath);
       }
-      else {
-        throw BasicError("SYNTAX ERROR");
+      if (!loadPath.empty()) {
+        Loader loader(session.lexer(), session.parser(), session.optimizer());
+        loader.setJobs(loadJobs);
+        loader.loadFile(loadPath, program);
       }
     } catch (const BasicError& e) {
-      std::cout << e.message() << "\n";
+      std::cerr << e.message() << "\n";
+      return 1;
     }
   }
+
+  // 标准输入会阻塞等待，RUN 一次执行到结束
+  Session::Step step;
+  do {
+    step = session.step(VM::kUnlimited);
+  } while (step != Session::Step::QUIT && step != Session::Step::END);
+  if (showStats) {
+    std::cerr << "folded nodes: " << session.optimizer().removedNodes() << "\n";
+  }
   return 0;
-}
\ No newline at end of file
+}
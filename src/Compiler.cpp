@@ -0,0 +1,904 @@
+#include "Compiler.hpp"
+
+#include <algorithm>
+#include <climits>
+#include <unordered_map>
+#include <utility>
+
+#include "Recorder.hpp"
+#include "Statement.hpp"
+
+namespace {
+
+// Recorder 中第一个行号不小于 line 的行的下标
+int lowerIndex(const Recorder& recorder, int line) {
+  int lo = 0;
+  int hi = recorder.size();
+  while (lo < hi) {
+    int mid = lo + (hi - lo) / 2;
+    if (recorder.lineAt(mid) < line) {
+      lo = mid + 1;
+    } else {
+      hi = mid;
+    }
+  }
+  return lo;
+}
+
+// Recorder 中第一个行号大于 line 的行的下标
+int upperIndex(const Recorder& recorder, int line) {
+  int lo = 0;
+  int hi = recorder.size();
+  while (lo < hi) {
+    int mid = lo + (hi - lo) / 2;
+    if (recorder.lineAt(mid) <= line) {
+      lo = mid + 1;
+    } else {
+      hi = mid;
+    }
+  }
+  return lo;
+}
+
+template <class Line>
+int lowerIndex(const std::vector<Line>& lines, int line) {
+  return static_cast<int>(
+      std::lower_bound(lines.begin(), lines.end(), line,
+                       [](const Line& l, int n) { return l.number < n; }) -
+      lines.begin());
+}
+
+template <class Line>
+int upperIndex(const std::vector<Line>& lines, int line) {
+  return static_cast<int>(
+      std::upper_bound(lines.begin(), lines.end(), line,
+                       [](int n, const Line& l) { return n < l.number; }) -
+      lines.begin());
+}
+
+// 按起点排序并合并相交的区间
+template <class Range>
+void mergeRanges(std::vector<Range>& ranges) {
+  std::sort(ranges.begin(), ranges.end(),
+            [](const Range& a, const Range& b) { return a.lo < b.lo; });
+  std::size_t merged = 0;
+  for (std::size_t i = 1; i < ranges.size(); ++i) {
+    if (ranges[i].lo <= ranges[merged].hi) {
+      ranges[merged].hi = std::max(ranges[merged].hi, ranges[i].hi);
+    } else {
+      ranges[++merged] = ranges[i];
+    }
+  }
+  if (!ranges.empty()) {
+    ranges.resize(merged + 1);
+  }
+}
+
+// 以 [begin, end) 替换 v 的 [first, last)，其后的元素至多移动一次
+template <class T, class It>
+void splice(std::vector<T>& v, int first, int last, It begin, It end) {
+  int count = static_cast<int>(end - begin);
+  int removed = last - first;
+  if (count > removed) {
+    v.insert(v.begin() + last, begin + removed, end);
+  } else if (count < removed) {
+    v.erase(v.begin() + first + count, v.begin() + last);
+  }
+  std::copy(begin, begin + std::min(count, removed), v.begin() + first);
+}
+
+bool isBranch(OpCode op) {
+  return op == OpCode::JUMP_EQ || op == OpCode::JUMP_GT ||
+         op == OpCode::JUMP_LT;
+}
+
+// 把 JUMP_EQ/GT/LT 换成 base 系列中对应的超级指令
+OpCode branchOf(OpCode base, OpCode jump) {
+  int offset = jump == OpCode::JUMP_EQ ? 0 : jump == OpCode::JUMP_GT ? 1 : 2;
+  return static_cast<OpCode>(static_cast<int>(base) + offset);
+}
+
+// 交换比较两边：k < x 即 x > k
+OpCode mirror(OpCode jump) {
+  if (jump == OpCode::JUMP_GT) {
+    return OpCode::JUMP_LT;
+  }
+  if (jump == OpCode::JUMP_LT) {
+    return OpCode::JUMP_GT;
+  }
+  return jump;
+}
+
+// x = x + k、x = k + x 或 x = x - k 的四条指令
+bool matchIncrement(const Instruction* e, int& slot, int& step) {
+  if (e[3].op != OpCode::STORE) {
+    return false;
+  }
+  slot = e[3].operand;
+  if (e[0].op == OpCode::LOAD && e[0].operand == slot &&
+      e[1].op == OpCode::PUSH) {
+    if (e[2].op == OpCode::ADD) {
+      step = e[1].operand;
+      return true;
+    }
+    if (e[2].op == OpCode::SUB && e[1].operand != INT_MIN) {
+      step = -e[1].operand;
+      return true;
+    }
+  }
+  if (e[0].op == OpCode::PUSH && e[1].op == OpCode::LOAD &&
+      e[1].operand == slot && e[2].op == OpCode::ADD) {
+    step = e[0].operand;
+    return true;
+  }
+  return false;
+}
+
+// x op k 或 k op x 后条件跳转的三条指令，统一为 "x op k"
+bool matchCompare(const Instruction* e, int& slot, int& constant,
+                  OpCode& jump) {
+  if (!isBranch(e[2].op)) {
+    return false;
+  }
+  if (e[0].op == OpCode::LOAD && e[1].op == OpCode::PUSH) {
+    slot = e[0].operand;
+    constant = e[1].operand;
+    jump = e[2].op;
+    return true;
+  }
+  if (e[0].op == OpCode::PUSH && e[1].op == OpCode::LOAD) {
+    slot = e[1].operand;
+    constant = e[0].operand;
+    jump = mirror(e[2].op);
+    return true;
+  }
+  return false;
+}
+
+bool isSimple(OpCode op) {
+  switch (op) {
+    case OpCode::PUSH:
+    case OpCode::LOAD:
+    case OpCode::ADD:
+    case OpCode::SUB:
+    case OpCode::MUL:
+    case OpCode::DIV:
+    case OpCode::STORE:
+    case OpCode::PRINT:
+      return true;
+    default:
+      return false;
+  }
+}
+
+}  // namespace
+
+const Bytecode& Compiler::compile(const Recorder& recorder) {
+  std::vector<int> dirty = recorder.dirtyLines();
+  std::sort(dirty.begin(), dirty.end());
+  dirty.erase(std::unique(dirty.begin(), dirty.end()), dirty.end());
+  // 被丢弃的指令、超级指令与计数循环仍留在表中，堆积过多时整体重编回收
+  int size = static_cast<int>(code_.code.size());
+  bool stale =
+      garbage_ > size - garbage_ + 4096 ||
+      static_cast<int>(code_.fused.size()) > 2 * liveFused_ + 1024 ||
+      static_cast<int>(code_.loops.size()) > 2 * liveLoops_ + 1024;
+  // 改动的行较多时逐段拼接不比整体重编省事
+  if (!compiled_ || recorder.allDirty() || stale ||
+      dirty.size() * 4 > lines_.size()) {
+    rebuild(recorder);
+    code_.revision = ++revision_;
+  } else if (!dirty.empty()) {
+    update(recorder, dirty);
+    code_.revision = ++revision_;
+  } else {
+    recompiled_ = 0;
+  }
+  compiled_ = true;
+  return code_;
+}
+
+int Compiler::recompiledLines() const noexcept { return recompiled_; }
+
+int Compiler::fusedInstructions() const noexcept { return liveFused_; }
+
+void Compiler::setSuperinstructions(bool enabled) noexcept {
+  if (enabled != superinstructions_) {
+    superinstructions_ = enabled;
+    compiled_ = false;
+  }
+}
+
+void Compiler::rebuild(const Recorder& recorder) {
+  code_ = Bytecode();
+  // 跳转目标不存在时，在执行到该跳转时才报错
+  code_.code.push_back(
+      Instruction{OpCode::FAIL, static_cast<int>(FailCode::SYNTAX_ERROR)});
+  code_.code.push_back(
+      Instruction{OpCode::FAIL, static_cast<int>(FailCode::LINE_NUMBER_ERROR)});
+  code_.entry = static_cast<int>(code_.code.size());
+  code_.labels = {kSyntaxStub, kSyntaxStub};
+  labelOf_.clear();
+  labelLine_ = {0, INT_MAX};
+  labelRefs_ = {0, 0};
+  created_.clear();
+  loopSpans_.clear();
+  liveFused_ = 0;
+  liveLoops_ = 0;
+  garbage_ = 0;
+
+  int size = recorder.size();
+  compileLines(recorder, 0, size);
+  for (const Line& line : fragment_.lines) {
+    if (line.jump >= 0) {
+      ++labelRefs_[line.jump];
+    }
+  }
+  lower(recorder, size);
+  lines_ = fragment_.lines;
+
+  int base = code_.entry;
+  code_.code.insert(code_.code.end(), fragment_.code.begin(),
+                    fragment_.code.end());
+  code_.lineStarts.resize(size);
+  ends_.resize(size);
+  for (int index = 0; index < size; ++index) {
+    code_.lineStarts[index] = fragment_.starts[index] + base;
+    ends_[index] = fragment_.starts[index + 1] + base;
+  }
+  code_.code.push_back(Instruction{OpCode::HALT, 0});
+  refreshLabels();
+  recompiled_ = size;
+}
+
+void Compiler::update(const Recorder& recorder, const std::vector<int>& dirty) {
+  int size = recorder.size();
+  // 改动行与其前后相邻的行：跳到本行、计数循环的出口与超级指令都依赖下一行
+  std::vector<Range> ranges;
+  for (int line : dirty) {
+    int before = lowerIndex(recorder, line);
+    int after = upperIndex(recorder, line);
+    ranges.push_back(Range{before > 0 ? recorder.lineAt(before - 1) : line,
+                           after < size ? recorder.lineAt(after) : line});
+  }
+  mergeRanges(ranges);
+
+  // 成为或不再是跳转目标的行首可能改变超级指令的边界
+  for (int label : replaceLines(recorder, ranges)) {
+    int line = labelLine_[label];
+    int index = lowerIndex(lines_, line);
+    if (index < static_cast<int>(lines_.size()) &&
+        lines_[index].number == line) {
+      ranges.push_back(Range{index > 0 ? lines_[index - 1].number : line, line});
+    }
+  }
+  for (int line : dirty) {
+    addLoopAround(line, ranges);
+  }
+  for (bool changed = true; changed;) {
+    mergeRanges(ranges);
+    changed = false;
+    for (Range& range : ranges) {
+      changed = widen(range) || changed;
+    }
+  }
+  regenerate(recorder, ranges);
+}
+
+std::vector<int> Compiler::replaceLines(const Recorder& recorder,
+                                        const std::vector<Range>& ranges) {
+  // 引用计数改动前各标签是否为跳转目标
+  std::vector<std::pair<int, bool>> touched;
+  auto retarget = [&](int label, int delta) {
+    touched.emplace_back(label, labelRefs_[label] > 0);
+    labelRefs_[label] += delta;
+  };
+
+  // 从后往前替换，前面区间的下标不受影响
+  std::vector<int> unplaced;
+  for (auto range = ranges.rbegin(); range != ranges.rend(); ++range) {
+    int first = lowerIndex(lines_, range->lo);
+    int last = upperIndex(lines_, range->hi);
+    for (int index = first; index < last; ++index) {
+      const Line& line = lines_[index];
+      if (line.jump >= 0) {
+        retarget(line.jump, -1);
+      }
+      // 被删除的行不再有指令，标签先指向 LINE NUMBER ERROR
+      if (line.label >= 0) {
+        code_.labels[line.label] = kLineStub;
+      }
+      discard(index);
+    }
+    compileLines(recorder, lowerIndex(recorder, range->lo),
+                 upperIndex(recorder, range->hi));
+    for (const Line& line : fragment_.lines) {
+      if (line.jump >= 0) {
+        retarget(line.jump, 1);
+      }
+    }
+    unplaced.assign(fragment_.lines.size(), -1);
+    splice(lines_, first, last, fragment_.lines.begin(),
+           fragment_.lines.end());
+    splice(code_.lineStarts, first, last, unplaced.begin(), unplaced.end());
+    splice(ends_, first, last, unplaced.begin(), unplaced.end());
+  }
+  registerLabels();
+
+  std::stable_sort(touched.begin(), touched.end(),
+                   [](const std::pair<int, bool>& a,
+                      const std::pair<int, bool>& b) {
+                     return a.first < b.first;
+                   });
+  std::vector<int> flipped;
+  for (std::size_t i = 0; i < touched.size();) {
+    std::size_t j = i;
+    while (j < touched.size() && touched[j].first == touched[i].first) {
+      ++j;
+    }
+    int label = touched[i].first;
+    if ((labelRefs_[label] > 0) != touched[i].second) {
+      flipped.push_back(label);
+    }
+    i = j;
+  }
+  return flipped;
+}
+
+bool Compiler::widen(Range& range) const {
+  Range before = range;
+  // 与区间相交的计数循环整个重新生成；各循环互不重叠，按回跳行排序
+  for (auto it = loopSpans_.lower_bound(range.lo);
+       it != loopSpans_.end() && it->second <= range.hi; ++it) {
+    range.lo = std::min(range.lo, it->second);
+    range.hi = std::max(range.hi, it->first);
+  }
+
+  // 区间内的回跳可能与更早的行组成新的计数循环
+  int first = lowerIndex(lines_, range.lo);
+  int last = upperIndex(lines_, range.hi);
+  for (int index = first; index < last; ++index) {
+    const Line& line = lines_[index];
+    if (line.flags & kBackEdge) {
+      int head = labelLine_[line.jump];
+      if (head < range.lo && isLoopBody(head, index)) {
+        range.lo = head;
+      }
+    }
+  }
+
+  // 超级指令不能跨过区间的两端：端点之后的行是跳转目标，
+  // 或者既不是空行也不以比较开头，才不会与端点之前的指令合并
+  auto isBoundary = [&](const Line& line) {
+    return isTarget(line) || !(line.flags & (kEmpty | kCompare));
+  };
+  int count = static_cast<int>(lines_.size());
+  int lo = lowerIndex(lines_, range.lo);
+  while (lo > 0 && lo < count && !isBoundary(lines_[lo])) {
+    --lo;
+  }
+  if (lo < count) {
+    range.lo = std::min(range.lo, lines_[lo].number);
+  }
+  int hi = upperIndex(lines_, range.hi);
+  while (hi < count && !isBoundary(lines_[hi])) {
+    ++hi;
+  }
+  if (hi > 0) {
+    range.hi = std::max(range.hi, lines_[hi - 1].number);
+  }
+  return range.lo != before.lo || range.hi != before.hi;
+}
+
+void Compiler::addLoopAround(int line, std::vector<Range>& ranges) const {
+  // 改动行之后第一个不能作循环体的行若是回跳，且回跳到改动行或更早的行，
+  // 改动可能让它成为计数循环
+  int count = static_cast<int>(lines_.size());
+  int branch = lowerIndex(lines_, line);
+  while (branch < count && (lines_[branch].flags & kSimple)) {
+    ++branch;
+  }
+  if (branch == count || !(lines_[branch].flags & kBackEdge)) {
+    return;
+  }
+  int head = labelLine_[lines_[branch].jump];
+  if (head <= line && isLoopBody(head, branch)) {
+    ranges.push_back(Range{head, lines_[branch].number});
+  }
+}
+
+bool Compiler::isLoopBody(int head, int branch) const {
+  int index = lowerIndex(lines_, head);
+  if (index == static_cast<int>(lines_.size()) ||
+      lines_[index].number != head) {
+    return false;
+  }
+  for (; index < branch; ++index) {
+    if (!(lines_[index].flags & kSimple)) {
+      return false;
+    }
+  }
+  return true;
+}
+
+void Compiler::regenerate(const Recorder& recorder,
+                          const std::vector<Range>& spans) {
+  std::vector<Instruction>& code = code_.code;
+  std::vector<int>& starts = code_.lineStarts;
+  int size = static_cast<int>(lines_.size());
+  // 之间没有其他行的区间合并，每个区间前后的行都不在区间内，指令位置已知
+  std::vector<Range> ranges;
+  for (const Range& range : spans) {
+    if (!ranges.empty() && lowerIndex(lines_, range.lo) ==
+                               upperIndex(lines_, ranges.back().hi)) {
+      ranges.back().hi = range.hi;
+    } else {
+      ranges.push_back(range);
+    }
+  }
+  // 区间之前一行之后的指令将被改写。区间内的旧行都不产生指令时，那条指令
+  // 属于区间之后的行，不能改写，改为整体重编
+  for (const Range& range : ranges) {
+    int first = lowerIndex(lines_, range.lo);
+    int last = upperIndex(lines_, range.hi);
+    if (first > 0 && last < size && ends_[first - 1] == starts[last]) {
+      rebuild(recorder);
+      return;
+    }
+  }
+
+  BytecodePatch& patch = code_.patch;
+  patch.base = code_.revision;
+  patch.appended = static_cast<int>(code.size());
+  patch.patched.clear();
+  patch.entries.clear();
+  recompiled_ = 0;
+  // 从后往前生成，区间末尾接回的下一行已有新的位置
+  for (auto range = ranges.rbegin(); range != ranges.rend(); ++range) {
+    int first = lowerIndex(lines_, range->lo);
+    int last = upperIndex(lines_, range->hi);
+    for (int index = first; index < last; ++index) {
+      discard(index);
+    }
+    loopSpans_.erase(loopSpans_.lower_bound(range->lo),
+                     loopSpans_.upper_bound(range->hi));
+
+    // lines_ 已与 Recorder 一致，两者的下标相同
+    compileLines(recorder, first, last);
+    lower(recorder, last);
+    int base = static_cast<int>(code.size());
+    for (int index = first; index < last; ++index) {
+      starts[index] = fragment_.starts[index - first] + base;
+      ends_[index] = fragment_.starts[index - first + 1] + base;
+    }
+    code.insert(code.end(), fragment_.code.begin(), fragment_.code.end());
+    // 末尾接回下一行；区间含最后一行时以新的 HALT 结束
+    int close = static_cast<int>(code.size());
+    if (last < size) {
+      code.push_back(Instruction{OpCode::SKIP, starts[last]});
+    } else {
+      code.push_back(Instruction{OpCode::HALT, 0});
+      code_.labels[kEndLabel] = close;
+    }
+    // 末尾不产生指令的行与逐次编译时一样，与下一行共用首条指令
+    int next = last < size ? starts[last] : close;
+    for (int index = last - 1;
+         index >= first && starts[index] == close && ends_[index] == close;
+         --index) {
+      starts[index] = next;
+      ends_[index] = next;
+    }
+
+    // 前一行之后的指令改为跳到新指令；与它共用位置的空行一并指向新指令
+    int enter = first > 0 ? ends_[first - 1] : -1;
+    if (enter >= 0) {
+      code[enter] = Instruction{OpCode::SKIP, base};
+      patch.patched.push_back(enter);
+    }
+    int touched = first;
+    while (touched > 0 && starts[touched - 1] == enter &&
+           ends_[touched - 1] == enter) {
+      --touched;
+      starts[touched] = base;
+      ends_[touched] = base;
+    }
+    if (first == 0 || code_.entry == enter) {
+      code_.entry = base;
+    }
+    refreshLabels(touched, last);
+
+    patch.entries.push_back(base);
+    for (int index = first; index < last; ++index) {
+      if (isTarget(lines_[index])) {
+        patch.entries.push_back(starts[index]);
+      }
+    }
+    recompiled_ += last - first;
+  }
+  registerLabels();
+}
+
+void Compiler::discard(int index) {
+  int start = code_.lineStarts[index];
+  if (start < 0) {
+    return;
+  }
+  // 丢弃的指令中的超级指令与计数循环不再使用
+  const std::vector<Instruction>& code = code_.code;
+  for (int i = start; i < ends_[index]; ++i) {
+    if (code[i].op == OpCode::LOOP) {
+      --liveLoops_;
+    } else if (code[i].op >= OpCode::INC) {
+      --liveFused_;
+    }
+  }
+  garbage_ += ends_[index] - start;
+  code_.lineStarts[index] = -1;
+}
+
+void Compiler::compileLines(const Recorder& recorder, int first, int last) {
+  Fragment& fragment = fragment_;
+  fragment.code.clear();
+  fragment.starts.clear();
+  fragment.lines.clear();
+  int size = recorder.size();
+  for (int index = first; index < last; ++index) {
+    int number = recorder.lineAt(index);
+    currentLine_ = number;
+    nextLine_ = index + 1 < size ? recorder.lineAt(index + 1) : 0;
+    currentJump_ = -1;
+    depth_ = 0;
+    int begin = static_cast<int>(fragment.code.size());
+    fragment.starts.push_back(begin);
+    recorder.stmtAt(index)->compile(*this);
+
+    const Instruction* e = fragment.code.data() + begin;
+    int length = static_cast<int>(fragment.code.size()) - begin;
+    std::uint8_t flags = length == 0 ? kEmpty : 0;
+    if (std::all_of(e, e + length,
+                    [](const Instruction& ins) { return isSimple(ins.op); })) {
+      flags |= kSimple;
+    }
+    if (length == 3) {
+      int slot;
+      int constant;
+      OpCode jump;
+      if (matchCompare(e, slot, constant, jump)) {
+        flags |= kCompare;
+      }
+      // 回跳只能是 "IF a op b THEN" 一行：两条压栈指令加一条条件跳转
+      if ((e[2].op == OpCode::JUMP_LT || e[2].op == OpCode::JUMP_GT) &&
+          currentJump_ > kEndLabel && labelLine_[currentJump_] < number) {
+        flags |= kBackEdge;
+      }
+    }
+    fragment.lines.push_back(Line{number, -1, currentJump_, flags});
+  }
+  fragment.starts.push_back(static_cast<int>(fragment.code.size()));
+  for (Line& line : fragment.lines) {
+    auto it = labelOf_.find(line.number);
+    if (it != labelOf_.end()) {
+      line.label = it->second;
+    }
+  }
+}
+
+void Compiler::lower(const Recorder& recorder, int last) {
+  Fragment& fragment = fragment_;
+  int count = static_cast<int>(fragment.lines.size());
+  // 循环首行的首条指令与循环在 code_.loops 中的下标
+  std::vector<std::pair<int, int>> heads;
+  for (int index = 0; index < count; ++index) {
+    const Line& line = fragment.lines[index];
+    if (!(line.flags & kBackEdge)) {
+      continue;
+    }
+    int head = labelLine_[line.jump];
+    int first = lowerIndex(fragment.lines, head);
+    if (first == count || fragment.lines[first].number != head) {
+      continue;
+    }
+    CountedLoop loop;
+    if (!matchLoop(fragment.starts[first], fragment.starts[index], loop)) {
+      continue;
+    }
+    // 循环结束后继续执行回跳所在行的下一行
+    int next = index + 1 < count ? fragment.lines[index + 1].number
+               : last < recorder.size() ? recorder.lineAt(last)
+                                         : 0;
+    loop.exit = next > 0 ? labelFor(next) : kEndLabel;
+    heads.emplace_back(fragment.starts[first],
+                       static_cast<int>(code_.loops.size()));
+    code_.loops.push_back(std::move(loop));
+    loopSpans_[line.number] = head;
+    ++liveLoops_;
+  }
+
+  if (!heads.empty()) {
+    // 在每个循环首行之前插入 LOOP，原指令整体后移；跳到首行的指令落在 LOOP 上。
+    // 循环体内没有跳转，两个循环不会重叠，heads 已按位置递增。
+    const std::vector<Instruction>& code = fragment.code;
+    std::vector<int> moved(code.size() + 1);
+    std::vector<Instruction> result;
+    result.reserve(code.size() + heads.size());
+    std::size_t next = 0;
+    for (std::size_t i = 0; i < code.size(); ++i) {
+      moved[i] = static_cast<int>(result.size());
+      if (next < heads.size() && heads[next].first == static_cast<int>(i)) {
+        result.push_back(Instruction{OpCode::LOOP, heads[next].second});
+        ++next;
+      }
+      result.push_back(code[i]);
+    }
+    moved[code.size()] = static_cast<int>(result.size());
+    relocate(std::move(result), moved);
+  }
+  if (superinstructions_) {
+    fuseInstructions();
+  }
+}
+
+void Compiler::relocate(std::vector<Instruction> code,
+                        const std::vector<int>& moved) {
+  // 跳转与循环出口都是标签，只需改写各行首条指令的位置
+  for (int& start : fragment_.starts) {
+    start = moved[start];
+  }
+  fragment_.code = std::move(code);
+}
+
+void Compiler::fuseInstructions() {
+  const std::vector<Instruction>& code = fragment_.code;
+  int size = static_cast<int>(code.size());
+  // 跳转目标把程序切成基本块，合并的指令序列不能跨过目标。
+  // 循环出口总在回跳所在行之后，不会落在合并的序列中间。
+  std::vector<bool> target(size + 1, false);
+  for (std::size_t index = 0; index < fragment_.lines.size(); ++index) {
+    if (isTarget(fragment_.lines[index])) {
+      target[fragment_.starts[index]] = true;
+    }
+  }
+  auto inBlock = [&](int begin, int length) {
+    if (begin + length > size) {
+      return false;
+    }
+    for (int i = begin + 1; i < begin + length; ++i) {
+      if (target[i]) {
+        return false;
+      }
+    }
+    return true;
+  };
+
+  std::vector<int> moved(size + 1);
+  std::vector<Instruction> result;
+  result.reserve(size);
+  for (int i = 0; i < size;) {
+    const Instruction* e = &code[i];
+    int length = 1;
+    Instruction fused = *e;
+    FusedOperands operands{0, 0, 0, 0};
+    int slot;
+    int step;
+    int compared;
+    OpCode jump;
+    if (inBlock(i, 4) && matchIncrement(e, slot, step)) {
+      // LET x = x + k 之后紧接 IF x op k THEN
+      if (inBlock(i, 7) && matchCompare(e + 4, compared, operands.constant,
+                                        jump) &&
+          compared == slot) {
+        fused.op = branchOf(OpCode::INC_BRANCH_EQ, jump);
+        operands.target = e[6].operand;
+        length = 7;
+      } else {
+        fused.op = OpCode::INC;
+        length = 4;
+      }
+      operands.slot = slot;
+      operands.step = step;
+    } else if (e->op == OpCode::STORE && inBlock(i, 4) &&
+               matchCompare(e + 1, compared, operands.constant, jump) &&
+               compared == e->operand) {
+      // LET x = ... 之后紧接 IF x op k THEN
+      fused.op = branchOf(OpCode::STORE_BRANCH_EQ, jump);
+      operands.slot = e->operand;
+      operands.target = e[3].operand;
+      length = 4;
+    } else if (inBlock(i, 3) &&
+               matchCompare(e, operands.slot, operands.constant, jump)) {
+      fused.op = branchOf(OpCode::BRANCH_EQ, jump);
+      operands.target = e[2].operand;
+      length = 3;
+    }
+    if (length > 1) {
+      fused.backward = e[length - 1].backward;
+      fused.operand = static_cast<int>(code_.fused.size());
+      code_.fused.push_back(operands);
+      ++liveFused_;
+    }
+    for (int k = 0; k < length; ++k) {
+      moved[i + k] = static_cast<int>(result.size());
+    }
+    result.push_back(fused);
+    i += length;
+  }
+  moved[size] = static_cast<int>(result.size());
+  relocate(std::move(result), moved);
+}
+
+bool Compiler::matchLoop(int head, int branch, CountedLoop& loop) const {
+  const std::vector<Instruction>& code = fragment_.code;
+  for (int i = head; i < branch; ++i) {
+    // INPUT、跳转与 END 都不在快速路径内处理
+    if (!isSimple(code[i].op)) {
+      return false;
+    }
+  }
+
+  // 计数器与上界：回跳条件统一成 "计数器 < 上界"（JUMP_LT）或 "> 上界"
+  const Instruction& lhs = code[branch];
+  const Instruction& rhs = code[branch + 1];
+  bool below = code[branch + 2].op == OpCode::JUMP_LT;
+  auto storesTo = [&](int slot) {
+    int stores = 0;
+    int at = -1;
+    for (int i = head; i < branch; ++i) {
+      if (code[i].op == OpCode::STORE && code[i].operand == slot) {
+        ++stores;
+        at = i;
+      }
+    }
+    return stores == 1 ? at : (stores == 0 ? -1 : -2);
+  };
+  // 计数器唯一的赋值必须恰好是 i + c、c + i 或 i - c
+  auto stepOf = [&](int slot, int& step) {
+    int at = storesTo(slot);
+    if (at - 3 < head) {
+      return false;
+    }
+    int stored;
+    return matchIncrement(&code[at - 3], stored, step);
+  };
+
+  const Instruction* counter = nullptr;
+  const Instruction* limit = nullptr;
+  int step = 0;
+  if (lhs.op == OpCode::LOAD && stepOf(lhs.operand, step)) {
+    counter = &lhs;
+    limit = &rhs;
+  } else if (rhs.op == OpCode::LOAD && stepOf(rhs.operand, step)) {
+    // n > i 即 i < n
+    counter = &rhs;
+    limit = &lhs;
+    below = !below;
+  } else {
+    return false;
+  }
+  // 步长方向与比较方向不一致时循环依赖溢出回绕才能结束，不做特化
+  if (step == 0 || (step > 0) != below) {
+    return false;
+  }
+  if (limit->op == OpCode::LOAD && storesTo(limit->operand) != -1) {
+    return false;
+  }
+
+  // 为循环中出现的每个变量分配寄存器
+  std::unordered_map<int, int> registers;
+  auto registerOf = [&](int slot) {
+    auto [it, inserted] =
+        registers.emplace(slot, static_cast<int>(loop.slots.size()));
+    if (inserted) {
+      loop.slots.push_back(slot);
+    }
+    return it->second;
+  };
+  int depth = 0;
+  loop.maxStack = 0;
+  for (int i = head; i < branch; ++i) {
+    Instruction ins = code[i];
+    if (ins.op == OpCode::LOAD || ins.op == OpCode::STORE) {
+      ins.operand = registerOf(ins.operand);
+    }
+    depth += (ins.op == OpCode::PUSH || ins.op == OpCode::LOAD) ? 1 : -1;
+    loop.maxStack = std::max(loop.maxStack, depth);
+    loop.body.push_back(ins);
+  }
+  loop.body.push_back(Instruction{OpCode::HALT, 0});
+  loop.counter = registerOf(counter->operand);
+  loop.step = step;
+  loop.limitIsRegister = limit->op == OpCode::LOAD;
+  loop.limit = loop.limitIsRegister ? registerOf(limit->operand)
+                                    : limit->operand;
+  return true;
+}
+
+int Compiler::labelFor(int line) {
+  auto [it, inserted] =
+      labelOf_.emplace(line, static_cast<int>(labelLine_.size()));
+  if (inserted) {
+    labelLine_.push_back(line);
+    labelRefs_.push_back(0);
+    code_.labels.push_back(kLineStub);
+    created_.push_back(it->second);
+  }
+  return it->second;
+}
+
+bool Compiler::isTarget(const Line& line) const {
+  return line.label >= 0 && labelRefs_[line.label] > 0;
+}
+
+void Compiler::registerLabels() {
+  for (int label : created_) {
+    int index = lowerIndex(lines_, labelLine_[label]);
+    if (index < static_cast<int>(lines_.size()) &&
+        lines_[index].number == labelLine_[label]) {
+      lines_[index].label = label;
+      // 尚未生成指令的行由 regenerate 更新标签
+      if (code_.lineStarts[index] >= 0) {
+        code_.labels[label] = code_.lineStarts[index];
+      }
+    }
+  }
+  created_.clear();
+}
+
+void Compiler::refreshLabels() {
+  registerLabels();
+  code_.labels[kEndLabel] = static_cast<int>(code_.code.size()) - 1;
+  refreshLabels(0, static_cast<int>(lines_.size()));
+}
+
+void Compiler::refreshLabels(int first, int last) {
+  for (int index = first; index < last; ++index) {
+    if (lines_[index].label >= 0) {
+      code_.labels[lines_[index].label] = code_.lineStarts[index];
+    }
+  }
+}
+
+void Compiler::emit(OpCode op, int operand) {
+  fragment_.code.push_back(Instruction{op, operand});
+  trackStack(op);
+}
+
+void Compiler::emitJump(OpCode op, int line) {
+  int label;
+  if (line <= 0) {
+    label = kSyntaxLabel;
+  } else if (line == currentLine_) {
+    // 跳到本行等价于顺序执行下一行，与逐行解释时的行为一致
+    label = nextLine_ > 0 ? labelFor(nextLine_) : kEndLabel;
+  } else {
+    label = labelFor(line);
+  }
+  // 与逐行解释一致：跳到不晚于本行的行才计入跳转预算
+  fragment_.code.push_back(Instruction{op, label, line < currentLine_});
+  trackStack(op);
+  currentJump_ = label;
+}
+
+void Compiler::trackStack(OpCode op) {
+  switch (op) {
+    case OpCode::PUSH:
+    case OpCode::LOAD:
+      ++depth_;
+      break;
+    case OpCode::ADD:
+    case OpCode::SUB:
+    case OpCode::MUL:
+    case OpCode::DIV:
+    case OpCode::STORE:
+    case OpCode::PRINT:
+      --depth_;
+      break;
+    case OpCode::JUMP_EQ:
+    case OpCode::JUMP_GT:
+    case OpCode::JUMP_LT:
+      depth_ -= 2;
+      break;
+    default:
+      break;
+  }
+  code_.maxStack = std::max(code_.maxStack, depth_);
+}
@@ -1,22 +1,65 @@
 #include "Expression.hpp"
 
+#include <algorithm>
+#include <iterator>
+#include <limits>
+#include <utility>
+
+#include "Arena.hpp"
+#include "Compiler.hpp"
+#include "Optimizer.hpp"
 #include "VarState.hpp"
 #include "utils/Error.hpp"
 
+Expression* Expression::fold(Optimizer&) { return nullptr; }
+
+std::optional<int> Expression::constant() const { return std::nullopt; }
+
+CompoundExpression* Expression::asCompound() noexcept { return nullptr; }
+
+void Expression::remapSlots(const std::vector<int>&) {}
+
 ConstExpression::ConstExpression(int value) : value_(value) {}
 
 int ConstExpression::evaluate(const VarState&) const { return value_; }
 
-VariableExpression::VariableExpression(std::string name)
-    : name_(std::move(name)) {}
+void ConstExpression::compile(Compiler& compiler) const {
+  compiler.emit(OpCode::PUSH, value_);
+}
+
+std::optional<int> ConstExpression::constant() const { return value_; }
+
+bool ConstExpression::decompose(const Expression*&, const Expression*&,
+                                Instruction&,
+                                std::vector<Instruction>& out) const {
+  out.push_back(Instruction{OpCode::PUSH, value_});
+  return false;
+}
+
+VariableExpression::VariableExpression(int slot) : slot_(slot) {}
 
 int VariableExpression::evaluate(const VarState& state) const {
-  return state.getValue(name_);
+  return state.getValue(slot_);
 }
 
-CompoundExpression::CompoundExpression(std::unique_ptr<Expression> left, char op,
-                                       std::unique_ptr<Expression> right)
-    : left_(std::move(left)), right_(std::move(right)), op_(op) {}
+void VariableExpression::compile(Compiler& compiler) const {
+  compiler.emit(OpCode::LOAD, slot_);
+}
+
+void VariableExpression::remapSlots(const std::vector<int>& slots) {
+  slot_ = slots[slot_];
+}
+
+bool VariableExpression::decompose(const Expression*&, const Expression*&,
+                                   Instruction&,
+                                   std::vector<Instruction>& out) const {
+  out.push_back(Instruction{OpCode::LOAD, slot_});
+  return false;
+}
+
+CompoundExpression::CompoundExpression(Expression* left, char op,
+                                       Expression* right)
+    : left_(left), right_(right), op_(op) {}
 
 CompoundExpression::~CompoundExpression() {
 }
@@ -36,8 +79,268 @@ int CompoundExpression::evaluate(const VarState& state) const {
       if (rhs == 0) {
         throw BasicError("DIVIDE BY ZERO");
       }
+      // 商不能表示，直接相除在 x86 上会触发 SIGFPE
+      if (rhs == -1 && lhs == std::numeric_limits<int>::min()) {
+        throw BasicError("INTEGER OVERFLOW");
+      }
       return lhs / rhs;
     default:
       throw BasicError("UNSUPPORTED OPERATOR");
   }
 }
+
+void CompoundExpression::compile(Compiler& compiler) const {
+  left_->compile(compiler);
+  right_->compile(compiler);
+
+  switch (op_) {
+    case '+':
+      compiler.emit(OpCode::ADD);
+      break;
+    case '-':
+      compiler.emit(OpCode::SUB);
+      break;
+    case '*':
+      compiler.emit(OpCode::MUL);
+      break;
+    case '/':
+      compiler.emit(OpCode::DIV);
+      break;
+    default:
+      throw BasicError("UNSUPPORTED OPERATOR");
+  }
+}
+
+void CompoundExpression::remapSlots(const std::vector<int>& slots) {
+  left_->remapSlots(slots);
+  right_->remapSlots(slots);
+}
+
+bool CompoundExpression::decompose(const Expression*& left,
+                                   const Expression*& right, Instruction& op,
+                                   std::vector<Instruction>&) const {
+  left = left_;
+  right = right_;
+  switch (op_) {
+    case '+':
+      op = Instruction{OpCode::ADD, 0};
+      break;
+    case '-':
+      op = Instruction{OpCode::SUB, 0};
+      break;
+    case '*':
+      op = Instruction{OpCode::MUL, 0};
+      break;
+    case '/':
+      op = Instruction{OpCode::DIV, 0};
+      break;
+    default:
+      throw BasicError("UNSUPPORTED OPERATOR");
+  }
+  return true;
+}
+
+Expression* CompoundExpression::fold(Optimizer& optimizer) {
+  // 左结合的长运算链（a + b + c + ...）解析为很深的左侧链，沿左侧链
+  // 自底向上逐个化简，递归深度只取决于右子树
+  std::vector<CompoundExpression*> spine{this};
+  while (CompoundExpression* next = spine.back()->left_->asCompound()) {
+    spine.push_back(next);
+  }
+  spine.back()->left_ = optimizer.fold(spine.back()->left_);
+  Expression* replacement = nullptr;
+  for (auto it = spine.rbegin(); it != spine.rend(); ++it) {
+    CompoundExpression* node = *it;
+    if (it != spine.rbegin()) {
+      node->left_ = replacement != nullptr ? replacement : *std::prev(it);
+    }
+    node->right_ = optimizer.fold(node->right_);
+    replacement = node->foldSelf(optimizer);
+  }
+  return replacement;
+}
+
+CompoundExpression* CompoundExpression::asCompound() noexcept { return this; }
+
+Expression* CompoundExpression::foldSelf(Optimizer& optimizer) {
+  std::optional<int> lhs = left_->constant();
+  std::optional<int> rhs = right_->constant();
+
+  if (lhs && rhs) {
+    // 除零与 INT_MIN / -1 留给运行时，保证在原处以原样出错
+    bool unsafe = op_ == '/' &&
+                  (*rhs == 0 || (*lhs == std::numeric_limits<int>::min() &&
+                                 *rhs == -1));
+    if (!unsafe) {
+      // 复用运行时的求值逻辑，溢出结果与运行时一致
+      int value = evaluate(VarState());
+      optimizer.countRemoved(2);
+      return optimizer.makeConstant(value);
+    }
+    return nullptr;
+  }
+
+  // x + 0, 0 + x, x - 0, x * 1, 1 * x, x / 1 均化简为 x；x 仍会被求值，
+  // 所以其中的错误照常抛出。x * 0 与 x - x 不化简：读取 x 可能抛出
+  // VARIABLE NOT DEFINED 或 DIVIDE BY ZERO，化简会吞掉这些错误。
+  bool keepLeft = rhs && ((*rhs == 0 && (op_ == '+' || op_ == '-')) ||
+                          (*rhs == 1 && (op_ == '*' || op_ == '/')));
+  if (keepLeft) {
+    optimizer.countRemoved(2);
+    return left_;
+  }
+  bool keepRight = lhs && ((*lhs == 0 && op_ == '+') ||
+                           (*lhs == 1 && op_ == '*'));
+  if (keepRight) {
+    optimizer.countRemoved(2);
+    return right_;
+  }
+  return nullptr;
+}
+
+void PostfixExpression::expand(const Expression* expr,
+                               std::vector<Instruction>& out) {
+  // 用显式栈做后序遍历，second 为真表示左右子树都已输出
+  std::vector<std::pair<const Expression*, bool>> pending{{expr, false}};
+  while (!pending.empty()) {
+    auto [node, expanded] = pending.back();
+    pending.pop_back();
+    const Expression* left = nullptr;
+    const Expression* right = nullptr;
+    Instruction op{};
+    if (!node->decompose(left, right, op, out)) {
+      continue;
+    }
+    if (expanded) {
+      out.push_back(op);
+    } else {
+      pending.emplace_back(node, true);
+      pending.emplace_back(right, false);
+      pending.emplace_back(left, false);
+    }
+  }
+}
+
+Expression* PostfixExpression::flatten(Expression* expr, Arena& arena) {
+  std::vector<Instruction> out;
+  expand(expr, out);
+  // 只有一个运算符时逐节点求值只需三次虚调用，实测比展开更快
+  if (out.size() <= 3) {
+    return expr;
+  }
+
+  int depth = 0;
+  int maxDepth = 0;
+  for (const Instruction& ins : out) {
+    depth += (ins.op == OpCode::PUSH || ins.op == OpCode::LOAD) ? 1 : -1;
+    maxDepth = std::max(maxDepth, depth);
+  }
+  auto* code = static_cast<Instruction*>(
+      arena.allocate(sizeof(Instruction) * out.size(), alignof(Instruction)));
+  std::copy(out.begin(), out.end(), code);
+  return arena.make<PostfixExpression>(code, static_cast<int>(out.size()),
+                                       maxDepth);
+}
+
+PostfixExpression::PostfixExpression(Instruction* code, int size,
+                                     int maxDepth)
+    : code_(code), size_(size), maxDepth_(maxDepth) {}
+
+inline int PostfixExpression::run(const VarState& state, int* sp) const {
+  // 求值顺序与语法树一致：先左子树、再右子树、最后运算，错误在同一处抛出
+  const Instruction* ins = code_;
+  const Instruction* end = code_ + size_;
+
+  // 与 VM 相同，支持时每种指令各自跳往下一条
+#ifdef BASIC_THREADED_DISPATCH
+  static const void* const kHandlers[] = {&&op_PUSH, &&op_LOAD, &&op_ADD,
+                                          &&op_SUB,  &&op_MUL,  &&op_DIV};
+#define EXPR_CASE(name) op_##name
+#define EXPR_NEXT()                             \
+  do {                                          \
+    if (++ins == end) {                         \
+      return sp[-1];                            \
+    }                                           \
+    goto *kHandlers[static_cast<int>(ins->op)]; \
+  } while (false)
+
+  goto *kHandlers[static_cast<int>(ins->op)];
+  {
+#else
+#define EXPR_CASE(name) case OpCode::name
+#define EXPR_NEXT() continue
+
+  for (; ins != end; ++ins) {
+    switch (ins->op) {
+#endif
+      EXPR_CASE(PUSH):
+        *sp++ = ins->operand;
+        EXPR_NEXT();
+      EXPR_CASE(LOAD):
+        *sp++ = state.getValue(ins->operand);
+        EXPR_NEXT();
+      EXPR_CASE(ADD):
+        --sp;
+        sp[-1] = sp[-1] + sp[0];
+        EXPR_NEXT();
+      EXPR_CASE(SUB):
+        --sp;
+        sp[-1] = sp[-1] - sp[0];
+        EXPR_NEXT();
+      EXPR_CASE(MUL):
+        --sp;
+        sp[-1] = sp[-1] * sp[0];
+        EXPR_NEXT();
+      EXPR_CASE(DIV):
+        --sp;
+        if (sp[0] == 0) {
+          throw BasicError("DIVIDE BY ZERO");
+        }
+        if (sp[0] == -1 && sp[-1] == std::numeric_limits<int>::min()) {
+          throw BasicError("INTEGER OVERFLOW");
+        }
+        sp[-1] = sp[-1] / sp[0];
+        EXPR_NEXT();
+#ifdef BASIC_THREADED_DISPATCH
+  }
+#else
+      default:
+        break;
+    }
+  }
+  return sp[-1];
+#endif
+
+#undef EXPR_CASE
+#undef EXPR_NEXT
+}
+
+int PostfixExpression::evaluate(const VarState& state) const {
+  if (maxDepth_ > kLocalStack) {
+    std::vector<int> stack(maxDepth_);
+    return run(state, stack.data());
+  }
+  int stack[kLocalStack];
+  return run(state, stack);
+}
+
+void PostfixExpression::compile(Compiler& compiler) const {
+  for (int i = 0; i < size_; ++i) {
+    compiler.emit(code_[i].op, code_[i].operand);
+  }
+}
+
+void PostfixExpression::remapSlots(const std::vector<int>& slots) {
+  for (int i = 0; i < size_; ++i) {
+    if (code_[i].op == OpCode::LOAD) {
+      code_[i].operand = slots[code_[i].operand];
+    }
+  }
+}
+
+bool PostfixExpression::decompose(const Expression*&, const Expression*&,
+                                  Instruction&,
+                                  std::vector<Instruction>& out) const {
+  out.insert(out.end(), code_, code_ + size_);
+  return false;
+}
@@ -0,0 +1,331 @@
+#include "Image.hpp"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <limits>
+#include <type_traits>
+
+#include "Arena.hpp"
+#include "Expression.hpp"
+#include "Statement.hpp"
+#include "SymbolTable.hpp"
+
+namespace {
+
+constexpr char kMagic[8] = {'B', 'A', 'S', 'I', 'C', 'I', 'M', 'G'};
+
+static_assert(std::is_trivially_copyable_v<Image::LineRecord> &&
+                  sizeof(Image::Header) == 28 &&
+                  sizeof(Image::LineRecord) == 32 &&
+                  sizeof(Image::SymbolRecord) == 8 &&
+                  sizeof(Image::CodeRecord) == 8,
+              "image records are read in place");
+
+// 一行的语句与表达式节点（不含后缀指令）占用 Arena 的上限。
+constexpr std::size_t kExpressionBytes =
+    std::max(sizeof(PostfixExpression), 3 * sizeof(CompoundExpression)) +
+    3 * alignof(std::max_align_t);
+constexpr std::size_t kLineBytes = sizeof(IFStatement) +
+                                   alignof(std::max_align_t) +
+                                   2 * kExpressionBytes;
+
+// 各语句种类对应的表达式个数。
+int expressionCount(Image::Kind kind) {
+  switch (kind) {
+    case Image::Kind::LET:
+    case Image::Kind::PRINT:
+      return 1;
+    case Image::Kind::IF:
+      return 2;
+    default:
+      return 0;
+  }
+}
+
+char operatorFor(OpCode op) {
+  switch (op) {
+    case OpCode::ADD:
+      return '+';
+    case OpCode::SUB:
+      return '-';
+    case OpCode::MUL:
+      return '*';
+    default:
+      return '/';
+  }
+}
+
+// 字符串区中 [begin, begin + size) 是否越界。
+bool inside(std::string_view strings, std::uint32_t begin,
+            std::uint32_t size) {
+  return std::uint64_t{begin} + size <= strings.size();
+}
+
+// 检查后缀指令是否合法，返回求值所需的最大栈深度，不合法时返回 0。
+int checkExpression(const Image::CodeRecord* code, std::uint32_t size,
+                    std::uint32_t symbols) {
+  int depth = 0;
+  int maxDepth = 0;
+  for (std::uint32_t i = 0; i < size; ++i) {
+    switch (static_cast<OpCode>(code[i].op)) {
+      case OpCode::LOAD:
+        if (code[i].operand < 0 ||
+            static_cast<std::uint32_t>(code[i].operand) >= symbols) {
+          return 0;
+        }
+        [[fallthrough]];
+      case OpCode::PUSH:
+        maxDepth = std::max(maxDepth, ++depth);
+        break;
+      case OpCode::ADD:
+      case OpCode::SUB:
+      case OpCode::MUL:
+      case OpCode::DIV:
+        if (depth < 2) {
+          return 0;
+        }
+        --depth;
+        break;
+      default:
+        return 0;
+    }
+  }
+  return depth == 1 ? maxDepth : 0;
+}
+
+// 按 PostfixExpression::flatten 的规则重建表达式：不超过三条指令时
+// 保留为语法树，否则直接作为后缀指令数组放进 arena。
+Expression* buildExpression(const Image::CodeRecord* code, int size,
+                            int maxDepth, const std::vector<int>& slots,
+                            Arena& arena) {
+  if (size > 3) {
+    auto* out = static_cast<Instruction*>(
+        arena.allocate(sizeof(Instruction) * size, alignof(Instruction)));
+    for (int i = 0; i < size; ++i) {
+      out[i].op = static_cast<OpCode>(code[i].op);
+      out[i].operand =
+          out[i].op == OpCode::LOAD ? slots[code[i].operand] : code[i].operand;
+    }
+    return arena.make<PostfixExpression>(out, size, maxDepth);
+  }
+  Expression* stack[2];
+  int depth = 0;
+  for (int i = 0; i < size; ++i) {
+    OpCode op = static_cast<OpCode>(code[i].op);
+    if (op == OpCode::PUSH) {
+      stack[depth++] = arena.make<ConstExpression>(code[i].operand);
+    } else if (op == OpCode::LOAD) {
+      stack[depth++] = arena.make<VariableExpression>(slots[code[i].operand]);
+    } else {
+      --depth;
+      stack[depth - 1] = arena.make<CompoundExpression>(
+          stack[depth - 1], operatorFor(op), stack[depth]);
+    }
+  }
+  return stack[0];
+}
+
+}  // namespace
+
+void Image::save(const std::string& path, const Recorder& recorder,
+                 const SymbolTable& symbols) {
+  ImageWriter writer;
+  for (int i = 0; i < recorder.size(); ++i) {
+    const Statement* stmt = recorder.stmtAt(i);
+    writer.beginLine(recorder.lineAt(i), stmt->source());
+    stmt->save(writer);
+  }
+  writer.write(path, symbols);
+}
+
+Image::Image(const std::string& path) : path_(path), file_(path) {
+  std::string_view data = file_.text();
+  if (data.size() < sizeof(Header)) {
+    throw invalid();
+  }
+  header_ = reinterpret_cast<const Header*>(data.data());
+  if (std::memcmp(header_->magic, kMagic, sizeof(kMagic)) != 0 ||
+      header_->version != kVersion) {
+    throw invalid();
+  }
+  // 按文件头中的计数划分各区，总长度必须恰好吻合
+  std::uint64_t offset = sizeof(Header);
+  std::uint64_t lineBytes = std::uint64_t{header_->lines} * sizeof(LineRecord);
+  std::uint64_t symbolBytes =
+      std::uint64_t{header_->symbols} * sizeof(SymbolRecord);
+  std::uint64_t codeBytes = std::uint64_t{header_->code} * sizeof(CodeRecord);
+  if (offset + lineBytes + symbolBytes + codeBytes + header_->strings !=
+      data.size()) {
+    throw invalid();
+  }
+  lines_ = reinterpret_cast<const LineRecord*>(data.data() + offset);
+  offset += lineBytes;
+  symbols_ = reinterpret_cast<const SymbolRecord*>(data.data() + offset);
+  offset += symbolBytes;
+  code_ = reinterpret_cast<const CodeRecord*>(data.data() + offset);
+  offset += codeBytes;
+  strings_ = data.substr(offset);
+}
+
+std::size_t Image::memoryUsage() const noexcept {
+  return file_.text().size() + arena_.bytesUsed();
+}
+
+BasicError Image::invalid() const { return BasicError("INVALID IMAGE " + path_); }
+
+std::vector<Recorder::Entry> Image::load(SymbolTable& symbols) {
+  // 映像中的槽位 i 对应当前符号表中的 slots[i]
+  std::vector<int> slots(header_->symbols);
+  for (std::uint32_t i = 0; i < header_->symbols; ++i) {
+    if (!inside(strings_, symbols_[i].name, symbols_[i].size)) {
+      throw invalid();
+    }
+    slots[i] = symbols.intern(strings_.substr(symbols_[i].name, symbols_[i].size));
+  }
+
+  // 节点总量能事先估出，一次申请
+  arena_.reserve(std::size_t{header_->code} * sizeof(Instruction) +
+                 std::size_t{header_->lines} * kLineBytes);
+
+  std::vector<Recorder::Entry> batch;
+  batch.reserve(header_->lines);
+  for (std::uint32_t i = 0; i < header_->lines; ++i) {
+    const LineRecord& record = lines_[i];
+    if (record.line <= 0 || record.kind > Kind::END ||
+        !inside(strings_, record.text, record.textSize)) {
+      throw invalid();
+    }
+
+    // 先检查本行的全部表达式，再构造语句
+    int count = expressionCount(record.kind);
+    const CodeRecord* code[2] = {};
+    int depth[2] = {};
+    std::uint64_t next = record.code;
+    for (int e = 0; e < count; ++e) {
+      if (next + record.size[e] > header_->code) {
+        throw invalid();
+      }
+      code[e] = code_ + next;
+      depth[e] = checkExpression(code[e], record.size[e], header_->symbols);
+      if (depth[e] == 0) {
+        throw invalid();
+      }
+      next += record.size[e];
+    }
+    bool usesSlot = record.kind == Kind::LET || record.kind == Kind::INPUT;
+    if (usesSlot && (record.operand < 0 ||
+                     static_cast<std::uint32_t>(record.operand) >=
+                         header_->symbols)) {
+      throw invalid();
+    }
+
+    std::string_view source = strings_.substr(record.text, record.textSize);
+    auto expression = [&](int e) {
+      return buildExpression(code[e], static_cast<int>(record.size[e]),
+                             depth[e], slots, arena_);
+    };
+    Statement* stmt = nullptr;
+    switch (record.kind) {
+      case Kind::LET:
+        stmt = arena_.make<LETStatement>(source, slots[record.operand],
+                                         expression(0));
+        break;
+      case Kind::PRINT:
+        stmt = arena_.make<PRINTStatement>(source, expression(0));
+        break;
+      case Kind::INPUT:
+        stmt = arena_.make<INPUTStatement>(source, slots[record.operand]);
+        break;
+      case Kind::GOTO:
+        stmt = arena_.make<GOTOStatement>(source, record.operand);
+        break;
+      case Kind::IF:
+        stmt = arena_.make<IFStatement>(source, expression(0), expression(1),
+                                        record.op, record.operand);
+        break;
+      case Kind::REM:
+        stmt = arena_.make<REMStatement>(source);
+        break;
+      case Kind::END:
+        stmt = arena_.make<ENDStatement>(source);
+        break;
+    }
+    batch.push_back({record.line, StatementPtr(stmt, StatementDeleter{})});
+  }
+  return batch;
+}
+
+void ImageWriter::beginLine(int line, std::string_view source) {
+  Image::LineRecord record{};
+  record.line = line;
+  record.textSize = static_cast<std::uint32_t>(source.size());
+  record.text = addString(source);
+  record.code = static_cast<std::uint32_t>(code_.size());
+  lines_.push_back(record);
+  expressions_ = 0;
+}
+
+void ImageWriter::setStatement(Image::Kind kind, int operand, char op) {
+  lines_.back().kind = kind;
+  lines_.back().operand = operand;
+  lines_.back().op = op;
+}
+
+void ImageWriter::addExpression(const Expression* expr) {
+  scratch_.clear();
+  PostfixExpression::expand(expr, scratch_);
+  for (const Instruction& ins : scratch_) {
+    code_.push_back(
+        Image::CodeRecord{static_cast<std::int32_t>(ins.op), ins.operand});
+  }
+  lines_.back().size[expressions_++] =
+      static_cast<std::uint32_t>(scratch_.size());
+}
+
+std::uint32_t ImageWriter::addString(std::string_view text) {
+  std::size_t offset = strings_.size();
+  if (offset + text.size() > std::numeric_limits<std::uint32_t>::max()) {
+    throw BasicError("PROGRAM TOO LARGE FOR IMAGE");
+  }
+  strings_.append(text);
+  return static_cast<std::uint32_t>(offset);
+}
+
+void ImageWriter::write(const std::string& path, const SymbolTable& symbols) {
+  std::vector<Image::SymbolRecord> names(symbols.size());
+  for (int i = 0; i < symbols.size(); ++i) {
+    const std::string& name = symbols.name(i);
+    names[i].size = static_cast<std::uint32_t>(name.size());
+    names[i].name = addString(name);
+  }
+
+  Image::Header header{};
+  std::memcpy(header.magic, kMagic, sizeof(kMagic));
+  header.version = Image::kVersion;
+  header.lines = static_cast<std::uint32_t>(lines_.size());
+  header.symbols = static_cast<std::uint32_t>(names.size());
+  header.code = static_cast<std::uint32_t>(code_.size());
+  header.strings = static_cast<std::uint32_t>(strings_.size());
+
+  std::string temp = path + ".tmp";
+  std::FILE* out = std::fopen(temp.c_str(), "wb");
+  if (out == nullptr) {
+    throw BasicError("CANNOT WRITE FILE " + path);
+  }
+  bool ok =
+      std::fwrite(&header, sizeof(header), 1, out) == 1 &&
+      std::fwrite(lines_.data(), sizeof(Image::LineRecord), lines_.size(),
+                  out) == lines_.size() &&
+      std::fwrite(names.data(), sizeof(Image::SymbolRecord), names.size(),
+                  out) == names.size() &&
+      std::fwrite(code_.data(), sizeof(Image::CodeRecord), code_.size(),
+                  out) == code_.size() &&
+      std::fwrite(strings_.data(), 1, strings_.size(), out) ==
+          strings_.size();
+  ok = std::fclose(out) == 0 && ok;
+  if (!ok || std::rename(temp.c_str(), path.c_str()) != 0) {
+    std::remove(temp.c_str());
+    throw BasicError("CANNOT WRITE FILE " + path);
+  }
+}
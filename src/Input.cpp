@@ -0,0 +1,134 @@
+#include "Input.hpp"
+
+#include <unistd.h>
+
+#include <algorithm>
+#include <cctype>
+#include <cerrno>
+#include <charconv>
+#include <cstring>
+
+#include "Output.hpp"
+
+Input::Input(int fd)
+    : fd_(fd),
+      tie_(nullptr),
+      buffer_(kBlockSize),
+      begin_(0),
+      end_(0),
+      eof_(false),
+      awaiting_(false) {}
+
+void Input::tie(Output* output) noexcept { tie_ = output; }
+
+bool Input::readLine(std::string_view& line) {
+  std::size_t scanned = begin_;
+  for (;;) {
+    const char* data = buffer_.data();
+    const void* newline =
+        std::memchr(data + scanned, '\n', end_ - scanned);
+    if (newline != nullptr) {
+      std::size_t end = static_cast<const char*>(newline) - data;
+      line = std::string_view(data + begin_, end - begin_);
+      begin_ = end + 1;
+      return true;
+    }
+    if (eof_) {
+      // 最后一行可以没有换行符
+      if (begin_ == end_) {
+        return false;
+      }
+      line = std::string_view(data + begin_, end_ - begin_);
+      begin_ = end_;
+      return true;
+    }
+    if (fd_ < 0) {
+      return false;
+    }
+    scanned = end_ - begin_;
+    fill();
+    scanned += begin_;
+  }
+}
+
+void Input::feed(std::string_view data) {
+  compact(data.size());
+  std::memcpy(buffer_.data() + end_, data.data(), data.size());
+  end_ += data.size();
+}
+
+void Input::close() noexcept { eof_ = true; }
+
+void Input::reopen() noexcept {
+  begin_ = 0;
+  end_ = 0;
+  eof_ = false;
+  awaiting_ = false;
+}
+
+bool Input::wouldBlock() const noexcept {
+  return fd_ < 0 && !eof_ &&
+         std::memchr(buffer_.data() + begin_, '\n', end_ - begin_) == nullptr;
+}
+
+bool Input::awaiting() const noexcept { return awaiting_; }
+
+void Input::setAwaiting(bool awaiting) noexcept { awaiting_ = awaiting; }
+
+std::size_t Input::memoryUsage() const noexcept { return buffer_.capacity(); }
+
+void Input::compact(std::size_t room) {
+  if (begin_ != 0) {
+    std::memmove(buffer_.data(), buffer_.data() + begin_, end_ - begin_);
+    end_ -= begin_;
+    begin_ = 0;
+  }
+  if (buffer_.size() - end_ < room) {
+    buffer_.resize(std::max(buffer_.size() * 2, end_ + room));
+  }
+}
+
+// 把未读完的部分移到缓冲区开头后再读入一块，一行超过缓冲区时扩容。
+void Input::fill() {
+  compact(kBlockSize / 2);
+  if (tie_ != nullptr) {
+    tie_->flush();
+  }
+  for (;;) {
+    ssize_t count = ::read(fd_, buffer_.data() + end_, buffer_.size() - end_);
+    if (count > 0) {
+      end_ += static_cast<std::size_t>(count);
+      return;
+    }
+    if (count < 0 && errno == EINTR) {
+      continue;
+    }
+    eof_ = true;
+    return;
+  }
+}
+
+std::optional<int> Input::parseInteger(std::string_view text) noexcept {
+  // 与 C locale 下的 std::isspace 相同，避免逐字符的库调用
+  auto isSpace = [](char ch) { return ch == ' ' || (ch >= '\t' && ch <= '\r'); };
+  while (!text.empty() && isSpace(text.front())) {
+    text.remove_prefix(1);
+  }
+  while (!text.empty() && isSpace(text.back())) {
+    text.remove_suffix(1);
+  }
+  // from_chars 只接受负号，正号在这里去掉，且其后必须紧跟数字
+  if (!text.empty() && text.front() == '+') {
+    text.remove_prefix(1);
+    if (text.empty() || !std::isdigit(static_cast<unsigned char>(text[0]))) {
+      return std::nullopt;
+    }
+  }
+  int value = 0;
+  const char* last = text.data() + text.size();
+  auto [end, ec] = std::from_chars(text.data(), last, value);
+  if (ec != std::errc() || end != last) {
+    return std::nullopt;
+  }
+  return value;
+}
@@ -0,0 +1,119 @@
+#include "Interpreter.hpp"
+
+#include <streambuf>
+
+#include "Loader.hpp"
+#include "Token.hpp"
+#include "utils/Error.hpp"
+
+// 把 Output 整块写出的数据转交给输出回调，不另设缓冲。
+class Interpreter::Sink : public std::streambuf {
+ public:
+  Writer writer;
+
+ protected:
+  std::streamsize xsputn(const char* data, std::streamsize size) override {
+    if (writer && size > 0) {
+      writer(std::string_view(data, static_cast<std::size_t>(size)));
+    }
+    return size;
+  }
+
+  int_type overflow(int_type ch) override {
+    if (!traits_type::eq_int_type(ch, traits_type::eof())) {
+      char c = traits_type::to_char_type(ch);
+      xsputn(&c, 1);
+    }
+    return traits_type::not_eof(ch);
+  }
+};
+
+Interpreter::Interpreter() : Interpreter(Options()) {}
+
+Interpreter::Interpreter(const Options& options)
+    : sink_(std::make_unique<Sink>()),
+      stream_(sink_.get()),
+      program_(stream_, -1),
+      parser_(program_.symbols()) {
+  program_.setEngine(options.engine);
+  program_.setJit(options.jitThreshold > 0, options.jitThreshold);
+  program_.setLimits(options.maxJumps, options.timeLimit);
+  optimizer_.setEnabled(options.fold);
+}
+
+Interpreter::~Interpreter() = default;
+
+void Interpreter::setOutput(Writer writer) { sink_->writer = std::move(writer); }
+
+void Interpreter::setInput(Reader reader) { reader_ = std::move(reader); }
+
+void Interpreter::load(std::string_view source) {
+  Loader loader(lexer_, parser_, optimizer_);
+  // 嵌入时的程序一般很小，不值得启动线程
+  loader.setJobs(1);
+  loader.loadText(source, program_);
+  program_.output().flush();
+}
+
+void Interpreter::run() {
+  program_.input().reopen();
+  program_.start();
+  Program::Status status;
+  while ((status = program_.resume(VM::kUnlimited)) != Program::Status::FINISHED) {
+    if (status == Program::Status::WAITING) {
+      supply();
+    }
+  }
+}
+
+void Interpreter::execute(std::string_view statement) {
+  // 与交互输入一样，只有这三种语句可以立即执行
+  std::string_view keyword = statement.substr(0, 3);
+  if (keyword != "LET" && keyword != "PRI" && keyword != "INP") {
+    throw BasicError("SYNTAX ERROR");
+  }
+  TokenStream tokens = lexer_.tokenize(statement);
+  if (tokens.empty()) {
+    throw BasicError("SYNTAX ERROR");
+  }
+  std::unique_ptr<ParsedLine> parsedLine = parser_.parseLine(tokens, statement);
+  if (parsedLine->getLine().has_value()) {
+    throw BasicError("SYNTAX ERROR");
+  }
+  StatementPtr stmt = parsedLine->fetchStatement();
+  optimizer_.optimize(stmt);
+  program_.input().reopen();
+  while (program_.execute(stmt.get()) == Program::Status::WAITING) {
+    supply();
+  }
+}
+
+void Interpreter::clear() { program_.clear(); }
+
+std::optional<int> Interpreter::variable(std::string_view name) {
+  int slot = program_.symbols().find(name);
+  if (slot < 0 || !program_.variables().isDefined(slot)) {
+    return std::nullopt;
+  }
+  return program_.variables().getValue(slot);
+}
+
+void Interpreter::setVariable(std::string_view name, int value) {
+  program_.variables().setValue(program_.symbols().intern(name), value);
+}
+
+Program& Interpreter::program() noexcept { return program_; }
+
+void Interpreter::supply() {
+  Input& input = program_.input();
+  std::optional<std::string> line;
+  if (reader_) {
+    line = reader_();
+  }
+  if (line) {
+    input.feed(*line);
+    input.feed("\n");
+  } else {
+    input.close();
+  }
+}
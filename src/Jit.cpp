@@ -0,0 +1,639 @@
+#include "Jit.hpp"
+
+#include <algorithm>
+#include <climits>
+#include <cstddef>
+#include <cstring>
+#include <map>
+#include <utility>
+
+#include "Output.hpp"
+
+#ifdef BASIC_JIT
+
+#include <sys/mman.h>
+#include <unistd.h>
+
+namespace {
+
+// 区域最多包含的字节码指令数
+constexpr int kMaxRegion = 4096;
+
+enum Reg : int {
+  RAX, RCX, RDX, RBX, RSP, RBP, RSI, RDI,
+  R8, R9, R10, R11, R12, R13, R14, R15
+};
+
+enum Cond : int {
+  kNotCarry = 0x3,
+  kEqual = 0x4,
+  kNotEqual = 0x5,
+  kLess = 0xC,
+  kGreater = 0xF
+};
+
+// 操作数栈的前几项放在调用者保存的寄存器中，其余项放在 VM 的栈数组里
+constexpr Reg kStackRegs[] = {R8, R9, R10, R11, RSI, RDI};
+constexpr int kStackRegCount = 6;
+// 整个区域内不变的基址，都是被调用者保存的寄存器
+constexpr Reg kValues = RBX;
+constexpr Reg kDefined = R12;
+constexpr Reg kStack = R13;
+constexpr Reg kFrame = R14;
+// 剩余的跳转预算，进入时读入，返回时写回 JitFrame
+constexpr Reg kBudget = RBP;
+
+// 只覆盖生成区域所需的少量 x86-64 指令，整数运算都是 32 位。
+class Assembler {
+ public:
+  const std::vector<std::uint8_t>& bytes() const { return bytes_; }
+  int size() const { return static_cast<int>(bytes_.size()); }
+
+  void movImm(Reg dst, int value) {
+    rex(false, 0, dst);
+    byte(0xB8 + (dst & 7));
+    imm32(value);
+  }
+  void mov(Reg dst, Reg src) {
+    rex(false, src, dst);
+    byte(0x89);
+    modrmReg(src, dst);
+  }
+  void mov64(Reg dst, Reg src) {
+    rex(true, src, dst);
+    byte(0x89);
+    modrmReg(src, dst);
+  }
+  // [base + disp] 的 32 位读写
+  void load(Reg dst, Reg base, int disp) {
+    rex(false, dst, base);
+    byte(0x8B);
+    modrmMem(dst, base, disp);
+  }
+  void store(Reg base, int disp, Reg src) {
+    rex(false, src, base);
+    byte(0x89);
+    modrmMem(src, base, disp);
+  }
+  void storeImm(Reg base, int disp, int value) {
+    rex(false, 0, base);
+    byte(0xC7);
+    modrmMem(0, base, disp);
+    imm32(value);
+  }
+  void load64(Reg dst, Reg base, int disp) {
+    rex(true, dst, base);
+    byte(0x8B);
+    modrmMem(dst, base, disp);
+  }
+  void store64(Reg base, int disp, Reg src) {
+    rex(true, src, base);
+    byte(0x89);
+    modrmMem(src, base, disp);
+  }
+  void dec64(Reg dst) {
+    rex(true, 0, dst);
+    byte(0xFF);
+    modrmReg(1, dst);
+  }
+  // opcode 为 0x01 add、0x29 sub、0x39 cmp
+  void alu(int opcode, Reg dst, Reg src) {
+    rex(false, src, dst);
+    byte(opcode);
+    modrmReg(src, dst);
+  }
+  void imul(Reg dst, Reg src) {
+    rex(false, dst, src);
+    byte(0x0F);
+    byte(0xAF);
+    modrmReg(dst, src);
+  }
+  // ext 为 0 add、7 cmp
+  void aluImm(int ext, Reg dst, int value) {
+    rex(false, 0, dst);
+    byte(0x81);
+    modrmReg(ext, dst);
+    imm32(value);
+  }
+  void aluMemImm(int ext, Reg base, int disp, int value) {
+    rex(false, 0, base);
+    byte(0x81);
+    modrmMem(ext, base, disp);
+    imm32(value);
+  }
+  void test(Reg a, Reg b) {
+    rex(false, b, a);
+    byte(0x85);
+    modrmReg(b, a);
+  }
+  void cdq() { byte(0x99); }
+  void idiv(Reg src) {
+    rex(false, 0, src);
+    byte(0xF7);
+    modrmReg(7, src);
+  }
+  // qword [base + disp] 的第 bit 位：ext 为 4 bt（结果在 CF）、5 bts
+  void bitOp(int ext, Reg base, int disp, int bit) {
+    rex(true, 0, base);
+    byte(0x0F);
+    byte(0xBA);
+    modrmMem(ext, base, disp);
+    byte(bit);
+  }
+  // 32 位相对跳转，返回待回填位移的位置
+  int jcc(Cond cond) {
+    byte(0x0F);
+    byte(0x80 | cond);
+    imm32(0);
+    return size() - 4;
+  }
+  int jmp() {
+    byte(0xE9);
+    imm32(0);
+    return size() - 4;
+  }
+  void patch(int at, int target) {
+    int rel = target - (at + 4);
+    std::memcpy(&bytes_[at], &rel, sizeof(rel));
+  }
+  void push(Reg r) {
+    rex(false, 0, r);
+    byte(0x50 + (r & 7));
+  }
+  void pop(Reg r) {
+    rex(false, 0, r);
+    byte(0x58 + (r & 7));
+  }
+  void call(const void* function) {
+    // mov rax, imm64; call rax
+    byte(0x48);
+    byte(0xB8);
+    auto address = reinterpret_cast<std::uintptr_t>(function);
+    for (int i = 0; i < 8; ++i) {
+      byte(static_cast<int>((address >> (8 * i)) & 0xFF));
+    }
+    byte(0xFF);
+    byte(0xD0);
+  }
+  void ret() { byte(0xC3); }
+
+ private:
+  std::vector<std::uint8_t> bytes_;
+
+  void byte(int value) { bytes_.push_back(static_cast<std::uint8_t>(value)); }
+  void imm32(int value) {
+    auto bits = static_cast<std::uint32_t>(value);
+    for (int i = 0; i < 4; ++i) {
+      byte(static_cast<int>((bits >> (8 * i)) & 0xFF));
+    }
+  }
+  void rex(bool wide, int reg, int base) {
+    int prefix = 0x40 | (wide ? 8 : 0) | ((reg >> 3) << 2) | (base >> 3);
+    if (prefix != 0x40) {
+      byte(prefix);
+    }
+  }
+  void modrmReg(int reg, int rm) { byte(0xC0 | ((reg & 7) << 3) | (rm & 7)); }
+  // 总是使用 32 位位移；以 rsp/r12 为基址时需要 SIB 字节
+  void modrmMem(int reg, int base, int disp) {
+    byte(0x80 | ((reg & 7) << 3) | (base & 7));
+    if ((base & 7) == RSP) {
+      byte(0x24);
+    }
+    imm32(disp);
+  }
+};
+
+void printValue(Output* output, int value) noexcept {
+  output->printLine(value);
+}
+
+bool isSupported(OpCode op) {
+  switch (op) {
+    case OpCode::INPUT:
+    case OpCode::FAIL:
+    case OpCode::HALT:
+    case OpCode::LOOP:
+      return false;
+    default:
+      return true;
+  }
+}
+
+// 指令执行后操作数栈深度的变化，need 为执行前至少需要的深度
+int stackEffect(OpCode op, int& need) {
+  switch (op) {
+    case OpCode::PUSH:
+    case OpCode::LOAD:
+      need = 0;
+      return 1;
+    case OpCode::ADD:
+    case OpCode::SUB:
+    case OpCode::MUL:
+    case OpCode::DIV:
+      need = 2;
+      return -1;
+    case OpCode::STORE:
+    case OpCode::PRINT:
+    case OpCode::STORE_BRANCH_EQ:
+    case OpCode::STORE_BRANCH_GT:
+    case OpCode::STORE_BRANCH_LT:
+      need = 1;
+      return -1;
+    case OpCode::JUMP_EQ:
+    case OpCode::JUMP_GT:
+    case OpCode::JUMP_LT:
+      need = 2;
+      return -2;
+    default:
+      need = 0;
+      return 0;
+  }
+}
+
+// 比较跳转与各系列超级指令的条件码：EQ、GT、LT 依次排列
+Cond conditionOf(OpCode op, OpCode base) {
+  static const Cond kConditions[] = {kEqual, kGreater, kLess};
+  return kConditions[static_cast<int>(op) - static_cast<int>(base)];
+}
+
+// 把一个区域翻译成机器码。区域内的跳转目标都是行首，此时操作数栈为空；
+// 跳出区域与返回解释器都经过同一种出口：把寄存器中的栈项写回 VM 的栈，
+// 记下栈深度并返回继续执行的指令下标。
+class RegionCompiler {
+ public:
+  RegionCompiler(const Bytecode& bytecode, int entry)
+      : bytecode_(bytecode), entry_(entry) {}
+
+  bool compile();
+  const std::vector<std::uint8_t>& bytes() const { return asm_.bytes(); }
+  int slots() const { return slots_; }
+
+ private:
+  const Bytecode& bytecode_;
+  int entry_;
+  int end_{0};
+  // 区域内每条指令执行前的栈深度，末尾多一项
+  std::vector<int> depth_;
+  Assembler asm_;
+  // 区域内每条指令的机器码位置，末尾多一项
+  std::vector<int> offsets_;
+  // 区域内的跳转：待回填位置与目标指令
+  std::vector<std::pair<int, int>> internal_;
+  // 出口：(继续执行的指令, 栈深度) 到待回填位置
+  std::map<std::pair<int, int>, std::vector<int>> exits_;
+  int slots_{0};
+
+  bool analyze();
+  void emit(int index);
+  void emitExits();
+
+  int target(int label) const { return bytecode_.labels[label]; }
+  bool inRegister(int k) const { return k < kStackRegCount; }
+  // 栈项 k 所在的寄存器；在内存中时读入 scratch
+  Reg operand(int k, Reg scratch);
+  void write(int k, Reg src);
+  // 变量未定义时返回解释器，从 index 重新执行
+  void guard(int slot, int index, int depth);
+  void markDefined(int slot);
+  // 跳往指令 to，cond 为 -1 时无条件跳转；backward 时扣减预算
+  void branch(int cond, int to, int depth, bool backward);
+  void exit(int at, int to, int depth) { exits_[{to, depth}].push_back(at); }
+};
+
+bool RegionCompiler::compile() {
+  if (!analyze()) {
+    return false;
+  }
+  // 五次压栈后调用 printValue 时栈按 16 字节对齐；rbp 存放跳转预算
+  asm_.push(RBX);
+  asm_.push(RBP);
+  asm_.push(R12);
+  asm_.push(R13);
+  asm_.push(R14);
+  asm_.mov64(kFrame, RDI);
+  asm_.load64(kValues, kFrame, offsetof(JitFrame, values));
+  asm_.load64(kDefined, kFrame, offsetof(JitFrame, defined));
+  asm_.load64(kStack, kFrame, offsetof(JitFrame, stack));
+  asm_.load64(kBudget, kFrame, offsetof(JitFrame, budget));
+
+  int count = end_ - entry_;
+  offsets_.resize(count + 1);
+  for (int i = 0; i < count; ++i) {
+    offsets_[i] = asm_.size();
+    emit(entry_ + i);
+  }
+  offsets_[count] = asm_.size();
+  exit(asm_.jmp(), end_, depth_[count]);
+  for (const auto& [at, to] : internal_) {
+    asm_.patch(at, offsets_[to - entry_]);
+  }
+  emitExits();
+  return true;
+}
+
+bool RegionCompiler::analyze() {
+  const std::vector<Instruction>& code = bytecode_.code;
+  int size = static_cast<int>(code.size());
+  int depth = 0;
+  for (end_ = entry_; end_ < size && end_ - entry_ < kMaxRegion &&
+                      isSupported(code[end_].op);) {
+    int need;
+    int effect = stackEffect(code[end_].op, need);
+    if (depth < need) {
+      return false;
+    }
+    depth_.push_back(depth);
+    depth += effect;
+    // SKIP 之后是不再执行的旧指令或别处的行，区域到此为止
+    if (code[end_++].op == OpCode::SKIP) {
+      break;
+    }
+  }
+  depth_.push_back(depth);
+  if (end_ == entry_) {
+    return false;
+  }
+
+  // 区域内的跳转目标处栈深度必须与跳转后一致
+  for (int index = entry_; index < end_; ++index) {
+    const Instruction& ins = code[index];
+    int to;
+    if (ins.op >= OpCode::JUMP && ins.op <= OpCode::JUMP_LT) {
+      to = target(ins.operand);
+    } else if (ins.op >= OpCode::BRANCH_EQ) {
+      to = target(bytecode_.fused[ins.operand].target);
+    } else if (ins.op == OpCode::SKIP) {
+      to = ins.operand;
+    } else {
+      continue;
+    }
+    if (to >= entry_ && to < end_ &&
+        depth_[to - entry_] != depth_[index - entry_ + 1]) {
+      return false;
+    }
+  }
+  return true;
+}
+
+Reg RegionCompiler::operand(int k, Reg scratch) {
+  if (inRegister(k)) {
+    return kStackRegs[k];
+  }
+  asm_.load(scratch, kStack, 4 * k);
+  return scratch;
+}
+
+void RegionCompiler::write(int k, Reg src) {
+  if (!inRegister(k)) {
+    asm_.store(kStack, 4 * k, src);
+  } else if (kStackRegs[k] != src) {
+    asm_.mov(kStackRegs[k], src);
+  }
+}
+
+void RegionCompiler::guard(int slot, int index, int depth) {
+  slots_ = std::max(slots_, slot + 1);
+  asm_.bitOp(4, kDefined, 8 * (slot >> 6), slot & 63);
+  exit(asm_.jcc(kNotCarry), index, depth);
+}
+
+void RegionCompiler::markDefined(int slot) {
+  slots_ = std::max(slots_, slot + 1);
+  asm_.bitOp(5, kDefined, 8 * (slot >> 6), slot & 63);
+}
+
+// 向前的跳转直接跳往目标或出口。向后的跳转（循环只能由它形成）与解释器
+// 一样扣减一次预算：预算用完时以目标为继续执行的位置返回解释器，
+// 跳出区域时由解释器检查。条件跳转取反后跳过扣减，循环中只有一次跳转。
+void RegionCompiler::branch(int cond, int to, int depth, bool backward) {
+  bool internal = to >= entry_ && to < end_;
+  if (!backward) {
+    int at = cond < 0 ? asm_.jmp() : asm_.jcc(static_cast<Cond>(cond));
+    if (internal) {
+      internal_.emplace_back(at, to);
+    } else {
+      exit(at, to, depth);
+    }
+    return;
+  }
+  int skip = cond < 0 ? -1 : asm_.jcc(static_cast<Cond>(cond ^ 1));
+  asm_.dec64(kBudget);
+  if (internal) {
+    internal_.emplace_back(asm_.jcc(kNotEqual), to);
+  }
+  exit(asm_.jmp(), to, depth);
+  if (skip >= 0) {
+    asm_.patch(skip, asm_.size());
+  }
+}
+
+void RegionCompiler::emit(int index) {
+  const Instruction& ins = bytecode_.code[index];
+  int d = depth_[index - entry_];
+  switch (ins.op) {
+    case OpCode::PUSH:
+      if (inRegister(d)) {
+        asm_.movImm(kStackRegs[d], ins.operand);
+      } else {
+        asm_.storeImm(kStack, 4 * d, ins.operand);
+      }
+      break;
+    case OpCode::LOAD:
+      guard(ins.operand, index, d);
+      if (inRegister(d)) {
+        asm_.load(kStackRegs[d], kValues, 4 * ins.operand);
+      } else {
+        asm_.load(RAX, kValues, 4 * ins.operand);
+        write(d, RAX);
+      }
+      break;
+    case OpCode::ADD:
+    case OpCode::SUB:
+    case OpCode::MUL: {
+      Reg lhs = inRegister(d - 2) ? kStackRegs[d - 2] : operand(d - 2, RAX);
+      Reg rhs = operand(d - 1, RCX);
+      if (ins.op == OpCode::MUL) {
+        asm_.imul(lhs, rhs);
+      } else {
+        asm_.alu(ins.op == OpCode::ADD ? 0x01 : 0x29, lhs, rhs);
+      }
+      write(d - 2, lhs);
+      break;
+    }
+    case OpCode::DIV: {
+      // 除零与 INT_MIN / -1 都交给解释器处理
+      Reg lhs = operand(d - 2, RAX);
+      if (lhs != RAX) {
+        asm_.mov(RAX, lhs);
+      }
+      Reg rhs = operand(d - 1, RCX);
+      asm_.test(rhs, rhs);
+      exit(asm_.jcc(kEqual), index, d);
+      asm_.aluImm(7, rhs, -1);
+      int skip = asm_.jcc(kNotEqual);
+      asm_.aluImm(7, RAX, INT_MIN);
+      exit(asm_.jcc(kEqual), index, d);
+      asm_.patch(skip, asm_.size());
+      asm_.cdq();
+      asm_.idiv(rhs);
+      write(d - 2, RAX);
+      break;
+    }
+    case OpCode::STORE:
+      asm_.store(kValues, 4 * ins.operand, operand(d - 1, RAX));
+      markDefined(ins.operand);
+      break;
+    case OpCode::PRINT: {
+      // 调用会改写存放栈项的寄存器，先把下面的栈项写回内存
+      int live = std::min(d - 1, kStackRegCount);
+      for (int k = 0; k < live; ++k) {
+        asm_.store(kStack, 4 * k, kStackRegs[k]);
+      }
+      Reg value = operand(d - 1, RSI);
+      if (value != RSI) {
+        asm_.mov(RSI, value);
+      }
+      asm_.load64(RDI, kFrame, offsetof(JitFrame, output));
+      asm_.call(reinterpret_cast<const void*>(&printValue));
+      for (int k = 0; k < live; ++k) {
+        asm_.load(kStackRegs[k], kStack, 4 * k);
+      }
+      break;
+    }
+    case OpCode::JUMP:
+      branch(-1, target(ins.operand), d, ins.backward);
+      break;
+    case OpCode::SKIP:
+      branch(-1, ins.operand, d, false);
+      break;
+    case OpCode::JUMP_EQ:
+    case OpCode::JUMP_GT:
+    case OpCode::JUMP_LT: {
+      Reg lhs = operand(d - 2, RAX);
+      Reg rhs = operand(d - 1, RCX);
+      asm_.alu(0x39, lhs, rhs);
+      branch(conditionOf(ins.op, OpCode::JUMP_EQ), target(ins.operand), d - 2,
+             ins.backward);
+      break;
+    }
+    case OpCode::INC: {
+      const FusedOperands& f = bytecode_.fused[ins.operand];
+      guard(f.slot, index, d);
+      asm_.aluMemImm(0, kValues, 4 * f.slot, f.step);
+      break;
+    }
+    case OpCode::BRANCH_EQ:
+    case OpCode::BRANCH_GT:
+    case OpCode::BRANCH_LT: {
+      const FusedOperands& f = bytecode_.fused[ins.operand];
+      guard(f.slot, index, d);
+      asm_.aluMemImm(7, kValues, 4 * f.slot, f.constant);
+      branch(conditionOf(ins.op, OpCode::BRANCH_EQ), target(f.target), d,
+             ins.backward);
+      break;
+    }
+    case OpCode::INC_BRANCH_EQ:
+    case OpCode::INC_BRANCH_GT:
+    case OpCode::INC_BRANCH_LT: {
+      const FusedOperands& f = bytecode_.fused[ins.operand];
+      guard(f.slot, index, d);
+      asm_.load(RAX, kValues, 4 * f.slot);
+      asm_.aluImm(0, RAX, f.step);
+      asm_.store(kValues, 4 * f.slot, RAX);
+      asm_.aluImm(7, RAX, f.constant);
+      branch(conditionOf(ins.op, OpCode::INC_BRANCH_EQ), target(f.target), d,
+             ins.backward);
+      break;
+    }
+    case OpCode::STORE_BRANCH_EQ:
+    case OpCode::STORE_BRANCH_GT:
+    case OpCode::STORE_BRANCH_LT: {
+      const FusedOperands& f = bytecode_.fused[ins.operand];
+      Reg value = operand(d - 1, RAX);
+      asm_.store(kValues, 4 * f.slot, value);
+      markDefined(f.slot);
+      asm_.aluImm(7, value, f.constant);
+      branch(conditionOf(ins.op, OpCode::STORE_BRANCH_EQ), target(f.target),
+             d - 1, ins.backward);
+      break;
+    }
+    default:
+      break;
+  }
+}
+
+void RegionCompiler::emitExits() {
+  int epilogue = asm_.size();
+  asm_.store64(kFrame, offsetof(JitFrame, budget), kBudget);
+  asm_.pop(R14);
+  asm_.pop(R13);
+  asm_.pop(R12);
+  asm_.pop(RBP);
+  asm_.pop(RBX);
+  asm_.ret();
+  for (const auto& [key, sites] : exits_) {
+    auto [to, depth] = key;
+    for (int at : sites) {
+      asm_.patch(at, asm_.size());
+    }
+    for (int k = 0; k < std::min(depth, kStackRegCount); ++k) {
+      asm_.store(kStack, 4 * k, kStackRegs[k]);
+    }
+    asm_.storeImm(kFrame, offsetof(JitFrame, depth), depth);
+    asm_.movImm(RAX, to);
+    asm_.patch(asm_.jmp(), epilogue);
+  }
+}
+
+}  // namespace
+
+Jit::~Jit() {
+  for (const Region& region : regions_) {
+    ::munmap(region.memory, region.size);
+  }
+}
+
+int Jit::compile(const Bytecode& bytecode, int entry) {
+  RegionCompiler compiler(bytecode, entry);
+  if (!compiler.compile()) {
+    return -1;
+  }
+  const std::vector<std::uint8_t>& bytes = compiler.bytes();
+  std::size_t page = static_cast<std::size_t>(::sysconf(_SC_PAGESIZE));
+  std::size_t size = (bytes.size() + page - 1) / page * page;
+  // 先写入再改为可执行，任何时刻都不同时可写可执行
+  void* memory = ::mmap(nullptr, size, PROT_READ | PROT_WRITE,
+                        MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+  if (memory == MAP_FAILED) {
+    return -1;
+  }
+  std::memcpy(memory, bytes.data(), bytes.size());
+  if (::mprotect(memory, size, PROT_READ | PROT_EXEC) != 0) {
+    ::munmap(memory, size);
+    return -1;
+  }
+  regions_.push_back(
+      Region{memory, size, reinterpret_cast<Entry>(memory)});
+  slots_ = std::max(slots_, compiler.slots());
+  return static_cast<int>(regions_.size()) - 1;
+}
+
+int Jit::run(int region, JitFrame& frame) const {
+  return regions_[region].entry(&frame);
+}
+
+#else
+
+Jit::~Jit() = default;
+
+int Jit::compile(const Bytecode&, int) { return -1; }
+
+int Jit::run(int, JitFrame& frame) const {
+  frame.depth = 0;
+  return -1;
+}
+
+#endif
+
+int Jit::slots() const noexcept { return slots_; }
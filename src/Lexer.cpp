@@ -1,29 +1,15 @@
 #include "Lexer.hpp"
 
-#include <limits>
+#include <algorithm>
 #include <string>
-#include <unordered_map>
 #include <vector>
 
 #include "utils/Error.hpp"
 
-const std::unordered_map<std::string, TokenType> TABLE = {
-    {"LET", TokenType::LET},     {"PRINT", TokenType::PRINT},
-    {"INPUT", TokenType::INPUT}, {"END", TokenType::END},
-    {"REM", TokenType::REM},     {"GOTO", TokenType::GOTO},
-    {"IF", TokenType::IF},       {"THEN", TokenType::THEN},
-    {"RUN", TokenType::RUN},     {"LIST", TokenType::LIST},
-    {"CLEAR", TokenType::CLEAR}, {"QUIT", TokenType::QUIT},
-    {"HELP", TokenType::HELP}};
-
-bool isOverflow(const std::string& digits, bool negative) {
-  constexpr long long max_limit = std::numeric_limits<int>::max();
-  return negative ? std::stol(digits) > max_limit
-                  : std::stol(digits) > max_limit + 1;
-}
-
-TokenStream Lexer::tokenize(const std::string& line) const {
+TokenStream Lexer::tokenize(std::string_view line) const {
   std::vector<Token> tokens;
+  // 每个字符至多产生一个 Token；常见的程序行不超过 32 个 Token，一次分配即可
+  tokens.reserve(std::min<std::size_t>(line.size(), 32));
   int column = 0;
   while (column < line.size()) {
     char ch = line[column];
@@ -38,13 +24,13 @@ TokenStream Lexer::tokenize(const std::string& line) const {
       while (column < line.size() && isLetterChar(line[column])) {
         ++column;
       }
-      std::string text = line.substr(start, column - start);
+      std::string_view text = line.substr(start, column - start);
       TokenType type = matchKeyword(text);
       switch (type) {
         case TokenType::REM:
           tokens.push_back(Token{TokenType::REM, text, column});
           if (column < line.size()) {
-            std::string comment = line.substr(column);
+            std::string_view comment = line.substr(column);
             tokens.push_back(Token{TokenType::REMINFO, comment, column + 1});
           }
           return TokenStream(std::move(tokens));
@@ -62,7 +48,7 @@ TokenStream Lexer::tokenize(const std::string& line) const {
       while (column < line.size() && isNumberChar(line[column])) {
         ++column;
       }
-      std::string text = line.substr(start, column - start);
+      std::string_view text = line.substr(start, column - start);
       tokens.push_back(Token{TokenType::NUMBER, text, column});
       continue;
     }
@@ -103,7 +89,7 @@ TokenStream Lexer::tokenize(const std::string& line) const {
         break;
     }
     if (symbolType != TokenType::UNKNOWN) {
-      tokens.push_back(Token{symbolType, std::string(1, ch), column});
+      tokens.push_back(Token{symbolType, line.substr(column, 1), column});
       ++column;
       continue;
     }
@@ -122,10 +108,53 @@ bool Lexer::isNumberChar(char ch) noexcept {
   return std::isalnum(static_cast<unsigned char>(ch)) || ch == '_';
 }
 
-TokenType Lexer::matchKeyword(const std::string& text) noexcept {
-  auto it = TABLE.find(text);
-  if (it != TABLE.end()) {
-    return it->second;
+// 关键字集合固定，先按长度再按首字母分派，最多比较一次完整文本。
+TokenType Lexer::matchKeyword(std::string_view text) noexcept {
+  auto match = [&text](std::string_view keyword, TokenType type) {
+    return text == keyword ? type : TokenType::UNKNOWN;
+  };
+  switch (text.size()) {
+    case 2:
+      return match("IF", TokenType::IF);
+    case 3:
+      switch (text[0]) {
+        case 'L':
+          return match("LET", TokenType::LET);
+        case 'E':
+          return match("END", TokenType::END);
+        case 'R':
+          return text[1] == 'E' ? match("REM", TokenType::REM)
+                                : match("RUN", TokenType::RUN);
+        default:
+          return TokenType::UNKNOWN;
+      }
+    case 4:
+      switch (text[0]) {
+        case 'G':
+          return match("GOTO", TokenType::GOTO);
+        case 'T':
+          return match("THEN", TokenType::THEN);
+        case 'L':
+          return match("LIST", TokenType::LIST);
+        case 'Q':
+          return match("QUIT", TokenType::QUIT);
+        case 'H':
+          return match("HELP", TokenType::HELP);
+        default:
+          return TokenType::UNKNOWN;
+      }
+    case 5:
+      switch (text[0]) {
+        case 'P':
+          return match("PRINT", TokenType::PRINT);
+        case 'I':
+          return match("INPUT", TokenType::INPUT);
+        case 'C':
+          return match("CLEAR", TokenType::CLEAR);
+        default:
+          return TokenType::UNKNOWN;
+      }
+    default:
+      return TokenType::UNKNOWN;
   }
-  return TokenType::UNKNOWN;
 }
\ No newline at end of file
@@ -0,0 +1,195 @@
+#include "Loader.hpp"
+
+#include <algorithm>
+#include <future>
+#include <memory>
+#include <thread>
+
+#include "Lexer.hpp"
+#include "Optimizer.hpp"
+#include "Parser.hpp"
+#include "Program.hpp"
+#include "SymbolTable.hpp"
+#include "utils/Error.hpp"
+#include "utils/MappedFile.hpp"
+#include "utils/ThreadPool.hpp"
+
+namespace {
+
+// 小于该大小的片段不值得交给其他线程。
+constexpr std::size_t kMinChunkBytes = 64 * 1024;
+
+// 依次对 text 中的每个非空行调用 fn，行尾的 '\r' 被去掉。
+template <class Fn>
+void forEachLine(std::string_view text, Fn&& fn) {
+  std::size_t pos = 0;
+  while (pos < text.size()) {
+    std::size_t end = text.find('\n', pos);
+    if (end == std::string_view::npos) {
+      end = text.size();
+    }
+    std::string_view line = text.substr(pos, end - pos);
+    pos = end + 1;
+    if (!line.empty() && line.back() == '\r') {
+      line.remove_suffix(1);
+    }
+    if (!line.empty()) {
+      fn(line);
+    }
+  }
+}
+
+}  // namespace
+
+// 并行解析的一段输入，各段使用独立的符号表与优化器。
+struct Loader::Chunk {
+  std::string_view text;
+  std::vector<Recorder::Entry> entries;
+  std::vector<std::string> errors;
+  SymbolTable symbols;
+  long long folded{0};
+};
+
+Loader::Loader(const Lexer& lexer, const Parser& parser, Optimizer& optimizer)
+    : lexer_(&lexer), parser_(&parser), optimizer_(&optimizer) {}
+
+void Loader::setJobs(std::size_t jobs) noexcept { jobs_ = jobs; }
+
+void Loader::loadFile(const std::string& path, Program& program) {
+  MappedFile file(path);
+  // 源文本已复制进各行的 Arena，载入完成后即可解除映射
+  loadText(file.text(), program);
+}
+
+void Loader::loadText(std::string_view text, Program& program) {
+  std::size_t threads = jobs_;
+  if (threads == 0) {
+    threads = std::max(1u, std::thread::hardware_concurrency());
+  }
+  // 每个线程分几段，避免各段耗时不均时线程空等
+  std::size_t count = std::min(threads * 4, text.size() / kMinChunkBytes);
+  if (threads == 1 || count <= 1) {
+    loadSequential(text, program);
+    return;
+  }
+
+  // 在换行处切分，使每段大小接近
+  std::vector<Chunk> chunks(count);
+  std::size_t begin = 0;
+  for (std::size_t i = 0; i < count; ++i) {
+    std::size_t end = text.size();
+    if (i + 1 < count) {
+      end = text.find('\n', std::max(begin, text.size() * (i + 1) / count));
+      end = (end == std::string_view::npos) ? text.size() : end + 1;
+    }
+    chunks[i].text = text.substr(begin, end - begin);
+    begin = end;
+  }
+  loadParallel(chunks, threads, program);
+}
+
+void Loader::loadSequential(std::string_view text, Program& program) {
+  std::vector<Recorder::Entry> batch;
+  batch.reserve(std::count(text.begin(), text.end(), '\n') + 1);
+  forEachLine(text, [&](std::string_view line) {
+    try {
+      parseLine(line, *parser_, *optimizer_, batch);
+    } catch (const BasicError& e) {
+      program.output().write(e.message());
+      program.output().write("\n");
+    }
+  });
+  program.addStmts(std::move(batch));
+}
+
+void Loader::loadParallel(std::vector<Chunk>& chunks, std::size_t threads,
+                          Program& program) {
+  ThreadPool pool(std::min(threads, chunks.size()));
+  bool fold = optimizer_->enabled();
+  std::vector<std::future<void>> done;
+  done.reserve(chunks.size());
+  for (Chunk& chunk : chunks) {
+    done.push_back(pool.submit([this, &chunk, fold] {
+      Parser parser(chunk.symbols);
+      Optimizer optimizer;
+      optimizer.setEnabled(fold);
+      chunk.entries.reserve(
+          std::count(chunk.text.begin(), chunk.text.end(), '\n') + 1);
+      forEachLine(chunk.text, [&](std::string_view line) {
+        try {
+          parseLine(line, parser, optimizer, chunk.entries);
+        } catch (const BasicError& e) {
+          chunk.errors.push_back(e.message());
+        }
+      });
+      chunk.folded = optimizer.removedNodes();
+    }));
+  }
+  for (auto& task : done) {
+    task.get();
+  }
+
+  // 按输入顺序合并：错误依次输出，各段的变量名依次登记到全局符号表，
+  // 因此槽位的分配顺序与顺序解析时相同
+  SymbolTable& symbols = program.symbols();
+  std::size_t total = 0;
+  done.clear();
+  for (Chunk& chunk : chunks) {
+    for (const std::string& error : chunk.errors) {
+      program.output().write(error);
+      program.output().write("\n");
+    }
+    std::vector<int> slots(chunk.symbols.size());
+    bool identity = true;
+    for (int slot = 0; slot < chunk.symbols.size(); ++slot) {
+      slots[slot] = symbols.intern(chunk.symbols.name(slot));
+      identity = identity && slots[slot] == slot;
+    }
+    if (!identity) {
+      done.push_back(pool.submit([&chunk, slots = std::move(slots)] {
+        for (Recorder::Entry& entry : chunk.entries) {
+          if (entry.stmt) {
+            entry.stmt->remapSlots(slots);
+          }
+        }
+      }));
+    }
+    optimizer_->countRemoved(static_cast<int>(chunk.folded));
+    total += chunk.entries.size();
+  }
+  for (auto& task : done) {
+    task.get();
+  }
+
+  std::vector<Recorder::Entry> batch;
+  batch.reserve(total);
+  for (Chunk& chunk : chunks) {
+    std::move(chunk.entries.begin(), chunk.entries.end(),
+              std::back_inserter(batch));
+  }
+  program.addStmts(std::move(batch));
+}
+
+void Loader::parseLine(std::string_view line, const Parser& parser,
+                       Optimizer& optimizer,
+                       std::vector<Recorder::Entry>& batch) const {
+  TokenStream tokens = lexer_->tokenize(line);
+  if (tokens.empty()) {
+    throw BasicError("SYNTAX ERROR");
+  }
+  std::unique_ptr<ParsedLine> parsedLine = parser.parseLine(tokens, line);
+  if (!parsedLine->getLine().has_value()) {
+    throw BasicError("SYNTAX ERROR");
+  }
+  int lineNum = parsedLine->getLine().value();
+  StatementPtr stmt = parsedLine->fetchStatement();
+  if (stmt) {
+    // 与 Program::addStmt 相同的检查，保证错误在输入顺序中的位置不变
+    if (lineNum <= 0) {
+      throw BasicError("SYNTAX ERROR");
+    }
+    optimizer.optimize(stmt);
+  }
+  // 空语句表示删除该行
+  batch.push_back(Recorder::Entry{lineNum, std::move(stmt)});
+}
@@ -0,0 +1,37 @@
+#include "Optimizer.hpp"
+
+#include "Arena.hpp"
+#include "Expression.hpp"
+
+void Optimizer::setEnabled(bool enabled) noexcept { enabled_ = enabled; }
+
+bool Optimizer::enabled() const noexcept { return enabled_; }
+
+void Optimizer::optimize(StatementPtr& stmt) {
+  if (!stmt) {
+    return;
+  }
+  // 被化简掉的节点留在 Arena 中，随语句一起释放
+  arena_ = stmt.get_deleter().arena;
+  if (enabled_) {
+    stmt->optimize(*this);
+  }
+  // 展开不改变行为，关闭折叠时同样进行
+  stmt->flatten(*arena_);
+  arena_ = nullptr;
+}
+
+Expression* Optimizer::fold(Expression* expr) {
+  if (Expression* replacement = expr->fold(*this)) {
+    return replacement;
+  }
+  return expr;
+}
+
+Expression* Optimizer::makeConstant(int value) {
+  return arena_->make<ConstExpression>(value);
+}
+
+void Optimizer::countRemoved(int nodes) noexcept { removed_ += nodes; }
+
+long long Optimizer::removedNodes() const noexcept { return removed_; }
@@ -0,0 +1,63 @@
+#include "Output.hpp"
+
+#include <charconv>
+#include <cstring>
+#include <limits>
+#include <ostream>
+
+Output::Output(std::ostream& stream)
+    : stream_(&stream),
+      buffer_(new char[kBufferSize]),
+      size_(0),
+      lineBuffered_(false) {}
+
+Output::~Output() { flush(); }
+
+void Output::setLineBuffered(bool lineBuffered) noexcept {
+  lineBuffered_ = lineBuffered;
+}
+
+void Output::printLine(int value) {
+  // 符号、十位数字与换行
+  constexpr std::size_t kMaxLength = std::numeric_limits<int>::digits10 + 3;
+  if (kBufferSize - size_ < kMaxLength) {
+    drain();
+  }
+  char* begin = buffer_.get() + size_;
+  char* end = std::to_chars(begin, begin + kMaxLength, value).ptr;
+  *end++ = '\n';
+  size_ += end - begin;
+  if (lineBuffered_) {
+    flush();
+  }
+}
+
+void Output::write(std::string_view text) {
+  if (kBufferSize - size_ < text.size()) {
+    drain();
+    if (text.size() >= kBufferSize) {
+      stream_->write(text.data(), text.size());
+      return;
+    }
+  }
+  std::memcpy(buffer_.get() + size_, text.data(), text.size());
+  size_ += text.size();
+  if (lineBuffered_ && text.find('\n') != std::string_view::npos) {
+    flush();
+  }
+}
+
+void Output::flush() {
+  drain();
+  stream_->flush();
+}
+
+std::size_t Output::memoryUsage() const noexcept { return kBufferSize; }
+
+// 缓冲区内容交给底层流，但不要求底层流立即写出。
+void Output::drain() {
+  if (size_ != 0) {
+    stream_->write(buffer_.get(), size_);
+    size_ = 0;
+  }
+}
@@ -1,15 +1,16 @@
 #include "Parser.hpp"
 
+#include <charconv>
 #include <sstream>
-#include <stdexcept>
 #include <string>
 #include <vector>
 
 #include "Expression.hpp"
 #include "Statement.hpp"
+#include "SymbolTable.hpp"
 #include "utils/Error.hpp"
 
-ParsedLine::ParsedLine() { statement_ = nullptr; }
+ParsedLine::ParsedLine() : arena_(std::make_unique<Arena>()) { statement_ = nullptr; }
 
 ParsedLine::~ParsedLine() {}
 
@@ -17,18 +18,26 @@ void ParsedLine::setLine(int line) { line_number_.emplace(line); }
 
 std::optional<int> ParsedLine::getLine() { return line_number_; }
 
-void ParsedLine::setStatement(std::unique_ptr<Statement> stmt) { statement_ = std::move(stmt); }
+Arena& ParsedLine::arena() { return *arena_; }
 
-const Statement* ParsedLine::getStatement() const { return statement_.get(); }
+void ParsedLine::setStatement(Statement* stmt) { statement_ = stmt; }
 
-std::unique_ptr<Statement> ParsedLine::fetchStatement() {
-  std::unique_ptr<Statement> temp = std::move(statement_);
+const Statement* ParsedLine::getStatement() const { return statement_; }
+
+StatementPtr ParsedLine::fetchStatement() {
+  if (!statement_) {
+    return nullptr;
+  }
+  // 语句连同其所在的 Arena 一起转移所有权
+  StatementPtr temp(statement_, StatementDeleter{arena_.release()});
   statement_ = nullptr;
   return temp;
 }
 
+Parser::Parser(SymbolTable& symbols) : symbols_(&symbols) {}
+
 std::unique_ptr<ParsedLine> Parser::parseLine(TokenStream& tokens,
-                             const std::string& originLine) const {
+                             std::string_view originLine) const {
   auto result = std::make_unique<ParsedLine>();
 
   // 检查是否有行号
@@ -44,14 +53,17 @@ std::unique_ptr<ParsedLine> Parser::parseLine(TokenStream& tokens,
     }
   }
 
-  // 解析语句
-  result->setStatement(parseStatement(tokens, originLine));
+  // 解析语句，原始文本复制进本行的 Arena 供 LIST 使用
+  Arena& arena = result->arena();
+  result->setStatement(
+      parseStatement(tokens, arena.copy(originLine), arena));
 
   return std::move(result);
 }
 
-std::unique_ptr<Statement> Parser::parseStatement(TokenStream& tokens,
-                                  const std::string& originLine) const {
+Statement* Parser::parseStatement(TokenStream& tokens,
+                              std::string_view originLine,
+                              Arena& arena) const {
   if (tokens.empty()) {
     throw BasicError("SYNTAX ERROR");
   }
@@ -63,26 +75,27 @@ std::unique_ptr<Statement> Parser::parseStatement(TokenStream& tokens,
 
   switch (token->type) {
     case TokenType::LET:
-      return parseLet(tokens, originLine);
+      return parseLet(tokens, originLine, arena);
     case TokenType::PRINT:
-      return parsePrint(tokens, originLine);
+      return parsePrint(tokens, originLine, arena);
     case TokenType::INPUT:
-      return parseInput(tokens, originLine);
+      return parseInput(tokens, originLine, arena);
     case TokenType::GOTO:
-      return parseGoto(tokens, originLine);
+      return parseGoto(tokens, originLine, arena);
     case TokenType::IF:
-      return parseIf(tokens, originLine);
+      return parseIf(tokens, originLine, arena);
     case TokenType::REM:
-      return parseRem(tokens, originLine);
+      return parseRem(tokens, originLine, arena);
     case TokenType::END:
-      return parseEnd(tokens, originLine);
+      return parseEnd(tokens, originLine, arena);
     default:
       throw BasicError("SYNTAX ERROR");
   }
 }
 
-std::unique_ptr<Statement> Parser::parseLet(TokenStream& tokens,
-                            const std::string& originLine) const {
+Statement* Parser::parseLet(TokenStream& tokens,
+                              std::string_view originLine,
+                              Arena& arena) const {
   if (tokens.empty()) {
     throw BasicError("SYNTAX ERROR");
   }
@@ -92,27 +105,28 @@ std::unique_ptr<Statement> Parser::parseLet(TokenStream& tokens,
     throw BasicError("SYNTAX ERROR");
   }
 
-  std::string varName = varToken->text;
+  int var = symbols_->intern(varToken->text);
 
   if (tokens.empty() || tokens.get()->type != TokenType::EQUAL) {
     throw BasicError("SYNTAX ERROR");
   }
 
-  auto expr = parseExpression(tokens);
+  auto expr = parseExpression(tokens, arena);
   // TODO: create a corresponding stmt and return it.
-  return std::make_unique<LETStatement>(originLine, varName,
-    std::move(expr));
+  return arena.make<LETStatement>(originLine, var, expr);
 }
 
-std::unique_ptr<Statement> Parser::parsePrint(TokenStream& tokens,
-                              const std::string& originLine) const {
-  auto expr = parseExpression(tokens);
+Statement* Parser::parsePrint(TokenStream& tokens,
+                              std::string_view originLine,
+                              Arena& arena) const {
+  auto expr = parseExpression(tokens, arena);
   // TODO: create a corresponding stmt and return it.
-  return std::make_unique<PRINTStatement>(originLine, std::move(expr));
+  return arena.make<PRINTStatement>(originLine, expr);
 }
 
-std::unique_ptr<Statement> Parser::parseInput(TokenStream& tokens,
-                              const std::string& originLine) const {
+Statement* Parser::parseInput(TokenStream& tokens,
+                              std::string_view originLine,
+                              Arena& arena) const {
   if (tokens.empty()) {
     throw BasicError("SYNTAX ERROR");
   }
@@ -122,13 +136,14 @@ std::unique_ptr<Statement> Parser::parseInput(TokenStream& tokens,
     throw BasicError("SYNTAX ERROR");
   }
 
-  std::string varName = varToken->text;
+  int var = symbols_->intern(varToken->text);
   // TODO: create a corresponding stmt and return it.
-  return std::make_unique<INPUTStatement>(originLine, varName);
+  return arena.make<INPUTStatement>(originLine, var);
 }
 
-std::unique_ptr<Statement> Parser::parseGoto(TokenStream& tokens,
-                             const std::string& originLine) const {
+Statement* Parser::parseGoto(TokenStream& tokens,
+                              std::string_view originLine,
+                              Arena& arena) const {
   if (tokens.empty()) {
     throw BasicError("SYNTAX ERROR");
   }
@@ -140,13 +155,14 @@ std::unique_ptr<Statement> Parser::parseGoto(TokenStream& tokens,
 
   int targetLine = parseLiteral(lineToken);
   // TODO: create a corresponding stmt and return it.
-  return std::make_unique<GOTOStatement>(originLine, targetLine);
+  return arena.make<GOTOStatement>(originLine, targetLine);
 }
 
-std::unique_ptr<Statement> Parser::parseIf(TokenStream& tokens,
-                           const std::string& originLine) const {
+Statement* Parser::parseIf(TokenStream& tokens,
+                              std::string_view originLine,
+                              Arena& arena) const {
   // 解析左表达式
-  auto leftExpr = parseExpression(tokens);
+  auto leftExpr = parseExpression(tokens, arena);
 
   if (tokens.empty()) {
     throw BasicError("SYNTAX ERROR");
@@ -170,7 +186,7 @@ std::unique_ptr<Statement> Parser::parseIf(TokenStream& tokens,
   }
 
   // 解析右表达式
-  auto rightExpr = parseExpression(tokens);
+  auto rightExpr = parseExpression(tokens, arena);
 
   // 检查THEN关键字
   if (tokens.empty() || tokens.get()->type != TokenType::THEN) {
@@ -190,33 +206,39 @@ std::unique_ptr<Statement> Parser::parseIf(TokenStream& tokens,
   int targetLine = parseLiteral(lineToken);
 
   // TODO: create a corresponding stmt and return it.
-  return std::make_unique<IFStatement>(originLine, std::move(leftExpr),
-    std::move(rightExpr), op, targetLine);
+  return arena.make<IFStatement>(originLine, leftExpr, rightExpr, op,
+                                 targetLine);
 }
 
-std::unique_ptr<Statement> Parser::parseRem(TokenStream& tokens,
-                            const std::string& originLine) const {
+Statement* Parser::parseRem(TokenStream& tokens,
+                              std::string_view originLine,
+                              Arena& arena) const {
   const Token* remInfo = tokens.get();
   if (!remInfo || remInfo->type != TokenType::REMINFO) {
     throw BasicError("SYNTAX ERROR");
   }
   // TODO: create a corresponding stmt and return it.
-  return std::make_unique<REMStatement>(originLine);
+  return arena.make<REMStatement>(originLine);
 }
 
-std::unique_ptr<Statement> Parser::parseEnd(TokenStream& tokens,
-                            const std::string& originLine) const {
+Statement* Parser::parseEnd(TokenStream& tokens,
+                              std::string_view originLine,
+                              Arena& arena) const {
   // TODO: create a corresponding stmt and return it.
-  return std::make_unique<ENDStatement>(originLine);
+  return arena.make<ENDStatement>(originLine);
 }
 
-std::unique_ptr<Expression> Parser::parseExpression(TokenStream& tokens) const {
-  return parseExpression(tokens, 0);
+Expression* Parser::parseExpression(TokenStream& tokens, Arena& arena) const {
+  return parseExpression(tokens, 0, 0, arena);
 }
 
-std::unique_ptr<Expression> Parser::parseExpression(TokenStream& tokens, int precedence) const {
+// depth 为当前所在的括号层数，随调用传递，Parser 自身不保存解析状态。
+// 与标准程序不同：某行在括号内出错后，之后的行不会因残留的层数而接受多余的
+// 右括号，见 test/divergence/paren01。
+Expression* Parser::parseExpression(TokenStream& tokens, int precedence,
+                                    int depth, Arena& arena) const {
   // 解析左操作数
-  std::unique_ptr<Expression> left;
+  Expression* left = nullptr;
 
   if (tokens.empty()) {
     throw BasicError("SYNTAX ERROR");
@@ -229,17 +251,18 @@ std::unique_ptr<Expression> Parser::parseExpression(TokenStream& tokens, int pre
 
   if (token->type == TokenType::NUMBER) {
     int value = parseLiteral(token);
-    left = std::make_unique<ConstExpression>(value);
+    left = arena.make<ConstExpression>(value);
   } else if (token->type == TokenType::IDENTIFIER) {
-    left = std::make_unique<VariableExpression>(token->text);
+    left = arena.make<VariableExpression>(symbols_->intern(token->text));
   } else if (token->type == TokenType::LEFT_PAREN) {
-    ++leftParentCount;
-    left = parseExpression(tokens, 0);
+    if (depth >= kMaxDepth) {
+      throw BasicError("EXPRESSION TOO DEEP");
+    }
+    left = parseExpression(tokens, 0, depth + 1, arena);
 
     if (tokens.empty() || tokens.get()->type != TokenType::RIGHT_PAREN) {
       throw BasicError("MISMATCHED PARENTHESIS");
     }
-    --leftParentCount;
   } else {
     throw BasicError("SYNTAX ERROR");
   }
@@ -253,7 +276,7 @@ std::unique_ptr<Expression> Parser::parseExpression(TokenStream& tokens, int pre
 
     // 检查是否是右括号
     if (opToken->type == TokenType::RIGHT_PAREN) {
-      if (leftParentCount == 0) {
+      if (depth == 0) {
         throw BasicError("MISMATCHED PARENTHESIS");
       }
       break;
@@ -286,9 +309,8 @@ std::unique_ptr<Expression> Parser::parseExpression(TokenStream& tokens, int pre
     }
 
     // 解析右操作数，使用更高的优先级
-    auto right = parseExpression(tokens, opPrecedence + 1);
-    left = std::make_unique<CompoundExpression>(std::move(left),
-     op, std::move(right));
+    auto right = parseExpression(tokens, opPrecedence + 1, depth, arena);
+    left = arena.make<CompoundExpression>(left, op, right);
   }
 
   return left;
@@ -312,19 +334,16 @@ int Parser::parseLiteral(const Token* token) const {
     throw BasicError("SYNTAX ERROR");
   }
 
-  try {
-    size_t pos;
-    int value = std::stoi(token->text, &pos);
-
-    // 检查是否整个字符串都被解析
-    if (pos != token->text.length()) {
-      throw BasicError("INT LITERAL OVERFLOW");
-    }
-
-    return value;
-  } catch (const std::out_of_range&) {
-    throw BasicError("INT LITERAL OVERFLOW");
-  } catch (const std::invalid_argument&) {
+  const char* first = token->text.data();
+  const char* last = first + token->text.size();
+  int value = 0;
+  auto [end, ec] = std::from_chars(first, last, value);
+  if (ec == std::errc::invalid_argument) {
     throw BasicError("SYNTAX ERROR");
   }
+  // 超出 int 范围，或没有解析完整个字符串
+  if (ec == std::errc::result_out_of_range || end != last) {
+    throw BasicError("INT LITERAL OVERFLOW");
+  }
+  return value;
 }
\ No newline at end of file
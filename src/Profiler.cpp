@@ -0,0 +1,74 @@
+#include "Profiler.hpp"
+
+#include <cstdio>
+#include <ostream>
+#include <string>
+
+#include "Recorder.hpp"
+#include "Statement.hpp"
+
+namespace {
+
+// 统计之后程序行可能已被修改或删除，此时不输出语句文本。
+std::string textOf(const Recorder& recorder, int line) {
+  const Statement* stmt = recorder.get(line);
+  return stmt != nullptr ? stmt->text() : std::string();
+}
+
+}  // namespace
+
+void Profiler::reset(const Recorder& recorder) {
+  int size = recorder.size();
+  samples_.assign(size, Sample{0, 0, 0});
+  for (int index = 0; index < size; ++index) {
+    samples_[index].line = recorder.lineAt(index);
+  }
+}
+
+const std::vector<Profiler::Sample>& Profiler::samples() const noexcept {
+  return samples_;
+}
+
+void Profiler::report(std::ostream& out, const Recorder& recorder) const {
+  std::uint64_t total = 0;
+  for (const Sample& sample : samples_) {
+    total += sample.nanos;
+  }
+  char row[96];
+  std::snprintf(row, sizeof(row), "%8s %12s %14s %7s\n", "LINE", "COUNT",
+                "NS", "%");
+  out << row;
+  for (const Sample& sample : samples_) {
+    if (sample.count == 0) {
+      continue;
+    }
+    double percent = total != 0 ? 100.0 * sample.nanos / total : 0;
+    std::snprintf(row, sizeof(row), "%8d %12llu %14llu %7.2f  ", sample.line,
+                  static_cast<unsigned long long>(sample.count),
+                  static_cast<unsigned long long>(sample.nanos), percent);
+    out << row << textOf(recorder, sample.line) << "\n";
+  }
+  out.flush();
+}
+
+void Profiler::writeFolded(std::ostream& out,
+                           const Recorder& recorder) const {
+  for (const Sample& sample : samples_) {
+    if (sample.count == 0) {
+      continue;
+    }
+    // ';' 是折叠格式的栈分隔符，REM 注释中可能出现
+    std::string frame = std::to_string(sample.line);
+    std::string text = textOf(recorder, sample.line);
+    if (!text.empty()) {
+      frame += " " + text;
+    }
+    for (char& c : frame) {
+      if (c == ';') {
+        c = ',';
+      }
+    }
+    out << "RUN;" << frame << " " << sample.nanos << "\n";
+  }
+  out.flush();
+}
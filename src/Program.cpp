@@ -1,66 +1,357 @@
 #include "Program.hpp"
 
+#include <unistd.h>
+
+#include <algorithm>
 #include <iostream>
 
+#include "Compiler.hpp"
+#include "Image.hpp"
+#include "VM.hpp"
 #include "utils/Error.hpp"
 
 // TODO: Imply interfaces declared in the Program.hpp.
-Program::Program():programCounter_(0),programEnd_(false)
-{}
+Program::Program():Program(std::cout, STDIN_FILENO) {}
+
+Program::Program(std::ostream& out, int inputFd):programCounter_(0),programEnd_(false),
+  jumpTarget_(-1),linkedRevision_(0),linked_(false),engine_(Engine::BYTECODE),stream_(out),output_(out),input_(inputFd),bytecode_(nullptr),compiledRevision_(0),compiled_(false),countDispatches_(false),savedDispatches_(0),jitThreshold_(VM::kJitThreshold),index_(0),running_(false),waiting_(false),
+  jumpLimit_(0),timeLimit_(0),jumps_(0),elapsed_(0)
+{
+  input_.tie(&output_);
+}
+
+void Program::setEngine(Engine engine) noexcept {
+  engine_ = engine;
+}
+
+void Program::setProfiling(bool enabled) {
+  if (!enabled) {
+    profiler_.reset();
+  } else if (!profiler_) {
+    profiler_ = std::make_unique<Profiler>();
+  }
+  // 是否融合超级指令取决于是否逐行统计，需要重新编译
+  compiled_ = false;
+}
+
+void Program::setCountingDispatches(bool enabled) noexcept {
+  countDispatches_ = enabled;
+}
+
+void Program::setJit(bool enabled, int threshold) noexcept {
+  jitThreshold_ = enabled ? threshold : 0;
+}
 
-void Program::addStmt(int line, Statement* stmt) {
+void Program::setLimits(std::uint64_t jumps, std::chrono::nanoseconds time) noexcept {
+  jumpLimit_ = jumps;
+  timeLimit_ = time;
+}
+
+std::uint64_t Program::savedDispatches() const noexcept {
+  return savedDispatches_;
+}
+
+std::size_t Program::fusedInstructions() const noexcept {
+  return engine_ == Engine::BYTECODE && compiled_ ? compiler_.fusedInstructions() : 0;
+}
+
+void Program::addStmt(int line, StatementPtr stmt) {
+  running_ = false;
   if (line <= 0) {
     throw BasicError("SYNTAX ERROR");
   }
   if (stmt == nullptr) {
     throw BasicError("SYNTAX ERROR");
   }
-  recorder_.add(line, stmt);
+  recorder_.add(line, std::move(stmt));
 }
 
 void Program::removeStmt(int line) {
+  running_ = false;
   recorder_.remove(line);
 }
 
+void Program::addStmts(std::vector<Recorder::Entry> batch) {
+  running_ = false;
+  recorder_.addBatch(std::move(batch));
+}
+
+SymbolTable& Program::symbols() noexcept {
+  return symbols_;
+}
+
+VarState& Program::variables() noexcept {
+  return vars_;
+}
+
+Output& Program::output() noexcept {
+  return output_;
+}
+
+Input& Program::input() noexcept {
+  return input_;
+}
+
 void Program::run() {
-  resetAfterRun();
-  programCounter_ = recorder_.nextLine(programCounter_);
-  if (programCounter_ != -1) {
-    while (!programEnd_) {
-      const Statement* curStmt = recorder_.get(programCounter_);
-      if (!curStmt) {
-        throw BasicError("SYNTAX ERROR");
-      }
+  start();
+  while (resume(VM::kUnlimited) == Status::YIELDED) {
+  }
+}
 
-      int prePC = programCounter_;
-      curStmt->execute(vars_, *this);
-      if (programCounter_ == prePC) {
-        int nextLine = recorder_.nextLine(programCounter_);
-        if (nextLine == -1) {
-          programEnd_ = true;
-        } else {
-          programCounter_ = nextLine;
+void Program::start() {
+  // 先写出此前的输出，程序不结束时它们也已可见
+  output_.flush();
+  savedDispatches_ = 0;
+  input_.setAwaiting(false);
+  waiting_ = false;
+  jumps_ = 0;
+  elapsed_ = std::chrono::nanoseconds::zero();
+  if (profiler_) {
+    profiler_->reset(recorder_);
+  }
+  if (engine_ == Engine::TREE) {
+    // 程序被修改后重新链接跳转目标
+    if (!linked_ || linkedRevision_ != recorder_.revision()) {
+      recorder_.link();
+      linkedRevision_ = recorder_.revision();
+      linked_ = true;
+    }
+    resetAfterRun();
+    index_ = 0;
+  } else {
+    compileBytecode();
+    vm_.setJitThreshold(jitThreshold_);
+    vm_.start(*bytecode_, profiler_.get(),
+              countDispatches_ ? &savedDispatches_ : nullptr);
+  }
+  running_ = true;
+}
+
+Program::Status Program::resume(std::uint64_t budget) {
+  return proceed(budget, std::chrono::nanoseconds::zero());
+}
+
+Program::Status Program::resumeFor(std::chrono::nanoseconds time, std::uint64_t budget) {
+  return proceed(budget, time);
+}
+
+Program::Status Program::proceed(std::uint64_t budget, std::chrono::nanoseconds time) {
+  if (!running_) {
+    return Status::FINISHED;
+  }
+  // 出错时先写出已缓冲的输出，再由调用方输出错误信息
+  Status status;
+  try {
+    if (time.count() == 0 && timeLimit_.count() == 0) {
+      status = advance(budget);
+    } else {
+      // 不计时的执行不读时钟；计时的执行分成小段，段与段之间读一次时钟
+      using Clock = std::chrono::steady_clock;
+      Clock::time_point begin = Clock::now();
+      Clock::time_point last = begin;
+      do {
+        std::uint64_t chunk = std::min(budget, kClockInterval);
+        std::uint64_t left = chunk;
+        status = advance(left);
+        budget -= chunk - left;
+        Clock::time_point now = Clock::now();
+        elapsed_ += now - last;
+        last = now;
+        if (status != Status::YIELDED) {
+          break;
+        }
+        if (timeLimit_.count() != 0 && elapsed_ >= timeLimit_) {
+          throw BasicError("TIME LIMIT EXCEEDED");
+        }
+        if (time.count() != 0 && now - begin >= time) {
+          break;
         }
+      } while (budget != 0);
+    }
+  } catch (...) {
+    running_ = false;
+    output_.flush();
+    throw;
+  }
+  running_ = status != Status::FINISHED;
+  output_.flush();
+  return status;
+}
+
+bool Program::running() const noexcept {
+  return running_;
+}
+
+Program::Status Program::advance(std::uint64_t& budget) {
+  // 跳转上限不超过本段预算时只给到上限，用完即超出上限
+  std::uint64_t allowed = budget;
+  bool capped = jumpLimit_ != 0 && jumpLimit_ - jumps_ <= budget;
+  if (capped) {
+    allowed = jumpLimit_ - jumps_;
+  }
+  std::uint64_t left = allowed;
+  Status status;
+  if (engine_ == Engine::TREE) {
+    status = profiler_ ? runTree<true>(left) : runTree<false>(left);
+  } else {
+    status = vm_.resume(vars_, output_, input_, left);
+  }
+  jumps_ += allowed - left;
+  budget -= allowed - left;
+  if (capped && status == Status::YIELDED && left == 0) {
+    throw BasicError("JUMP LIMIT EXCEEDED");
+  }
+  return status;
+}
+
+void Program::compileBytecode() {
+  // 程序未被修改时复用上一次的编译结果
+  if (!compiled_ || compiledRevision_ != recorder_.revision()) {
+    // 超级指令会合并相邻行的指令，逐行统计时保留每行独立的首条指令
+    compiler_.setSuperinstructions(!profiler_);
+    bytecode_ = &compiler_.compile(recorder_);
+    recorder_.clearDirty();
+    compiledRevision_ = recorder_.revision();
+    compiled_ = true;
+  }
+}
+
+template <bool Profile>
+Program::Status Program::runTree(std::uint64_t& remaining) {
+  int size = recorder_.size();
+  if (size == 0 || remaining == 0) {
+    return size == 0 ? Status::FINISHED : Status::YIELDED;
+  }
+  std::uint64_t budget = remaining;
+  int index = index_;
+  std::uint64_t since = 0;
+  if constexpr (Profile) {
+    since = Profiler::now();
+  }
+  while (!programEnd_) {
+    programCounter_ = recorder_.lineAt(index);
+    const Statement* curStmt = recorder_.stmtAt(index);
+
+    int prePC = programCounter_;
+    if constexpr (Profile) {
+      // 等待输入后重新执行的 INPUT 不重复计数
+      if (!input_.awaiting()) {
+        profiler_->count(index);
       }
+      // 出错的语句同样计入耗时
+      try {
+        curStmt->execute(vars_, *this);
+      } catch (...) {
+        profiler_->charge(index, Profiler::now() - since);
+        throw;
+      }
+      std::uint64_t now = Profiler::now();
+      profiler_->charge(index, now - since);
+      since = now;
+    } else {
+      curStmt->execute(vars_, *this);
+    }
+    if (waiting_) {
+      waiting_ = false;
+      index_ = index;
+      remaining = budget;
+      return Status::WAITING;
     }
+    if (programCounter_ == prePC) {
+      // 行表连续存放，下一行即下一个下标
+      if (++index == size) {
+        programEnd_ = true;
+      }
+    } else {
+      // 跳转已直接给出目标行下标，无需再查 Recorder；
+      // 向后的跳转消耗一次预算，用完时停在目标行
+      bool backward = jumpTarget_ <= index;
+      index = jumpTarget_;
+      if (backward && --budget == 0) {
+        index_ = index;
+        remaining = 0;
+        return Status::YIELDED;
+      }
+    }
+  }
+  remaining = budget;
+  return Status::FINISHED;
+}
+
+void Program::list() {
+  recorder_.printLines(output_);
+}
+
+void Program::profile() {
+  if (profiler_) {
+    output_.flush();
+    profiler_->report(stream_, recorder_);
+  }
+}
+
+void Program::writeProfile(std::ostream& out) const {
+  if (profiler_) {
+    profiler_->writeFolded(out, recorder_);
   }
-  else return;
 }
 
-void Program::list() const {
-  recorder_.printLines();
+void Program::saveImage(const std::string& path) const {
+  Image::save(path, recorder_, symbols_);
+}
+
+void Program::loadImage(const std::string& path) {
+  running_ = false;
+  auto image = std::make_unique<Image>(path);
+  std::vector<Recorder::Entry> batch = image->load(symbols_);
+  images_.push_back(std::move(image));
+  addStmts(std::move(batch));
 }
 
 void Program::clear() {
+  running_ = false;
   recorder_.clear();
+  images_.clear();
   vars_.clear();
 }
 
-void Program::execute(Statement* stmt) {
+Program::Status Program::execute(Statement* stmt) {
   if (!stmt) {
-    return;
+    return Status::FINISHED;
   }
-  stmt->execute(vars_, *this);
+  stmt->link(recorder_);
+  try {
+    stmt->execute(vars_, *this);
+  } catch (...) {
+    output_.flush();
+    throw;
+  }
+  output_.flush();
+  if (waiting_) {
+    waiting_ = false;
+    return Status::WAITING;
+  }
+  return Status::FINISHED;
+}
+
+std::size_t Program::memoryUsage() const {
+  std::size_t bytes = sizeof(*this) + recorder_.memoryUsage() +
+                      symbols_.memoryUsage() + vars_.memoryUsage() +
+                      input_.memoryUsage() + output_.memoryUsage();
+  for (const auto& image : images_) {
+    bytes += sizeof(Image) + image->memoryUsage();
+  }
+  if (compiled_) {
+    bytes += bytecode_->code.capacity() * sizeof(Instruction) +
+             bytecode_->labels.capacity() * sizeof(int) +
+             bytecode_->fused.capacity() * sizeof(FusedOperands) +
+             bytecode_->lineStarts.capacity() * sizeof(int);
+    for (const CountedLoop& loop : bytecode_->loops) {
+      bytes += sizeof(CountedLoop) +
+               loop.body.capacity() * sizeof(Instruction) +
+               loop.slots.capacity() * sizeof(int);
+    }
+  }
+  return bytes;
 }
 
 int Program::getPC() const noexcept {
@@ -79,10 +370,24 @@ void Program::changePC(int line) {
   programCounter_ = line;
 }
 
+void Program::jump(int line, int target) {
+  if (target < 0) {
+    // 与 changePC 报告相同的错误
+    changePC(line);
+    return;
+  }
+  programCounter_ = line;
+  jumpTarget_ = target;
+}
+
 void Program::programEnd() {
   programEnd_ = true;
 }
 
+void Program::waitForInput() noexcept {
+  waiting_ = true;
+}
+
 void Program::resetAfterRun() noexcept {
   programCounter_ = -1;
   programEnd_ = false;
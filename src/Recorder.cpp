@@ -2,18 +2,15 @@
 
 #include "Recorder.hpp"
 
-#include <iostream>
+#include <algorithm>
+#include <iterator>
+#include <string>
 
+#include "Arena.hpp"
+#include "Output.hpp"
 #include "utils/Error.hpp"
 
-Recorder::~Recorder() {
-  for (auto &[line, stmt] : lineToStmt) {
-    delete stmt;
-  }
-  lineToStmt.clear();
-}
-
-void Recorder::add(int line, Statement* stmt) {
+void Recorder::add(int line, StatementPtr stmt) {
   if (line <= 0) {
     throw BasicError("SYNTAX ERROR");
   }
@@ -21,46 +18,199 @@ void Recorder::add(int line, Statement* stmt) {
     throw BasicError("SYNTAX ERROR");
   }
 
-  auto it = lineToStmt.find(line);
-  if (it != lineToStmt.end()) {
-    delete it->second;
-    lineToStmt.erase(it);
+  ++revision_;
+  dirty_.push_back(line);
+  // 按行号递增输入是最常见的情形，直接追加
+  if (pending_.empty() && (lines_.empty() || line > lines_.back().line)) {
+    lines_.push_back(Entry{line, std::move(stmt)});
+    return;
+  }
+  if (pending_.empty()) {
+    auto it = find(line);
+    if (it != lines_.end()) {
+      // 覆盖时旧语句的 Arena 整体释放
+      lines_[it - lines_.begin()].stmt = std::move(stmt);
+      return;
+    }
+  }
+  pending_.push_back(Entry{line, std::move(stmt)});
+}
+
+void Recorder::addBatch(std::vector<Entry> batch) {
+  if (batch.empty()) {
+    return;
+  }
+  for (const Entry& entry : batch) {
+    dirty_.push_back(entry.line);
   }
-  lineToStmt.emplace(line, stmt);
+  flush();
+  merge(batch);
+  ++revision_;
 }
 
 void Recorder::remove(int line) {
-  auto it = lineToStmt.find(line);
-  if (it != lineToStmt.end()) {
-    delete it->second;
-    lineToStmt.erase(it);
+  flush();
+  auto it = find(line);
+  if (it != lines_.end()) {
+    lines_.erase(it);
+    ++revision_;
+    dirty_.push_back(line);
   }
 }
 
-const Statement* Recorder::get(int line) const noexcept {
-  auto it = lineToStmt.find(line);
-  return (it != lineToStmt.end()) ? it->second : nullptr;
+const Statement* Recorder::get(int line) const {
+  flush();
+  auto it = find(line);
+  return (it != lines_.end()) ? it->stmt.get() : nullptr;
 }
 
-bool Recorder::hasLine(int line) const noexcept {
-  return lineToStmt.count(line) > 0;
+bool Recorder::hasLine(int line) const {
+  flush();
+  return find(line) != lines_.end();
 }
 
 void Recorder::clear() noexcept {
-  for (auto& [line, stmt] : lineToStmt) {
-    delete stmt;
-  }
-  lineToStmt.clear();
+  lines_.clear();
+  pending_.clear();
+  ++revision_;
+  dirty_.clear();
+  allDirty_ = true;
 }
 
-void Recorder::printLines() const {
-  for (auto& [line, stmt] : lineToStmt) {
-    std::cout << line << " " << stmt->text() << std::endl;
+void Recorder::printLines(Output& output) const {
+  flush();
+  for (auto& entry : lines_) {
+    output.write(std::to_string(entry.line));
+    output.write(" ");
+    output.write(entry.stmt->text());
+    output.write("\n");
   }
   return;
 }
 
-int Recorder::nextLine(int line) const noexcept {
-  auto it = lineToStmt.upper_bound(line);
-  return (it != lineToStmt.end()) ? it->first : -1;
-}
\ No newline at end of file
+std::size_t Recorder::memoryUsage() const {
+  std::size_t bytes = (lines_.capacity() + pending_.capacity()) * sizeof(Entry);
+  auto addArenas = [&](const std::vector<Entry>& entries) {
+    for (const Entry& entry : entries) {
+      // 载入映像的语句共用映像的 Arena，由 Image 计入
+      if (Arena* arena = entry.stmt.get_deleter().arena) {
+        bytes += sizeof(Arena) + arena->bytesUsed();
+      }
+    }
+  };
+  addArenas(lines_);
+  addArenas(pending_);
+  return bytes;
+}
+
+int Recorder::nextLine(int line) const {
+  flush();
+  auto it = std::upper_bound(
+      lines_.begin(), lines_.end(), line,
+      [](int value, const Entry& entry) { return value < entry.line; });
+  return (it != lines_.end()) ? it->line : -1;
+}
+
+unsigned Recorder::revision() const noexcept { return revision_; }
+
+const std::vector<int>& Recorder::dirtyLines() const noexcept {
+  return dirty_;
+}
+
+bool Recorder::allDirty() const noexcept { return allDirty_; }
+
+void Recorder::clearDirty() noexcept {
+  dirty_.clear();
+  allDirty_ = false;
+}
+
+void Recorder::link() {
+  flush();
+  for (auto& entry : lines_) {
+    entry.stmt->link(*this);
+  }
+}
+
+int Recorder::size() const {
+  flush();
+  return static_cast<int>(lines_.size());
+}
+
+int Recorder::indexOf(int line) const {
+  flush();
+  auto it = find(line);
+  return (it != lines_.end()) ? static_cast<int>(it - lines_.begin()) : -1;
+}
+
+int Recorder::lineAt(int index) const { return lines_[index].line; }
+
+const Statement* Recorder::stmtAt(int index) const {
+  return lines_[index].stmt.get();
+}
+
+void Recorder::flush() const {
+  if (pending_.empty()) {
+    return;
+  }
+  // 交互编辑时只有几行，逐行插入只移动其后的行，不必重建整个行表
+  if (pending_.size() <= kDirectInserts) {
+    for (Entry& entry : pending_) {
+      auto it = std::lower_bound(
+          lines_.begin(), lines_.end(), entry.line,
+          [](const Entry& e, int value) { return e.line < value; });
+      if (it != lines_.end() && it->line == entry.line) {
+        it->stmt = std::move(entry.stmt);
+      } else {
+        lines_.insert(it, std::move(entry));
+      }
+    }
+  } else {
+    merge(pending_);
+  }
+  pending_.clear();
+}
+
+void Recorder::merge(std::vector<Entry>& batch) const {
+  // 载入映像或有序源文件时行表为空、新行严格递增且没有删除，直接接管
+  if (lines_.empty() &&
+      std::adjacent_find(batch.begin(), batch.end(),
+                         [](const Entry& a, const Entry& b) {
+                           return a.line >= b.line;
+                         }) == batch.end() &&
+      std::all_of(batch.begin(), batch.end(),
+                  [](const Entry& entry) { return entry.stmt != nullptr; })) {
+    lines_.swap(batch);
+    return;
+  }
+  // 同一行多次出现时保留最后一次
+  std::stable_sort(
+      batch.begin(), batch.end(),
+      [](const Entry& a, const Entry& b) { return a.line < b.line; });
+  std::vector<Entry> merged;
+  merged.reserve(lines_.size() + batch.size());
+  auto old = lines_.begin();
+  for (auto it = batch.begin(); it != batch.end(); ++it) {
+    if (std::next(it) != batch.end() && std::next(it)->line == it->line) {
+      continue;
+    }
+    while (old != lines_.end() && old->line < it->line) {
+      merged.push_back(std::move(*old++));
+    }
+    if (old != lines_.end() && old->line == it->line) {
+      ++old;
+    }
+    // 最后一次是删除时，旧行与新行都不保留
+    if (it->stmt) {
+      merged.push_back(std::move(*it));
+    }
+  }
+  std::move(old, lines_.end(), std::back_inserter(merged));
+  lines_ = std::move(merged);
+}
+
+std::vector<Recorder::Entry>::const_iterator Recorder::find(int line) const {
+  auto it = std::lower_bound(
+      lines_.begin(), lines_.end(), line,
+      [](const Entry& entry, int value) { return entry.line < value; });
+  return (it != lines_.end() && it->line == line) ? it : lines_.end();
+}
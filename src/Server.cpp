@@ -0,0 +1,468 @@
+#include "Server.hpp"
+
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <exception>
+#include <sstream>
+
+#include "utils/Error.hpp"
+
+// 每个连接的状态。session 与 out 只由正在服务它的工作线程访问（scheduled
+// 保证同时只有一个），fd、reading 与 writable 只由事件循环线程访问，
+// 其余字段由 mutex 保护。
+struct Server::Connection {
+  Connection(int fd, const Session::Options& options)
+      : fd(fd), session(options, out, -1) {}
+
+  int fd;
+  bool reading{true};
+  bool writable{false};
+
+  std::ostringstream out;
+  Session session;
+  // 输入结束已告知 session
+  bool closedInput{false};
+
+  std::mutex mutex;
+  std::string inbox;
+  std::string outbox;
+  bool eof{false};
+  bool scheduled{false};
+  bool throttled{false};
+  // 收到 QUIT 或输入结束，写完 outbox 后关闭
+  bool finished{false};
+  bool closed{false};
+  // 当前命令从何时起可以执行；timing 为假时没有等待执行的命令
+  bool timing{false};
+  Clock::time_point since;
+  // inbox 由空变为非空的时刻
+  Clock::time_point arrived;
+};
+
+Server::Server(const Options& options) : options_(options) {
+  // 会话输出先写入内存，由事件循环整块发出
+  options_.session.lineBuffered = false;
+  // 各连接彼此隔离，不能读写服务进程可访问的文件，也不共用 PROFILE 的转储文件
+  options_.session.fileCommands = false;
+  options_.session.report = [this](Session& session, Output& output) {
+    report(session, output);
+  };
+  latencies_.reserve(kLatencySamples);
+
+  auto fail = [this] {
+    int error = errno;
+    for (int fd : {listenFd_, epollFd_, wakeFd_}) {
+      if (fd >= 0) {
+        ::close(fd);
+      }
+    }
+    throw BasicError("CANNOT LISTEN ON " + options_.path + ": " +
+                     std::strerror(error));
+  };
+
+  sockaddr_un address{};
+  address.sun_family = AF_UNIX;
+  if (options_.path.empty() ||
+      options_.path.size() >= sizeof(address.sun_path)) {
+    errno = ENAMETOOLONG;
+    fail();
+  }
+  std::memcpy(address.sun_path, options_.path.c_str(), options_.path.size());
+  // 只替换上次留下的套接字，不删除同名的普通文件
+  struct stat info;
+  if (::stat(options_.path.c_str(), &info) == 0 && S_ISSOCK(info.st_mode)) {
+    ::unlink(options_.path.c_str());
+  }
+
+  listenFd_ = ::socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+  if (listenFd_ < 0 ||
+      ::bind(listenFd_, reinterpret_cast<sockaddr*>(&address),
+             sizeof(address)) != 0 ||
+      ::listen(listenFd_, SOMAXCONN) != 0) {
+    fail();
+  }
+  epollFd_ = ::epoll_create1(EPOLL_CLOEXEC);
+  wakeFd_ = ::eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+  if (epollFd_ < 0 || wakeFd_ < 0) {
+    fail();
+  }
+  for (int fd : {listenFd_, wakeFd_}) {
+    epoll_event event{};
+    event.events = EPOLLIN;
+    event.data.fd = fd;
+    if (::epoll_ctl(epollFd_, EPOLL_CTL_ADD, fd, &event) != 0) {
+      fail();
+    }
+  }
+  pool_ = std::make_unique<ThreadPool>(options_.workers);
+}
+
+Server::~Server() {
+  // 先让进行中的任务不再排队，再等线程池退出
+  stopping_ = true;
+  pool_.reset();
+  for (auto& [fd, connection] : connections_) {
+    ::close(fd);
+  }
+  ::close(wakeFd_);
+  ::close(epollFd_);
+  ::close(listenFd_);
+  ::unlink(options_.path.c_str());
+}
+
+void Server::run() {
+  epoll_event events[64];
+  while (!stopping_) {
+    int count = ::epoll_wait(epollFd_, events, 64, -1);
+    if (count < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      throw BasicError(std::string("SERVER ERROR: ") + std::strerror(errno));
+    }
+    for (int i = 0; i < count; ++i) {
+      int fd = events[i].data.fd;
+      if (fd == listenFd_) {
+        accept();
+      } else if (fd == wakeFd_) {
+        std::uint64_t value;
+        while (::read(wakeFd_, &value, sizeof(value)) > 0) {
+        }
+        std::vector<std::shared_ptr<Connection>> notices;
+        {
+          std::lock_guard<std::mutex> lock(noticeMutex_);
+          notices.swap(notices_);
+        }
+        for (const auto& connection : notices) {
+          if (connection->fd >= 0) {
+            send(connection);
+          }
+        }
+      } else {
+        // 同一批事件中可能已被关闭
+        auto found = connections_.find(fd);
+        if (found == connections_.end()) {
+          continue;
+        }
+        std::shared_ptr<Connection> connection = found->second;
+        if (events[i].events & (EPOLLHUP | EPOLLERR)) {
+          drop(connection);
+          continue;
+        }
+        if (events[i].events & EPOLLIN) {
+          receive(connection);
+        }
+        if (connection->fd >= 0 && (events[i].events & EPOLLOUT)) {
+          send(connection);
+        }
+      }
+    }
+  }
+  // 等正在执行的时间片结束；之后的任务看到 stopping_ 直接返回
+  pool_.reset();
+}
+
+void Server::stop() noexcept {
+  stopping_ = true;
+  wake();
+}
+
+Server::Stats Server::stats() {
+  std::vector<std::uint32_t> samples;
+  Stats stats{};
+  {
+    std::lock_guard<std::mutex> lock(statsMutex_);
+    samples = latencies_;
+    stats.sessions = sessions_;
+    stats.commands = commands_;
+  }
+  auto percentile = [&samples](double q) {
+    if (samples.empty()) {
+      return 0.0;
+    }
+    auto nth = samples.begin() +
+               static_cast<std::ptrdiff_t>(q * (samples.size() - 1));
+    std::nth_element(samples.begin(), nth, samples.end());
+    return *nth / 1000.0;
+  };
+  stats.p50 = percentile(0.50);
+  stats.p99 = percentile(0.99);
+  return stats;
+}
+
+void Server::accept() {
+  for (;;) {
+    int fd = ::accept4(listenFd_, nullptr, nullptr,
+                       SOCK_NONBLOCK | SOCK_CLOEXEC);
+    if (fd < 0) {
+      // EAGAIN 表示已取完；连接数超限等错误时留待下次
+      return;
+    }
+    auto connection = std::make_shared<Connection>(fd, options_.session);
+    epoll_event event{};
+    event.events = EPOLLIN;
+    event.data.fd = fd;
+    if (::epoll_ctl(epollFd_, EPOLL_CTL_ADD, fd, &event) != 0) {
+      ::close(fd);
+      continue;
+    }
+    connections_.emplace(fd, std::move(connection));
+    std::lock_guard<std::mutex> lock(statsMutex_);
+    ++sessions_;
+  }
+}
+
+void Server::receive(const std::shared_ptr<Connection>& connection) {
+  std::string data;
+  bool eof = false;
+  char buffer[64 * 1024];
+  for (;;) {
+    ssize_t count = ::read(connection->fd, buffer, sizeof(buffer));
+    if (count > 0) {
+      data.append(buffer, static_cast<std::size_t>(count));
+    } else if (count == 0) {
+      eof = true;
+      break;
+    } else if (errno == EINTR) {
+      continue;
+    } else if (errno == EAGAIN || errno == EWOULDBLOCK) {
+      break;
+    } else {
+      drop(connection);
+      return;
+    }
+  }
+  if (eof) {
+    // 对方只关闭了写端，仍要把输出写回去
+    connection->reading = false;
+    watch(*connection, connection->writable);
+  }
+  std::lock_guard<std::mutex> lock(connection->mutex);
+  if (!data.empty()) {
+    Clock::time_point now = Clock::now();
+    if (connection->inbox.empty()) {
+      connection->arrived = now;
+    }
+    if (!connection->timing) {
+      connection->timing = true;
+      connection->since = now;
+    }
+    connection->inbox += data;
+  }
+  connection->eof = connection->eof || eof;
+  schedule(connection);
+}
+
+void Server::send(const std::shared_ptr<Connection>& connection) {
+  std::unique_lock<std::mutex> lock(connection->mutex);
+  std::string& outbox = connection->outbox;
+  std::size_t sent = 0;
+  while (sent < outbox.size()) {
+    ssize_t count = ::send(connection->fd, outbox.data() + sent,
+                           outbox.size() - sent, MSG_NOSIGNAL | MSG_DONTWAIT);
+    if (count >= 0) {
+      sent += static_cast<std::size_t>(count);
+    } else if (errno == EINTR) {
+      continue;
+    } else if (errno == EAGAIN || errno == EWOULDBLOCK) {
+      break;
+    } else {
+      lock.unlock();
+      drop(connection);
+      return;
+    }
+  }
+  outbox.erase(0, sent);
+  if (!outbox.empty()) {
+    if (!connection->writable) {
+      watch(*connection, true);
+    }
+    return;
+  }
+  if (connection->writable) {
+    watch(*connection, false);
+  }
+  if (connection->finished) {
+    lock.unlock();
+    drop(connection);
+    return;
+  }
+  if (connection->throttled) {
+    connection->throttled = false;
+    schedule(connection);
+  }
+}
+
+void Server::drop(const std::shared_ptr<Connection>& connection) {
+  ::epoll_ctl(epollFd_, EPOLL_CTL_DEL, connection->fd, nullptr);
+  ::close(connection->fd);
+  connections_.erase(connection->fd);
+  connection->fd = -1;
+  {
+    std::lock_guard<std::mutex> lock(connection->mutex);
+    connection->closed = true;
+  }
+  std::lock_guard<std::mutex> lock(statsMutex_);
+  --sessions_;
+}
+
+void Server::watch(Connection& connection, bool writable) {
+  connection.writable = writable;
+  epoll_event event{};
+  event.events = (connection.reading ? EPOLLIN : 0u) |
+                 (writable ? EPOLLOUT : 0u);
+  event.data.fd = connection.fd;
+  ::epoll_ctl(epollFd_, EPOLL_CTL_MOD, connection.fd, &event);
+}
+
+void Server::wake() noexcept {
+  std::uint64_t one = 1;
+  // 计数器溢出前总会被事件循环读走，写失败也无妨
+  [[maybe_unused]] ssize_t written = ::write(wakeFd_, &one, sizeof(one));
+}
+
+void Server::schedule(const std::shared_ptr<Connection>& connection) {
+  if (connection->scheduled || connection->throttled ||
+      connection->finished || connection->closed || stopping_) {
+    return;
+  }
+  connection->scheduled = true;
+  pool_->submit([this, connection] { serve(connection); });
+}
+
+void Server::serve(const std::shared_ptr<Connection>& connection) {
+  std::string data;
+  bool eof;
+  {
+    std::lock_guard<std::mutex> lock(connection->mutex);
+    if (connection->closed || stopping_) {
+      connection->scheduled = false;
+      return;
+    }
+    data.swap(connection->inbox);
+    eof = connection->eof;
+  }
+  Session& session = connection->session;
+  Program& program = session.program();
+  if (!data.empty()) {
+    program.input().feed(data);
+  }
+  if (eof && !connection->closedInput) {
+    program.input().close();
+    connection->closedInput = true;
+  }
+
+  // 逐条处理已收到的命令：等待输入、RUN 用完时间片、处理了足够多的命令
+  // 或输出积压时结束这一轮
+  std::string produced;
+  bool again = false;
+  bool finished = false;
+  int commands = 0;
+  try {
+    while (!again && !finished) {
+      Session::Step step = session.step(options_.slice);
+      program.output().flush();
+      produced += connection->out.str();
+      connection->out.str(std::string());
+      if (step == Session::Step::DONE || step == Session::Step::QUIT) {
+        produced.push_back('\0');
+        Clock::time_point since;
+        bool timing;
+        {
+          std::lock_guard<std::mutex> lock(connection->mutex);
+          since = connection->since;
+          timing = connection->timing;
+          connection->since = Clock::now();
+        }
+        if (timing) {
+          record(since);
+        }
+        finished = step == Session::Step::QUIT;
+        again = ++commands == kCommandsPerTurn || produced.size() > kOutboxLimit;
+      } else if (step == Session::Step::END) {
+        finished = true;
+      } else if (step == Session::Step::YIELDED) {
+        again = true;
+      } else {
+        break;
+      }
+    }
+  } catch (const std::exception&) {
+    // 会话状态已不可信，写出已有的输出后关闭
+    finished = true;
+  }
+
+  {
+    std::lock_guard<std::mutex> lock(connection->mutex);
+    connection->outbox += produced;
+    connection->scheduled = false;
+    if (finished) {
+      connection->finished = true;
+    } else if (!connection->closed) {
+      if (!again) {
+        // 等待输入：期间到达的数据从到达时起计时
+        if (connection->inbox.empty()) {
+          connection->timing = false;
+        } else {
+          connection->since = connection->arrived;
+        }
+        again = !connection->inbox.empty() ||
+                (connection->eof && !connection->closedInput);
+      }
+      if (again) {
+        if (connection->outbox.size() > kOutboxLimit) {
+          connection->throttled = true;
+        } else {
+          schedule(connection);
+        }
+      }
+    }
+  }
+  if (!produced.empty() || finished) {
+    notify(connection);
+  }
+}
+
+void Server::notify(const std::shared_ptr<Connection>& connection) {
+  {
+    std::lock_guard<std::mutex> lock(noticeMutex_);
+    notices_.push_back(connection);
+  }
+  wake();
+}
+
+void Server::record(Clock::time_point since) {
+  auto elapsed = std::chrono::duration_cast<std::chrono::microseconds>(
+                     Clock::now() - since)
+                     .count();
+  auto sample = static_cast<std::uint32_t>(
+      std::min<long long>(elapsed, UINT32_MAX));
+  std::lock_guard<std::mutex> lock(statsMutex_);
+  if (latencies_.size() < kLatencySamples) {
+    latencies_.push_back(sample);
+  } else {
+    latencies_[commands_ % kLatencySamples] = sample;
+  }
+  ++commands_;
+}
+
+void Server::report(Session& session, Output& output) {
+  Stats stats = this->stats();
+  char latency[96];
+  std::snprintf(latency, sizeof(latency),
+                "latency p50: %.3f ms, p99: %.3f ms\n", stats.p50, stats.p99);
+  output.write("sessions: " + std::to_string(stats.sessions) + "\n");
+  output.write("session memory: " +
+               std::to_string(session.program().memoryUsage()) + " bytes\n");
+  output.write("commands: " + std::to_string(stats.commands) + "\n");
+  output.write(latency);
+}
@@ -0,0 +1,156 @@
+#include "Session.hpp"
+
+#include <fstream>
+#include <ostream>
+
+#include "Token.hpp"
+#include "utils/Error.hpp"
+
+Session::Session(const Options& options, std::ostream& out, int inputFd)
+    : options_(options), program_(out, inputFd), parser_(program_.symbols()) {
+  program_.setEngine(options.engine);
+  program_.setProfiling(options.profile || !options.profilePath.empty());
+  program_.setCountingDispatches(options.stats != nullptr);
+  program_.setJit(options.jitThreshold > 0, options.jitThreshold);
+  program_.setLimits(options.maxJumps, options.timeLimit);
+  program_.output().setLineBuffered(options.lineBuffered);
+  optimizer_.setEnabled(options.fold);
+}
+
+Program& Session::program() noexcept { return program_; }
+
+Lexer& Session::lexer() noexcept { return lexer_; }
+
+Parser& Session::parser() noexcept { return parser_; }
+
+Optimizer& Session::optimizer() noexcept { return optimizer_; }
+
+Session::Step Session::step(std::uint64_t budget) {
+  Output& output = program_.output();
+  try {
+    if (program_.running()) {
+      return finishRun(program_.resume(budget));
+    }
+    if (pending_) {
+      if (program_.execute(pending_.get()) == Program::Status::WAITING) {
+        return Step::WAITING;
+      }
+      pending_.reset();
+      return Step::DONE;
+    }
+    Input& input = program_.input();
+    if (input.wouldBlock()) {
+      return Step::IDLE;
+    }
+    // 读入的行直接指向输入缓冲区，语句解析时会把源文本复制进自己的 Arena
+    std::string_view line;
+    if (!input.readLine(line)) {
+      return Step::END;
+    }
+    return execute(line, budget);
+  } catch (const BasicError& e) {
+    // 与程序输出经过同一缓冲区，先后顺序不变
+    pending_.reset();
+    output.write(e.message());
+    output.write("\n");
+    return Step::DONE;
+  }
+}
+
+Session::Step Session::finishRun(Program::Status status) {
+  switch (status) {
+    case Program::Status::YIELDED:
+      return Step::YIELDED;
+    case Program::Status::WAITING:
+      return Step::WAITING;
+    case Program::Status::FINISHED:
+      break;
+  }
+  if (options_.stats != nullptr) {
+    *options_.stats << "superinstructions: " << program_.fusedInstructions()
+                    << ", dispatches saved: " << program_.savedDispatches()
+                    << "\n";
+  }
+  return Step::DONE;
+}
+
+Session::Step Session::execute(std::string_view line, std::uint64_t budget) {
+  if (line.empty()) {
+    return Step::DONE;
+  }
+  // 处理命令行
+  if (line == "LIST") {
+    program_.list();
+    return Step::DONE;
+  } else if (line == "RUN") {
+    program_.start();
+    return finishRun(program_.resume(budget));
+  } else if (line == "PROFILE") {
+    program_.profile();
+    if (options_.fileCommands && !options_.profilePath.empty()) {
+      std::ofstream dump(options_.profilePath);
+      program_.writeProfile(dump);
+    }
+    return Step::DONE;
+  } else if (line == "CLEAR") {
+    program_.clear();
+    return Step::DONE;
+  } else if (line.rfind("SAVE IMAGE ", 0) == 0) {
+    if (!options_.fileCommands) {
+      throw BasicError("SYNTAX ERROR");
+    }
+    program_.saveImage(std::string(line.substr(11)));
+    return Step::DONE;
+  } else if (line.rfind("LOAD IMAGE ", 0) == 0) {
+    if (!options_.fileCommands) {
+      throw BasicError("SYNTAX ERROR");
+    }
+    program_.loadImage(std::string(line.substr(11)));
+    return Step::DONE;
+  } else if (line == "STATS" && options_.report) {
+    options_.report(*this, program_.output());
+    return Step::DONE;
+  } else if (line == "QUIT") {
+    return Step::QUIT;
+  }
+
+  // 处理立即执行语句
+  std::string_view tmp = line.substr(0, 3);
+  if (tmp == "LET" || tmp == "PRI" || tmp == "INP") {
+    TokenStream tokens = lexer_.tokenize(line);
+    if (tokens.empty()) {
+      throw BasicError("SYNTAX ERROR");
+    }
+    std::unique_ptr<ParsedLine> parsedLine = parser_.parseLine(tokens, line);
+    StatementPtr stmt = parsedLine->fetchStatement();
+    optimizer_.optimize(stmt);
+    if (program_.execute(stmt.get()) == Program::Status::WAITING) {
+      pending_ = std::move(stmt);
+      return Step::WAITING;
+    }
+    return Step::DONE;
+  }
+
+  // 处理程序行
+  // 1.词法分析
+  TokenStream tokens = lexer_.tokenize(line);
+  if (tokens.empty()) {
+    throw BasicError("SYNTAX ERROR");
+  }
+  // 2.语法分析
+  std::unique_ptr<ParsedLine> parsedLine = parser_.parseLine(tokens, line);
+  // 3.解释执行
+  if (parsedLine->getLine().has_value()) {
+    int lineNum = parsedLine->getLine().value();
+    StatementPtr stmt = parsedLine->fetchStatement();
+    if (stmt) {
+      optimizer_.optimize(stmt);
+      program_.addStmt(lineNum, std::move(stmt));  // 连同 Arena 转移所有权给 Program
+    } else {
+      program_.removeStmt(lineNum);
+    }
+  } else {
+    throw BasicError("SYNTAX ERROR");
+  }
+  return Step::DONE;
+}
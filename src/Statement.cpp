@@ -5,14 +5,32 @@
 #include <sstream>
 #include <utility>
 
+#include "Arena.hpp"
+#include "Compiler.hpp"
+#include "Image.hpp"
+#include "Input.hpp"
+#include "Optimizer.hpp"
+#include "Output.hpp"
 #include "Program.hpp"
+#include "Recorder.hpp"
 #include "VarState.hpp"
 #include "utils/Error.hpp"
 
-Statement::Statement(std::string source) : source_(std::move(source)) {}
+Statement::Statement(std::string_view source) : source_(source) {}
+
+void StatementDeleter::operator()(Statement*) const noexcept { delete arena; }
+
+void Statement::link(const Recorder&) {}
+
+void Statement::optimize(Optimizer&) {}
+
+void Statement::remapSlots(const std::vector<int>&) {}
+
+void Statement::flatten(Arena&) {}
 
 const std::string& Statement::text() const noexcept {
-  static std::string txt;
+  // 每个线程一份，服务端的多个会话可以并行调用
+  thread_local std::string txt;
   txt.clear();
 
   size_t i = 0;
@@ -23,18 +41,20 @@ const std::string& Statement::text() const noexcept {
     ++i;
   }
 
-  txt = source_.substr(i);
+  txt = std::string(source_.substr(i));
 
   return txt;
 }
 
+std::string_view Statement::source() const noexcept { return source_; }
+
 // TODO: Imply interfaces declared in the Statement.hpp.
-LETStatement::LETStatement(std::string source,
-    std::string var,
-    std::unique_ptr<Expression> expr):
-  Statement(std::move(source)),
-  var(std::move(var)),
-  expr(std::move(expr))// 只能move，转移所有权
+LETStatement::LETStatement(std::string_view source,
+    int var,
+    Expression* expr):
+  Statement(source),
+  var(var),
+  expr(expr)// 表达式节点由语句所在的 Arena 持有
   {}
 
 void LETStatement::execute(VarState& state, Program& program) const {
@@ -42,75 +62,153 @@ void LETStatement::execute(VarState& state, Program& program) const {
   state.setValue(var, value);
 }
 
-PRINTStatement::PRINTStatement(std::string source,
-    std::unique_ptr<Expression> expr):
-  Statement(std::move(source)),
-  expr(std::move(expr))// 只能move，转移所有权
+void LETStatement::compile(Compiler& compiler) const {
+  expr->compile(compiler);
+  compiler.emit(OpCode::STORE, var);
+}
+
+void LETStatement::save(ImageWriter& image) const {
+  image.setStatement(Image::Kind::LET, var);
+  image.addExpression(expr);
+}
+
+void LETStatement::optimize(Optimizer& optimizer) {
+  expr = optimizer.fold(expr);
+}
+
+void LETStatement::flatten(Arena& arena) {
+  expr = PostfixExpression::flatten(expr, arena);
+}
+
+void LETStatement::remapSlots(const std::vector<int>& slots) {
+  var = slots[var];
+  expr->remapSlots(slots);
+}
+
+PRINTStatement::PRINTStatement(std::string_view source,
+    Expression* expr):
+  Statement(source),
+  expr(expr)// 表达式节点由语句所在的 Arena 持有
   {}
 
 void PRINTStatement::execute(VarState& state, Program& program) const {
   int value = expr->evaluate(state);
-  std::cout << value << std::endl;
+  program.output().printLine(value);
+}
+
+void PRINTStatement::compile(Compiler& compiler) const {
+  expr->compile(compiler);
+  compiler.emit(OpCode::PRINT);
 }
 
-INPUTStatement::INPUTStatement(std::string source,
-    std::string var):
-  Statement(std::move(source)),
-  var(std::move(var))
+void PRINTStatement::save(ImageWriter& image) const {
+  image.setStatement(Image::Kind::PRINT);
+  image.addExpression(expr);
+}
+
+void PRINTStatement::optimize(Optimizer& optimizer) {
+  expr = optimizer.fold(expr);
+}
+
+void PRINTStatement::flatten(Arena& arena) {
+  expr = PostfixExpression::flatten(expr, arena);
+}
+
+void PRINTStatement::remapSlots(const std::vector<int>& slots) {
+  expr->remapSlots(slots);
+}
+
+INPUTStatement::INPUTStatement(std::string_view source,
+    int var):
+  Statement(source),
+  var(var)
   {}
 
 void INPUTStatement::execute(VarState& state, Program& program) const {
-  bool valid = false;
-  while (!valid) {
-    std::string input;
-    std::cout << ' ' << '?' << ' ';
-    std::getline(std::cin,input);
-    bool flag = true;
-    int sign = 1;
-    int value = 0;
-    if (input[0] == '-') {
-      sign = -1;
-      input = input.substr(1);
+  int value;
+  switch (readValue(program.output(), program.input(), value)) {
+    case Read::VALUE:
+      state.setValue(var, value);
+      break;
+    case Read::END:
+      break;
+    case Read::WAIT:
+      program.waitForInput();
+      break;
+  }
+}
+
+void INPUTStatement::compile(Compiler& compiler) const {
+  compiler.emit(OpCode::INPUT, var);
+}
+
+void INPUTStatement::save(ImageWriter& image) const {
+  image.setStatement(Image::Kind::INPUT, var);
+}
+
+void INPUTStatement::remapSlots(const std::vector<int>& slots) {
+  var = slots[var];
+}
+
+INPUTStatement::Read INPUTStatement::readValue(Output& output, Input& input,
+                                               int& value) {
+  while (true) {
+    // 提示由 Input 在需要等待输入时写出，连续读入大量数据时不必逐个刷新；
+    // 等待之后重新执行时提示已经写过
+    if (!input.awaiting()) {
+      output.write(" ? ");
     }
-    for (auto c : input) {
-      if (c >= '0' && c <= '9') {
-        value = value * 10 + c - '0';
-        continue;
-      }
-      else {
-        flag = false;
-      }
+    if (input.wouldBlock()) {
+      input.setAwaiting(true);
+      return Read::WAIT;
     }
-    if (flag) {
-      state.setValue(var, value * sign);
-      valid = true;
+    input.setAwaiting(false);
+    std::string_view line;
+    if (!input.readLine(line)) {
+      return Read::END;
     }
-    else {
-      std::cout << "INVALID NUMBER" << std::endl;
+    if (std::optional<int> parsed = Input::parseInteger(line)) {
+      value = *parsed;
+      return Read::VALUE;
     }
+    output.write("INVALID NUMBER\n");
   }
 }
 
-GOTOStatement::GOTOStatement(std::string source,
+GOTOStatement::GOTOStatement(std::string_view source,
     int line):
-  Statement(std::move(source)),
-  line(std::move(line))
+  Statement(source),
+  line(std::move(line)),
+  target(-1)
 {}
 
 void GOTOStatement::execute(VarState& state, Program& program) const {
-  program.changePC(line);
+  program.jump(line, target);
+}
+
+void GOTOStatement::compile(Compiler& compiler) const {
+  compiler.emitJump(OpCode::JUMP, line);
+}
+
+void GOTOStatement::save(ImageWriter& image) const {
+  image.setStatement(Image::Kind::GOTO, line);
 }
 
-IFStatement::IFStatement(std::string source,
-    std::unique_ptr<Expression> expr1,
-    std::unique_ptr<Expression> expr2,
+void GOTOStatement::link(const Recorder& recorder) {
+  target = recorder.indexOf(line);
+}
+
+IFStatement::IFStatement(std::string_view source,
+    Expression* expr1,
+    Expression* expr2,
     char op,
     int line):
-  Statement(std::move(source)),
-  expr1(std::move(expr1)),
-  expr2(std::move(expr2)),
+  Statement(source),
+  expr1(expr1),
+  expr2(expr2),
   op(op),
-  line(line)
+  line(line),
+  target(-1)
 {}
 
 void IFStatement::execute(VarState& state, Program& program) const {
@@ -131,22 +229,79 @@ void IFStatement::execute(VarState& state, Program& program) const {
       throw BasicError("SYNTAX ERROR");
   }
   if (flag) {
-    program.changePC(line);
+    program.jump(line, target);
+  }
+}
+
+void IFStatement::compile(Compiler& compiler) const {
+  expr1->compile(compiler);
+  expr2->compile(compiler);
+  switch (op) {
+    case '=':
+      compiler.emitJump(OpCode::JUMP_EQ, line);
+      break;
+    case '>':
+      compiler.emitJump(OpCode::JUMP_GT, line);
+      break;
+    case '<':
+      compiler.emitJump(OpCode::JUMP_LT, line);
+      break;
+    default:
+      compiler.emit(OpCode::FAIL, static_cast<int>(FailCode::SYNTAX_ERROR));
   }
 }
 
-REMStatement::REMStatement(std::string source):
-  Statement(std::move(source))
+void IFStatement::save(ImageWriter& image) const {
+  image.setStatement(Image::Kind::IF, line, op);
+  image.addExpression(expr1);
+  image.addExpression(expr2);
+}
+
+void IFStatement::link(const Recorder& recorder) {
+  target = recorder.indexOf(line);
+}
+
+void IFStatement::flatten(Arena& arena) {
+  expr1 = PostfixExpression::flatten(expr1, arena);
+  expr2 = PostfixExpression::flatten(expr2, arena);
+}
+
+void IFStatement::optimize(Optimizer& optimizer) {
+  expr1 = optimizer.fold(expr1);
+  expr2 = optimizer.fold(expr2);
+}
+
+void IFStatement::remapSlots(const std::vector<int>& slots) {
+  expr1->remapSlots(slots);
+  expr2->remapSlots(slots);
+}
+
+REMStatement::REMStatement(std::string_view source):
+  Statement(source)
 {}
 
 void REMStatement::execute(VarState& state, Program& program) const {
   return;
 }
 
-ENDStatement::ENDStatement(std::string source):
-  Statement(std::move(source))
+void REMStatement::compile(Compiler& compiler) const {}
+
+void REMStatement::save(ImageWriter& image) const {
+  image.setStatement(Image::Kind::REM);
+}
+
+ENDStatement::ENDStatement(std::string_view source):
+  Statement(source)
 {}
 
 void ENDStatement::execute(VarState& state, Program& program) const {
   program.programEnd();
-}
\ No newline at end of file
+}
+
+void ENDStatement::compile(Compiler& compiler) const {
+  compiler.emit(OpCode::HALT);
+}
+
+void ENDStatement::save(ImageWriter& image) const {
+  image.setStatement(Image::Kind::END);
+}
@@ -0,0 +1,39 @@
+#include "SymbolTable.hpp"
+
+// 变量名通常很短，构造查找用的 std::string 落在 SSO 缓冲区内，不触发堆分配。
+int SymbolTable::intern(std::string_view name) {
+  std::string key(name);
+  auto it = slots_.find(key);
+  if (it != slots_.end()) {
+    return it->second;
+  }
+  int slot = static_cast<int>(names_.size());
+  names_.push_back(key);
+  slots_.emplace(std::move(key), slot);
+  return slot;
+}
+
+int SymbolTable::find(std::string_view name) const {
+  auto it = slots_.find(std::string(name));
+  return it != slots_.end() ? it->second : -1;
+}
+
+const std::string& SymbolTable::name(int slot) const { return names_.at(slot); }
+
+int SymbolTable::size() const noexcept {
+  return static_cast<int>(names_.size());
+}
+
+std::size_t SymbolTable::memoryUsage() const noexcept {
+  // 每个名字在数组与散列表中各存一份，散列表每项另有节点与桶的开销
+  std::size_t bytes = names_.capacity() * sizeof(std::string) +
+                      slots_.bucket_count() * sizeof(void*) +
+                      slots_.size() * (sizeof(std::string) + 2 * sizeof(void*) +
+                                       sizeof(int));
+  for (const std::string& name : names_) {
+    if (name.capacity() > 15) {
+      bytes += 2 * (name.capacity() + 1);
+    }
+  }
+  return bytes;
+}
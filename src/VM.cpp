@@ -0,0 +1,644 @@
+#include "VM.hpp"
+
+#include <algorithm>
+#include <climits>
+#include <memory>
+#include <vector>
+
+#include "Input.hpp"
+#include "Jit.hpp"
+#include "Output.hpp"
+#include "Profiler.hpp"
+#include "Statement.hpp"
+#include "VarState.hpp"
+#include "utils/Error.hpp"
+
+namespace {
+
+// 计数循环的快速路径。循环中有变量尚未定义、或计数器会溢出时返回 false，
+// 由普通字节码执行（并在同一处报错）。每轮跳回循环入口计一次跳转：
+// 预算不够执行完全部迭代时只执行 budget 轮，budget 减为 0，
+// 之后再次执行 LOOP 会按变量的当前值继续。
+bool runCountedLoop(const CountedLoop& loop, VarState& state,
+                    Output& output, std::uint64_t& budget) {
+  for (int slot : loop.slots) {
+    if (!state.isDefined(slot)) {
+      return false;
+    }
+  }
+  std::vector<int> registers(loop.slots.size());
+  for (std::size_t r = 0; r < registers.size(); ++r) {
+    registers[r] = state.getValue(loop.slots[r]);
+  }
+
+  // 计数器每轮恰好变化 step，第 k 轮结束时比较的是 start + k * step，
+  // 循环体至少执行一轮
+  long long start = registers[loop.counter];
+  long long limit = loop.limitIsRegister ? registers[loop.limit] : loop.limit;
+  long long step = loop.step;
+  long long distance = step > 0 ? limit - start : start - limit;
+  long long magnitude = step > 0 ? step : -step;
+  long long trips =
+      distance <= 0 ? 1 : (distance + magnitude - 1) / magnitude;
+  long long last = start + trips * step;
+  if (last > INT_MAX || last < INT_MIN) {
+    return false;
+  }
+  // 执行完全部 trips 轮只跳回 trips - 1 次
+  if (static_cast<std::uint64_t>(trips - 1) >= budget) {
+    trips = static_cast<long long>(budget);
+    budget = 0;
+  } else {
+    budget -= static_cast<std::uint64_t>(trips - 1);
+  }
+
+  // 出错时变量应与逐条执行到出错处时一致，全部寄存器写回即可：
+  // 进入时每个变量都已定义，寄存器里正是它们当前的值
+  auto writeBack = [&]() {
+    for (std::size_t r = 0; r < registers.size(); ++r) {
+      state.setValue(loop.slots[r], registers[r]);
+    }
+  };
+  std::vector<int> stack(loop.maxStack + 1);
+  int* regs = registers.data();
+  const Instruction* body = loop.body.data();
+  const Instruction* ins = body;
+  int* sp = stack.data();
+
+  try {
+#ifdef BASIC_THREADED_DISPATCH
+    // 循环体中只会出现前八种指令与标记一轮结束的 HALT
+    static const void* const kHandlers[] = {
+        &&body_PUSH, &&body_LOAD,  &&body_ADD,   &&body_SUB,
+        &&body_MUL,  &&body_DIV,   &&body_STORE, &&body_PRINT,
+        &&body_HALT, &&body_HALT,  &&body_HALT,  &&body_HALT,
+        &&body_HALT, &&body_HALT,  &&body_HALT,  &&body_HALT};
+#define BODY_CASE(name) body_##name
+#define BODY_NEXT()                             \
+  do {                                          \
+    ins++;                                      \
+    goto *kHandlers[static_cast<int>(ins->op)]; \
+  } while (false)
+
+    goto *kHandlers[static_cast<int>(ins->op)];
+    {
+#else
+#define BODY_CASE(name) case OpCode::name
+#define BODY_NEXT() \
+  ++ins;            \
+  continue
+
+    for (;;) {
+      switch (ins->op) {
+#endif
+        BODY_CASE(PUSH):
+          *sp++ = ins->operand;
+          BODY_NEXT();
+        BODY_CASE(LOAD):
+          *sp++ = regs[ins->operand];
+          BODY_NEXT();
+        BODY_CASE(ADD):
+          --sp;
+          sp[-1] = sp[-1] + sp[0];
+          BODY_NEXT();
+        BODY_CASE(SUB):
+          --sp;
+          sp[-1] = sp[-1] - sp[0];
+          BODY_NEXT();
+        BODY_CASE(MUL):
+          --sp;
+          sp[-1] = sp[-1] * sp[0];
+          BODY_NEXT();
+        BODY_CASE(DIV):
+          --sp;
+          if (sp[0] == 0) {
+            throw BasicError("DIVIDE BY ZERO");
+          }
+          if (sp[0] == -1 && sp[-1] == INT_MIN) {
+            throw BasicError("INTEGER OVERFLOW");
+          }
+          sp[-1] = sp[-1] / sp[0];
+          BODY_NEXT();
+        BODY_CASE(STORE):
+          regs[ins->operand] = *--sp;
+          BODY_NEXT();
+        BODY_CASE(PRINT):
+          output.printLine(*--sp);
+          BODY_NEXT();
+#ifdef BASIC_THREADED_DISPATCH
+        BODY_CASE(HALT):
+#else
+        default:
+#endif
+          if (--trips == 0) {
+            goto done;
+          }
+          ins = body;
+#ifdef BASIC_THREADED_DISPATCH
+          goto *kHandlers[static_cast<int>(ins->op)];
+    }
+#else
+          continue;
+      }
+    }
+#endif
+#undef BODY_CASE
+#undef BODY_NEXT
+  } catch (...) {
+    writeBack();
+    throw;
+  }
+done:
+  writeBack();
+  return true;
+}
+
+}  // namespace
+
+
+VM::VM() = default;
+
+VM::~VM() = default;
+
+void VM::setJitThreshold(int threshold) noexcept {
+  jitThreshold_ = threshold;
+}
+
+void VM::run(const Bytecode& bytecode, VarState& state, Output& output,
+             Input& input, Profiler* profiler, std::uint64_t* saved) {
+  start(bytecode, profiler, saved);
+  std::uint64_t budget;
+  do {
+    budget = kUnlimited;
+  } while (resume(state, output, input, budget) == Status::YIELDED);
+}
+
+void VM::start(const Bytecode& bytecode, Profiler* profiler,
+               std::uint64_t* saved) {
+  bytecode_ = &bytecode;
+  profiler_ = profiler;
+  saved_ = profiler != nullptr ? nullptr : saved;
+  resume_ = bytecode.entry;
+  depth_ = 0;
+  stack_.assign(bytecode.maxStack + 1, 0);
+  // 线索化代码在首段执行时按需重新生成或沿用
+  rearm_ = true;
+  current_ = -1;
+  reentering_ = false;
+}
+
+VM::Status VM::resume(VarState& state, Output& output, Input& input,
+                      std::uint64_t& budget) {
+  if (resume_ < 0) {
+    return Status::FINISHED;
+  }
+  if (budget == 0) {
+    return Status::YIELDED;
+  }
+  Status status;
+  try {
+    if (profiler_ != nullptr) {
+      status = execute<true, false>(state, output, input, budget);
+    } else if (saved_ != nullptr) {
+      status = execute<false, true>(state, output, input, budget);
+    } else {
+      status = execute<false, false>(state, output, input, budget);
+    }
+  } catch (...) {
+    resume_ = -1;
+    jit_.reset();
+    throw;
+  }
+  if (status == Status::FINISHED) {
+    resume_ = -1;
+    jit_.reset();
+  }
+  return status;
+}
+
+bool VM::running() const noexcept { return resume_ >= 0; }
+
+template <bool Profile, bool Count>
+VM::Status VM::execute(VarState& state, Output& output, Input& input,
+                       std::uint64_t& remaining) {
+  // 预算放在局部变量中，离开时写回剩余的次数
+  std::uint64_t budget = remaining;
+  const Bytecode& bytecode = *bytecode_;
+  Profiler* profiler = profiler_;
+  std::uint64_t* saved = saved_;
+  int* stack = stack_.data();
+  int* sp = stack + depth_;
+  const int* labels = bytecode.labels.data();
+
+  // 生成线索化代码与行表的实例：统计方式与是否编译机器码
+  int mode = (Profile ? 1 : 0) | (Count ? 2 : 0) | (jitThreshold_ > 0 ? 4 : 0);
+  bool current = translated_ == &bytecode && translatedMode_ == mode;
+  bool stale = !current || translatedRevision_ != bytecode.revision;
+  // 上次生成后只经过一次增量编译
+  bool patched = stale && current && bytecode.patch.base != 0 &&
+                 bytecode.patch.base == translatedRevision_;
+  translated_ = &bytecode;
+  translatedRevision_ = bytecode.revision;
+  translatedMode_ = mode;
+
+#ifdef BASIC_THREADED_DISPATCH
+  // 顺序与 OpCode 的定义一致
+  static const void* const kHandlers[] = {
+      &&op_PUSH,    &&op_LOAD,    &&op_ADD,     &&op_SUB,  &&op_MUL,
+      &&op_DIV,     &&op_STORE,   &&op_PRINT,   &&op_INPUT, &&op_JUMP,
+      &&op_JUMP_EQ, &&op_JUMP_GT, &&op_JUMP_LT, &&op_FAIL, &&op_HALT,
+      &&op_LOOP,    &&op_SKIP,
+      &&op_INC,
+      &&op_BRANCH_EQ,       &&op_BRANCH_GT,       &&op_BRANCH_LT,
+      &&op_INC_BRANCH_EQ,   &&op_INC_BRANCH_GT,   &&op_INC_BRANCH_LT,
+      &&op_STORE_BRANCH_EQ, &&op_STORE_BRANCH_GT, &&op_STORE_BRANCH_LT};
+  auto thread = [](const Instruction& source) {
+    return ThreadedInstruction{kHandlers[static_cast<int>(source.op)],
+                               source.operand, source.backward};
+  };
+#ifdef BASIC_JIT
+  bool jit = !Profile && !Count && jitThreshold_ > 0;
+  // 热点区域的入口是向后跳转的目标。入口指令先换成计数的 HOT，执行次数
+  // 达到阈值后编译从这里开始的区域，成功则换成进入机器码的 JIT。
+  auto addHeads = [&](int from, std::vector<int>& heads) {
+    for (int i = from, size = static_cast<int>(bytecode.code.size()); i < size;
+         ++i) {
+      const Instruction& source = bytecode.code[i];
+      int label;
+      if (!source.backward) {
+        continue;
+      } else if (source.op >= OpCode::JUMP && source.op <= OpCode::JUMP_LT) {
+        label = source.operand;
+      } else if (source.op >= OpCode::BRANCH_EQ) {
+        label = bytecode.fused[source.operand].target;
+      } else {
+        continue;
+      }
+      // 跳到报错的桩时不必编译
+      if (bytecode.code[labels[label]].op != OpCode::FAIL) {
+        heads.push_back(labels[label]);
+      }
+    }
+  };
+  // 各入口恢复为计数的 HOT；标签地址只能在本函数中取得
+  const void* hot = &&op_HOT;
+  auto rearm = [&]() {
+    for (std::size_t i = 0; i < entries_.size(); ++i) {
+      JitEntry& entry = entries_[i];
+      entry.count = 0;
+      entry.region = -1;
+      threaded_[entry.position] = {hot, static_cast<int>(i), false};
+    }
+  };
+#endif
+  if (stale && !patched) {
+    entries_.clear();
+    jit_.reset();
+    threaded_.resize(bytecode.code.size());
+    for (std::size_t i = 0; i < threaded_.size(); ++i) {
+      threaded_[i] = thread(bytecode.code[i]);
+    }
+#ifdef BASIC_JIT
+    if (jit) {
+      jit_ = std::make_unique<Jit>();
+      std::vector<int> heads;
+      addHeads(0, heads);
+      std::sort(heads.begin(), heads.end());
+      heads.erase(std::unique(heads.begin(), heads.end()), heads.end());
+      for (int position : heads) {
+        entries_.push_back(JitEntry{position, 0, -1, threaded_[position]});
+      }
+      rearm();
+    }
+#endif
+  } else if (stale || rearm_) {
+#ifdef BASIC_JIT
+    // 上次编译的机器码已随 Jit 释放，各入口重新计数
+    rearm();
+#endif
+    if (patched) {
+      // 只有追加的与改写为 SKIP 的指令需要重新线索化
+      const BytecodePatch& patch = bytecode.patch;
+      threaded_.resize(bytecode.code.size());
+      for (std::size_t i = patch.appended; i < threaded_.size(); ++i) {
+        threaded_[i] = thread(bytecode.code[i]);
+      }
+      for (int position : patch.patched) {
+        threaded_[position] = thread(bytecode.code[position]);
+      }
+#ifdef BASIC_JIT
+      if (jit) {
+        // 改写处的入口不再是 HOT，随之作废；追加的指令中的回跳目标与
+        // 改动行的首条指令成为新入口，已是 HOT 的不重复加入
+        std::size_t kept = 0;
+        for (const JitEntry& entry : entries_) {
+          if (threaded_[entry.position].handler == hot) {
+            entries_[kept++] = entry;
+          }
+        }
+        entries_.resize(kept);
+        std::vector<int> heads = patch.entries;
+        addHeads(patch.appended, heads);
+        for (int position : heads) {
+          if (threaded_[position].handler != hot) {
+            entries_.push_back(
+                JitEntry{position, 0, -1, threaded_[position]});
+            threaded_[position] = {hot, 0, false};
+          }
+        }
+        rearm();
+      }
+#endif
+    }
+#ifdef BASIC_JIT
+    if (!entries_.empty()) {
+      jit_ = std::make_unique<Jit>();
+    }
+#endif
+  }
+  const ThreadedInstruction* code = threaded_.data();
+#else
+  const Instruction* code = bytecode.code.data();
+#endif
+  const auto* pc = code + resume_;
+  const auto* ins = pc;
+  const FusedOperands* fused = bytecode.fused.data();
+  // 统计用：每执行一条超级指令，累加它代替的指令数减一
+  auto count = [&](int replaced) {
+    if constexpr (Count) {
+      *saved += replaced - 1;
+    }
+  };
+
+  // 统计用：不产生指令的行（如 REM）与下一行共用首条指令，计入下一行。
+  // 暂停期间的时间不计入任何行。
+  std::uint64_t since = 0;
+  if constexpr (Profile) {
+    if (stale) {
+      lineOf_.assign(bytecode.code.size(), -1);
+      for (int index = 0, size = static_cast<int>(bytecode.lineStarts.size());
+           index < size; ++index) {
+        lineOf_[bytecode.lineStarts[index]] = index;
+      }
+    }
+    since = Profiler::now();
+  }
+  rearm_ = false;
+  auto leaveLine = [&]() {
+    if constexpr (Profile) {
+      std::uint64_t now = Profiler::now();
+      if (current_ >= 0) {
+        profiler->charge(current_, now - since);
+      }
+      since = now;
+    }
+  };
+  auto enterLine = [&]() {
+    if constexpr (Profile) {
+      int entered = lineOf_[pc - code];
+      if (entered >= 0) {
+        leaveLine();
+        current_ = entered;
+        if (!reentering_) {
+          profiler->count(current_);
+        }
+      }
+      reentering_ = false;
+    }
+  };
+
+  // 两种分派方式共用下面的处理代码
+#ifdef BASIC_THREADED_DISPATCH
+#define VM_CASE(name) op_##name
+#define VM_NEXT()         \
+  do {                    \
+    enterLine();          \
+    ins = pc++;           \
+    goto *ins->handler;   \
+  } while (false)
+
+  VM_NEXT();
+  {
+#else
+#define VM_CASE(name) case OpCode::name
+#define VM_NEXT() continue
+
+  for (;;) {
+    enterLine();
+    ins = pc++;
+    switch (ins->op) {
+#endif
+// 跳往 target。向后的跳转消耗一次预算，用完时暂停在
+// 目标处；循环都要经过向后的跳转，向前的跳转无需计数
+#define VM_JUMP(target)                         \
+  do {                                          \
+    pc = (target);                              \
+    if (ins->backward && --budget == 0) {       \
+      goto yield;                               \
+    }                                           \
+  } while (false)
+      VM_CASE(PUSH):
+        *sp++ = ins->operand;
+        VM_NEXT();
+      VM_CASE(LOAD):
+        *sp++ = state.getValue(ins->operand);
+        VM_NEXT();
+      VM_CASE(ADD):
+        --sp;
+        sp[-1] = sp[-1] + sp[0];
+        VM_NEXT();
+      VM_CASE(SUB):
+        --sp;
+        sp[-1] = sp[-1] - sp[0];
+        VM_NEXT();
+      VM_CASE(MUL):
+        --sp;
+        sp[-1] = sp[-1] * sp[0];
+        VM_NEXT();
+      VM_CASE(DIV):
+        --sp;
+        if (sp[0] == 0) {
+          leaveLine();
+          throw BasicError("DIVIDE BY ZERO");
+        }
+        // 商不能表示，x86 上 idiv 会触发 SIGFPE；机器码在这里退回解释器
+        if (sp[0] == -1 && sp[-1] == INT_MIN) {
+          leaveLine();
+          throw BasicError("INTEGER OVERFLOW");
+        }
+        sp[-1] = sp[-1] / sp[0];
+        VM_NEXT();
+      VM_CASE(STORE):
+        state.setValue(ins->operand, *--sp);
+        VM_NEXT();
+      VM_CASE(PRINT):
+        output.printLine(*--sp);
+        VM_NEXT();
+      VM_CASE(INPUT): {
+        int value;
+        switch (INPUTStatement::readValue(output, input, value)) {
+          case INPUTStatement::Read::VALUE:
+            state.setValue(ins->operand, value);
+            break;
+          case INPUTStatement::Read::END:
+            break;
+          case INPUTStatement::Read::WAIT:
+            // 有输入后从这条 INPUT 重新执行。它可能是热点区域入口，此时 ins
+            // 指向保存的原指令，以 pc 回退一条为准
+            --pc;
+            goto wait;
+        }
+        VM_NEXT();
+      }
+      VM_CASE(JUMP):
+        VM_JUMP(code + labels[ins->operand]);
+        VM_NEXT();
+      VM_CASE(JUMP_EQ):
+        sp -= 2;
+        if (sp[0] == sp[1]) {
+          VM_JUMP(code + labels[ins->operand]);
+        }
+        VM_NEXT();
+      VM_CASE(JUMP_GT):
+        sp -= 2;
+        if (sp[0] > sp[1]) {
+          VM_JUMP(code + labels[ins->operand]);
+        }
+        VM_NEXT();
+      VM_CASE(JUMP_LT):
+        sp -= 2;
+        if (sp[0] < sp[1]) {
+          VM_JUMP(code + labels[ins->operand]);
+        }
+        VM_NEXT();
+      VM_CASE(FAIL):
+        leaveLine();
+        if (ins->operand == static_cast<int>(FailCode::LINE_NUMBER_ERROR)) {
+          throw BasicError("LINE NUMBER ERROR");
+        }
+        throw BasicError("SYNTAX ERROR");
+      VM_CASE(HALT):
+        leaveLine();
+        remaining = budget;
+        return Status::FINISHED;
+      VM_CASE(LOOP):
+        // 统计时逐行计数，不走快速路径
+        if constexpr (!Profile) {
+          const CountedLoop& loop = bytecode.loops[ins->operand];
+          if (runCountedLoop(loop, state, output, budget)) {
+            if (budget == 0) {
+              // 迭代未执行完，继续时重新执行 LOOP（同上，可能是区域入口）
+              --pc;
+              goto yield;
+            }
+            pc = code + labels[loop.exit];
+          }
+        }
+        VM_NEXT();
+      VM_CASE(SKIP):
+        pc = code + ins->operand;
+        VM_NEXT();
+      VM_CASE(INC): {
+        const FusedOperands& f = fused[ins->operand];
+        state.setValue(f.slot, state.getValue(f.slot) + f.step);
+        count(4);
+        VM_NEXT();
+      }
+
+// 三种比较共用的超级指令处理代码
+#define VM_FUSED_BRANCHES(CC, CMP)                               \
+  VM_CASE(BRANCH_##CC) : {                                       \
+    const FusedOperands& f = fused[ins->operand];                \
+    count(3);                                                    \
+    if (state.getValue(f.slot) CMP f.constant) {                 \
+      VM_JUMP(code + labels[f.target]);                          \
+    }                                                            \
+    VM_NEXT();                                                   \
+  }                                                              \
+  VM_CASE(INC_BRANCH_##CC) : {                                   \
+    const FusedOperands& f = fused[ins->operand];                \
+    int value = state.getValue(f.slot) + f.step;                 \
+    state.setValue(f.slot, value);                               \
+    count(7);                                                    \
+    if (value CMP f.constant) {                                  \
+      VM_JUMP(code + labels[f.target]);                          \
+    }                                                            \
+    VM_NEXT();                                                   \
+  }                                                              \
+  VM_CASE(STORE_BRANCH_##CC) : {                                 \
+    const FusedOperands& f = fused[ins->operand];                \
+    int value = *--sp;                                           \
+    state.setValue(f.slot, value);                               \
+    count(4);                                                    \
+    if (value CMP f.constant) {                                  \
+      VM_JUMP(code + labels[f.target]);                          \
+    }                                                            \
+    VM_NEXT();                                                   \
+  }
+
+      VM_FUSED_BRANCHES(EQ, ==)
+      VM_FUSED_BRANCHES(GT, >)
+      VM_FUSED_BRANCHES(LT, <)
+#undef VM_FUSED_BRANCHES
+#ifdef BASIC_JIT
+      op_HOT: {
+        JitEntry& entry = entries_[ins->operand];
+        if (++entry.count >= jitThreshold_) {
+          entry.region = jit_->compile(bytecode, entry.position);
+          if (entry.region >= 0) {
+            threaded_[entry.position] = {&&op_JIT, ins->operand, false};
+            pc = code + entry.position;
+            VM_NEXT();
+          }
+          // 无法编译时恢复原指令，不再计数
+          threaded_[entry.position] = entry.original;
+        }
+        ins = &entry.original;
+        goto *ins->handler;
+      }
+      op_JIT: {
+        JitEntry& entry = entries_[ins->operand];
+        state.reserve(jit_->slots());
+        JitFrame frame{state.values(), state.definedBits(), stack,
+                       &output,        0,                   budget};
+        int resume = jit_->run(entry.region, frame);
+        budget = frame.budget;
+        sp = stack + frame.depth;
+        pc = code + resume;
+        if (budget == 0) {
+          goto yield;
+        }
+        if (resume == entry.position) {
+          // 区域的第一条指令就要交给解释器，执行原指令
+          ins = &entry.original;
+          ++pc;
+          goto *ins->handler;
+        }
+        VM_NEXT();
+      }
+#endif
+#ifdef BASIC_THREADED_DISPATCH
+  }
+#else
+    }
+  }
+#endif
+
+yield:
+  leaveLine();
+  remaining = 0;
+  resume_ = static_cast<int>(pc - code);
+  depth_ = static_cast<int>(sp - stack);
+  return Status::YIELDED;
+wait:
+  leaveLine();
+  remaining = budget;
+  reentering_ = true;
+  resume_ = static_cast<int>(pc - code);
+  depth_ = static_cast<int>(sp - stack);
+  return Status::WAITING;
+
+#undef VM_CASE
+#undef VM_NEXT
+#undef VM_JUMP
+}
@@ -4,16 +4,43 @@
 
 #include "utils/Error.hpp"
 
-void VarState::setValue(const std::string& name, int value) {
-  values_[name] = value;
+void VarState::setValue(int slot, int value) {
+  if (slot >= static_cast<int>(values_.size())) {
+    values_.resize(slot + 1);
+    defined_.resize(slot / 64 + 1);
+  }
+  values_[slot] = value;
+  defined_[slot >> 6] |= std::uint64_t{1} << (slot & 63);
 }
 
-int VarState::getValue(const std::string& name) const {
-  auto it = values_.find(name);
-  if (it == values_.end()) {
+int VarState::getValue(int slot) const {
+  if (!isDefined(slot)) {
     throw BasicError("VARIABLE NOT DEFINED");
   }
-  return it->second;
+  return values_[slot];
+}
+
+bool VarState::isDefined(int slot) const noexcept {
+  if (slot >= static_cast<int>(values_.size())) {
+    return false;
+  }
+  return (defined_[slot >> 6] >> (slot & 63)) & 1;
 }
 
-void VarState::clear() { values_.clear(); }
+void VarState::clear() { std::fill(defined_.begin(), defined_.end(), 0); }
+
+std::size_t VarState::memoryUsage() const noexcept {
+  return values_.capacity() * sizeof(int) +
+         defined_.capacity() * sizeof(std::uint64_t);
+}
+
+void VarState::reserve(int slots) {
+  if (slots > static_cast<int>(values_.size())) {
+    values_.resize(slots);
+    defined_.resize((slots + 63) / 64);
+  }
+}
+
+int* VarState::values() noexcept { return values_.data(); }
+
+std::uint64_t* VarState::definedBits() noexcept { return defined_.data(); }
@@ -0,0 +1,43 @@
+#include "utils/MappedFile.hpp"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "utils/Error.hpp"
+
+MappedFile::MappedFile(const std::string& path) : data_(nullptr), size_(0) {
+  int fd = ::open(path.c_str(), O_RDONLY);
+  if (fd < 0) {
+    throw BasicError("CANNOT OPEN FILE " + path);
+  }
+  struct stat info;
+  if (::fstat(fd, &info) != 0) {
+    ::close(fd);
+    throw BasicError("CANNOT OPEN FILE " + path);
+  }
+  size_ = static_cast<std::size_t>(info.st_size);
+  // 空文件不能映射，按空文本处理
+  if (size_ > 0) {
+    data_ = ::mmap(nullptr, size_, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (data_ == MAP_FAILED) {
+      data_ = nullptr;
+      ::close(fd);
+      throw BasicError("CANNOT OPEN FILE " + path);
+    }
+    // 只顺序扫描一遍
+    ::madvise(data_, size_, MADV_SEQUENTIAL);
+  }
+  ::close(fd);
+}
+
+MappedFile::~MappedFile() {
+  if (data_ != nullptr) {
+    ::munmap(data_, size_);
+  }
+}
+
+std::string_view MappedFile::text() const noexcept {
+  return std::string_view(static_cast<const char*>(data_), size_);
+}
@@ -0,0 +1,107 @@
+#include "utils/Process.hpp"
+
+#include <fcntl.h>
+#include <poll.h>
+#include <signal.h>
+#include <spawn.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <cerrno>
+#include <cstddef>
+
+extern char** environ;
+
+RunResult runProgram(const std::vector<std::string>& args,
+                     const std::string& input,
+                     std::chrono::milliseconds timeout, bool withStderr) {
+  RunResult result;
+  int in[2], out[2];
+  if (pipe2(in, O_CLOEXEC) != 0) return result;
+  if (pipe2(out, O_CLOEXEC) != 0) {
+    close(in[0]);
+    close(in[1]);
+    return result;
+  }
+  posix_spawn_file_actions_t actions;
+  posix_spawn_file_actions_init(&actions);
+  posix_spawn_file_actions_adddup2(&actions, in[0], STDIN_FILENO);
+  posix_spawn_file_actions_adddup2(&actions, out[1], STDOUT_FILENO);
+  if (withStderr) {
+    posix_spawn_file_actions_adddup2(&actions, out[1], STDERR_FILENO);
+  } else {
+    posix_spawn_file_actions_addopen(&actions, STDERR_FILENO, "/dev/null",
+                                     O_WRONLY, 0);
+  }
+  std::vector<char*> argv;
+  for (const std::string& arg : args) {
+    argv.push_back(const_cast<char*>(arg.c_str()));
+  }
+  argv.push_back(nullptr);
+  pid_t pid;
+  int spawned =
+      posix_spawnp(&pid, argv[0], &actions, nullptr, argv.data(), environ);
+  posix_spawn_file_actions_destroy(&actions);
+  close(in[0]);
+  close(out[1]);
+  if (spawned != 0) {
+    close(in[1]);
+    close(out[0]);
+    return result;
+  }
+
+  // 输入与输出交替进行，避免双方都阻塞在写管道上
+  fcntl(in[1], F_SETFL, O_NONBLOCK);
+  int writeFd = in[1];
+  std::size_t written = 0;
+  if (input.empty()) {
+    close(writeFd);
+    writeFd = -1;
+  }
+  auto deadline = std::chrono::steady_clock::now() + timeout;
+  char buffer[65536];
+  for (;;) {
+    auto left = std::chrono::duration_cast<std::chrono::milliseconds>(
+        deadline - std::chrono::steady_clock::now());
+    if (left.count() <= 0) {
+      result.timedOut = true;
+      break;
+    }
+    pollfd fds[2] = {{out[0], POLLIN, 0}, {writeFd, POLLOUT, 0}};
+    int ready =
+        poll(fds, writeFd >= 0 ? 2 : 1, static_cast<int>(left.count()));
+    if (ready < 0 && errno != EINTR) break;
+    if (ready <= 0) continue;
+    if (writeFd >= 0 && fds[1].revents != 0) {
+      ssize_t count =
+          write(writeFd, input.data() + written, input.size() - written);
+      if (count > 0) written += static_cast<std::size_t>(count);
+      // 对方已关闭输入时不再写
+      if (count < 0 && errno != EAGAIN && errno != EINTR) {
+        written = input.size();
+      }
+      if (written == input.size()) {
+        close(writeFd);
+        writeFd = -1;
+      }
+    }
+    if (fds[0].revents != 0) {
+      ssize_t count = read(out[0], buffer, sizeof(buffer));
+      if (count > 0) {
+        result.output.append(buffer, static_cast<std::size_t>(count));
+      } else if (count == 0 || errno != EINTR) {
+        break;
+      }
+    }
+  }
+  if (writeFd >= 0) close(writeFd);
+  close(out[0]);
+  if (result.timedOut) kill(pid, SIGKILL);
+  int status = 0;
+  while (waitpid(pid, &status, 0) < 0 && errno == EINTR) {
+  }
+  result.ok =
+      !result.timedOut && WIFEXITED(status) && WEXITSTATUS(status) == 0;
+  return result;
+}
+